@@ -0,0 +1,37 @@
+# Generate C stubs and skeletons from QTEE interface descriptions.
+#
+#   qcomtee_add_idl(<target> <file.idl>...)
+#
+# For each file.idl, it generates file.h with idl/qcomtee_idlc.py and adds
+# its directory to the include path of <target>.
+
+find_package(Python3 REQUIRED COMPONENTS Interpreter)
+
+set(QCOMTEE_IDLC "${CMAKE_CURRENT_LIST_DIR}/../idl/qcomtee_idlc.py"
+        CACHE INTERNAL "QTEE IDL compiler")
+set(QCOMTEE_IDLC_PYTHON "${Python3_EXECUTABLE}"
+        CACHE INTERNAL "Python interpreter for the QTEE IDL compiler")
+
+function(qcomtee_add_idl target)
+        set(outdir "${CMAKE_CURRENT_BINARY_DIR}/idl")
+        file(MAKE_DIRECTORY ${outdir})
+
+        foreach(idl ${ARGN})
+                get_filename_component(name ${idl} NAME_WE)
+                get_filename_component(idl ${idl} ABSOLUTE)
+                set(header "${outdir}/${name}.h")
+
+                add_custom_command(
+                        OUTPUT ${header}
+                        COMMAND ${QCOMTEE_IDLC_PYTHON} ${QCOMTEE_IDLC}
+                                -o ${header} ${idl}
+                        DEPENDS ${idl} ${QCOMTEE_IDLC}
+                        COMMENT "Generating ${name}.h from ${name}.idl"
+                )
+
+                list(APPEND headers ${header})
+        endforeach()
+
+        target_sources(${target} PRIVATE ${headers})
+        target_include_directories(${target} PRIVATE ${outdir})
+endfunction()
@@ -0,0 +1,576 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+# SPDX-License-Identifier: BSD-3-Clause
+
+"""Generate C stubs and skeletons for QTEE interfaces.
+
+An IDL file holds one or more interfaces:
+
+    // Comments are C or C++ style.
+    interface IIO {
+        const uint32 ERROR_OFFSET = 10;
+
+        method getLength(out uint64 len);
+        method readAtOffset(in uint64 offset, out buffer data);
+    };
+
+Operations are numbered in order from 0; "method name(...) = N;" sets the
+number explicitly and the following methods continue from N + 1.
+
+Argument types are the primitives int8 to int64 and uint8 to uint64,
+"buffer", and "interface" or any interface name for objects. Arguments are
+passed to QTEE in this order:
+
+  - all primitive inputs, packed in one QCOMTEE_UBUF_INPUT,
+  - each input buffer, as QCOMTEE_UBUF_INPUT,
+  - all primitive outputs, packed in one QCOMTEE_UBUF_OUTPUT,
+  - each output buffer, as QCOMTEE_UBUF_OUTPUT,
+  - each input object, as QCOMTEE_OBJREF_INPUT,
+  - each output object, as QCOMTEE_OBJREF_OUTPUT.
+
+For every interface I and method m, the generated header has:
+
+  - I_OP_m, the operation number,
+  - I_m(), a client stub that invokes a QTEE object; its output objects
+    are QCOMTEE_OBJECT_NULL unless QTEE returns them,
+  - struct I_skel_ops, with one member m per method, to implement
+    a callback object, and I_dispatch() to use in its dispatcher.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+PRIMITIVES = {
+    'int8': 'int8_t', 'int16': 'int16_t',
+    'int32': 'int32_t', 'int64': 'int64_t',
+    'uint8': 'uint8_t', 'uint16': 'uint16_t',
+    'uint32': 'uint32_t', 'uint64': 'uint64_t',
+}
+
+# Names used by the generated code.
+RESERVED = {'self', 'result', 'ops', 'op', 'params', 'num', 'ret'}
+
+TOKEN = re.compile(r'\s*(?:(//[^\n]*|/\*.*?\*/)|([A-Za-z_]\w*|-?(?:0x[0-9a-fA-F]+|\d+))|(.))',
+                   re.S)
+
+
+class IDLError(Exception):
+    pass
+
+
+class Arg:
+    def __init__(self, direction, type_, name):
+        self.direction = direction
+        self.type = type_
+        self.name = name
+
+    @property
+    def kind(self):
+        if self.type in PRIMITIVES:
+            return 'value'
+        if self.type == 'buffer':
+            return 'buffer'
+        return 'object'
+
+    @property
+    def ctype(self):
+        return PRIMITIVES.get(self.type)
+
+
+class Method:
+    def __init__(self, name, args, op):
+        self.name = name
+        self.args = args
+        self.op = op
+
+    def select(self, direction, kind):
+        return [a for a in self.args
+                if a.direction == direction and a.kind == kind]
+
+    def layout(self):
+        """Return [(attr, args)], one entry per qcomtee_param."""
+        layout = []
+        values = self.select('in', 'value')
+        if values:
+            layout.append(('QCOMTEE_UBUF_INPUT', values))
+        for a in self.select('in', 'buffer'):
+            layout.append(('QCOMTEE_UBUF_INPUT', [a]))
+        values = self.select('out', 'value')
+        if values:
+            layout.append(('QCOMTEE_UBUF_OUTPUT', values))
+        for a in self.select('out', 'buffer'):
+            layout.append(('QCOMTEE_UBUF_OUTPUT', [a]))
+        for a in self.select('in', 'object'):
+            layout.append(('QCOMTEE_OBJREF_INPUT', [a]))
+        for a in self.select('out', 'object'):
+            layout.append(('QCOMTEE_OBJREF_OUTPUT', [a]))
+        return layout
+
+
+class Interface:
+    def __init__(self, name):
+        self.name = name
+        self.consts = []
+        self.methods = []
+
+
+def tokenize(text):
+    tokens = []
+    for m in TOKEN.finditer(text):
+        if m.group(1):
+            continue
+        tok = m.group(2) or m.group(3)
+        if tok and not tok.isspace():
+            line = text.count('\n', 0, m.start()) + 1
+            tokens.append((tok, line))
+    return tokens
+
+
+class Parser:
+    def __init__(self, text):
+        self.tokens = tokenize(text)
+        self.pos = 0
+
+    def peek(self):
+        if self.pos < len(self.tokens):
+            return self.tokens[self.pos][0]
+        return None
+
+    def next(self, expect=None):
+        if self.pos >= len(self.tokens):
+            raise IDLError('unexpected end of file')
+        tok, line = self.tokens[self.pos]
+        if expect is not None and tok != expect:
+            raise IDLError('line %d: expected "%s", got "%s"' %
+                           (line, expect, tok))
+        self.pos += 1
+        return tok
+
+    def ident(self):
+        tok = self.next()
+        if not re.match(r'[A-Za-z_]\w*$', tok):
+            raise IDLError('line %d: expected a name, got "%s"' %
+                           (self.tokens[self.pos - 1][1], tok))
+        return tok
+
+    def number(self):
+        tok = self.next()
+        try:
+            return int(tok, 0)
+        except ValueError:
+            raise IDLError('line %d: expected a number, got "%s"' %
+                           (self.tokens[self.pos - 1][1], tok))
+
+    def parse(self):
+        interfaces = []
+        while self.peek() is not None:
+            self.next('interface')
+            interfaces.append(self.interface())
+        return interfaces
+
+    def interface(self):
+        iface = Interface(self.ident())
+        self.next('{')
+        op = 0
+        while self.peek() != '}':
+            tok = self.next()
+            if tok == 'const':
+                type_ = self.ident()
+                if type_ not in PRIMITIVES:
+                    raise IDLError('%s: const %s is not a primitive' %
+                                   (iface.name, type_))
+                name = self.ident()
+                self.next('=')
+                iface.consts.append((name, self.number()))
+                self.next(';')
+            elif tok == 'method':
+                method = self.method(op)
+                iface.methods.append(method)
+                op = method.op + 1
+            else:
+                raise IDLError('%s: unexpected "%s"' % (iface.name, tok))
+        self.next('}')
+        self.next(';')
+        check(iface)
+        return iface
+
+    def method(self, op):
+        name = self.ident()
+        args = []
+        self.next('(')
+        while self.peek() != ')':
+            direction = self.next()
+            if direction not in ('in', 'out'):
+                raise IDLError('%s: expected "in" or "out", got "%s"' %
+                               (name, direction))
+            args.append(Arg(direction, self.ident(), self.ident()))
+            if self.peek() != ')':
+                self.next(',')
+        self.next(')')
+        if self.peek() == '=':
+            self.next('=')
+            op = self.number()
+        self.next(';')
+        return Method(name, args, op)
+
+
+def check(iface):
+    ops = {}
+    for m in iface.methods:
+        if m.op in ops:
+            raise IDLError('%s: %s and %s have the same operation %d' %
+                           (iface.name, ops[m.op], m.name, m.op))
+        ops[m.op] = m.name
+        names = set()
+        for a in m.args:
+            if a.name in RESERVED or a.name.startswith('_'):
+                raise IDLError('%s.%s: %s is reserved' %
+                               (iface.name, m.name, a.name))
+            if a.name in names:
+                raise IDLError('%s.%s: duplicate argument %s' %
+                               (iface.name, m.name, a.name))
+            names.add(a.name)
+        if len(m.layout()) > 64:
+            raise IDLError('%s.%s: too many parameters' %
+                           (iface.name, m.name))
+
+
+class Writer:
+    def __init__(self):
+        self.lines = []
+
+    def __call__(self, line='', indent=0):
+        self.lines.append('\t' * indent + line if line else '')
+
+    def text(self):
+        return '\n'.join(self.lines) + '\n'
+
+
+def columns(line):
+    return len(line.expandtabs(8))
+
+
+def wrap(w, head, items, sep, tail, indent=0, cont=None):
+    """Write head, items joined by sep, and tail, wrapped at 80 columns.
+
+    Continuation lines are aligned with the end of head, or with cont.
+    """
+    first = '\t' * indent + head
+    if cont is None:
+        col = columns(first)
+        cont = '\t' * (col // 8) + ' ' * (col % 8)
+    lines = []
+    line = first
+    for i, item in enumerate(items):
+        tok = item + (sep.rstrip() if i < len(items) - 1 else tail)
+        if line not in (first, cont) and columns(line + ' ' + tok) > 80:
+            lines.append(line)
+            line = cont + tok
+        elif line in (first, cont):
+            line += tok
+        else:
+            line += ' ' + tok
+    lines.append(line)
+    w.lines.extend(lines)
+
+
+def proto(w, ret, name, args, tail='', indent=0):
+    """Write a prototype or a call, wrapping the arguments at 80 columns."""
+    line = '\t' * indent + ret + name + '(' + ', '.join(args) + ')' + tail
+    if columns(line) <= 80:
+        w.lines.append(line)
+        return
+    # A long return type goes on its own line.
+    if ret.endswith(' ') and not indent:
+        w(ret.rstrip())
+        ret = ''
+    wrap(w, ret + name + '(', args, ', ', ')' + tail, indent)
+
+
+def stub_args(m):
+    args = ['struct qcomtee_object *self']
+    for a in m.args:
+        if a.kind == 'value':
+            args.append(('%s %s' if a.direction == 'in' else '%s *%s') %
+                        (a.ctype, a.name))
+        elif a.kind == 'buffer':
+            if a.direction == 'in':
+                args += ['const void *%s' % a.name, 'size_t %s_len' % a.name]
+            else:
+                args += ['void *%s' % a.name, 'size_t %s_len' % a.name,
+                         'size_t *%s_lenout' % a.name]
+        else:
+            args.append(('struct qcomtee_object *%s' if a.direction == 'in'
+                         else 'struct qcomtee_object **%s') % a.name)
+    return args + ['qcomtee_result_t *result']
+
+
+def skel_args(m):
+    args = ['struct qcomtee_object *self']
+    for a in m.args:
+        if a.kind == 'value':
+            args.append(('%s %s' if a.direction == 'in' else '%s *%s') %
+                        (a.ctype, a.name))
+        elif a.kind == 'buffer':
+            if a.direction == 'in':
+                args += ['const void *%s' % a.name, 'size_t %s_len' % a.name]
+            else:
+                args += ['void **%s' % a.name, 'size_t *%s_len' % a.name]
+        else:
+            args.append(('struct qcomtee_object *%s' if a.direction == 'in'
+                         else 'struct qcomtee_object **%s') % a.name)
+    return args
+
+
+def packed(w, name, args, qualifier='', init=False):
+    w('%sstruct {' % qualifier, 1)
+    for a in args:
+        w('%s %s;' % (a.ctype, a.name), 2)
+    if init:
+        w('} %s = { %s };' % (name, ', '.join(a.name for a in args)), 1)
+    else:
+        w('} %s;' % name, 1)
+
+
+def gen_stub(w, iface, m):
+    layout = m.layout()
+    n = len(layout)
+    w('/* Invoke %s on a QTEE object; see qcomtee_object_invoke. */' % m.name)
+    proto(w, 'static inline int ', '%s_%s' % (iface.name, m.name),
+          stub_args(m))
+    w('{')
+    if n:
+        w('struct qcomtee_param _params[%d];' % n, 1)
+    ins = m.select('in', 'value')
+    outs = m.select('out', 'value')
+    if ins:
+        packed(w, '_in', ins, init=True)
+    if outs:
+        packed(w, '_out', outs)
+    if n:
+        w()
+    for i, (attr, args) in enumerate(layout):
+        a = args[0]
+        w('_params[%d].attr = %s;' % (i, attr), 1)
+        if attr in ('QCOMTEE_UBUF_INPUT', 'QCOMTEE_UBUF_OUTPUT'):
+            if a.kind == 'value':
+                var = '_in' if attr == 'QCOMTEE_UBUF_INPUT' else '_out'
+                w('_params[%d].ubuf.addr = &%s;' % (i, var), 1)
+                w('_params[%d].ubuf.size = sizeof(%s);' % (i, var), 1)
+            elif a.direction == 'in':
+                w('_params[%d].ubuf.addr = (void *)%s;' % (i, a.name), 1)
+                w('_params[%d].ubuf.size = %s_len;' % (i, a.name), 1)
+            else:
+                w('_params[%d].ubuf.addr = %s;' % (i, a.name), 1)
+                w('_params[%d].ubuf.size = %s_len;' % (i, a.name), 1)
+        elif attr == 'QCOMTEE_OBJREF_INPUT':
+            w('_params[%d].object = %s;' % (i, a.name), 1)
+        else:
+            w('*%s = QCOMTEE_OBJECT_NULL;' % a.name, 1)
+    if n:
+        w()
+    proto(w, 'if (', 'qcomtee_object_invoke',
+          ['self', '%s_OP_%s' % (iface.name, m.name),
+           '_params' if n else 'NULL', str(n), 'result'], ')', indent=1)
+    w('return -1;', 2)
+    outputs = [(i, attr, args) for i, (attr, args) in enumerate(layout)
+               if attr in ('QCOMTEE_UBUF_OUTPUT', 'QCOMTEE_OBJREF_OUTPUT')]
+    if outputs:
+        w()
+        w('if (*result != QCOMTEE_OK)', 1)
+        w('return 0;', 2)
+        w()
+        for i, attr, args in outputs:
+            for a in args:
+                if a.kind == 'value':
+                    w('*%s = _out.%s;' % (a.name, a.name), 1)
+                elif a.kind == 'buffer':
+                    w('*%s_lenout = _params[%d].ubuf.size;' % (a.name, i), 1)
+                else:
+                    w('*%s = _params[%d].object;' % (a.name, i), 1)
+    w()
+    w('return 0;', 1)
+    w('}')
+    w()
+
+
+def gen_skel(w, iface, m):
+    layout = m.layout()
+    n = len(layout)
+    w('static inline qcomtee_result_t')
+    proto(w, '', '%s_skel_%s' % (iface.name, m.name),
+          ['const struct %s_skel_ops *ops' % iface.name,
+           'struct qcomtee_object *self', 'struct qcomtee_param *params',
+           'int num'])
+    w('{')
+    ins = m.select('in', 'value')
+    outs = m.select('out', 'value')
+    if ins:
+        packed(w, '_in', ins)
+    if outs:
+        # It should stay valid until the response is sent on this thread.
+        packed(w, '_out', outs, qualifier='static _Thread_local ')
+    caps = [i for i, (attr, args) in enumerate(layout)
+            if attr == 'QCOMTEE_UBUF_OUTPUT' and args[0].kind == 'buffer']
+    for i in caps:
+        w('size_t _cap%d;' % i, 1)
+    # Anything to do after the call?
+    post = caps or outs
+    if post:
+        w('qcomtee_result_t ret;', 1)
+    if ins or outs or post:
+        w()
+    conds = ['num != %d' % n, '!ops->%s' % m.name]
+    for i, (attr, args) in enumerate(layout):
+        conds.append('params[%d].attr != %s' % (i, attr))
+        if args[0].kind == 'value':
+            op = '!=' if attr == 'QCOMTEE_UBUF_INPUT' else '<'
+            var = '_in' if attr == 'QCOMTEE_UBUF_INPUT' else '_out'
+            conds.append('params[%d].ubuf.size %s sizeof(%s)' % (i, op, var))
+    wrap(w, 'if (', conds, ' || ', ')', indent=1, cont='\t    ')
+    w('return QCOMTEE_ERROR_INVALID;', 2)
+    w()
+    if ins:
+        w('memcpy(&_in, params[0].ubuf.addr, sizeof(_in));', 1)
+    for i in caps:
+        w('_cap%d = params[%d].ubuf.size;' % (i, i), 1)
+    call = []
+    for a in m.args:
+        i = next(i for i, (attr, args) in enumerate(layout) if a in args)
+        if a.kind == 'value':
+            call.append(('_in.%s' if a.direction == 'in' else '&_out.%s') %
+                        a.name)
+        elif a.kind == 'buffer':
+            if a.direction == 'in':
+                call += ['params[%d].ubuf.addr' % i,
+                         'params[%d].ubuf.size' % i]
+            else:
+                call += ['&params[%d].ubuf.addr' % i,
+                         '&params[%d].ubuf.size' % i]
+        else:
+            call.append(('params[%d].object' if a.direction == 'in' else
+                         '&params[%d].object') % i)
+    if not post:
+        proto(w, 'return ', 'ops->%s' % m.name, ['self'] + call, ';',
+              indent=1)
+        w('}')
+        w()
+        return
+
+    proto(w, 'ret = ', 'ops->%s' % m.name, ['self'] + call, ';', indent=1)
+    w('if (ret != QCOMTEE_OK)', 1)
+    w('return ret;', 2)
+    for i in caps:
+        w()
+        w('if (params[%d].ubuf.size > _cap%d)' % (i, i), 1)
+        w('return QCOMTEE_ERROR_SIZE_OUT;', 2)
+    for i, (attr, args) in enumerate(layout):
+        if attr == 'QCOMTEE_UBUF_OUTPUT' and args[0].kind == 'value':
+            w()
+            w('params[%d].ubuf.addr = &_out;' % i, 1)
+            w('params[%d].ubuf.size = sizeof(_out);' % i, 1)
+    w()
+    w('return QCOMTEE_OK;', 1)
+    w('}')
+    w()
+
+
+def gen_interface(w, iface):
+    name = iface.name
+    w('/* \'\'%s\'\' */' % name)
+    w()
+    for const, value in iface.consts:
+        w('#define %s_%s %d' % (name, const, value))
+    if iface.consts:
+        w()
+    for m in iface.methods:
+        w('#define %s_OP_%s %d' % (name, m.name, m.op))
+    w()
+    for m in iface.methods:
+        gen_stub(w, iface, m)
+
+    w('/**')
+    w(' * @brief Implementation of %s callback objects.' % name)
+    w(' *')
+    w(' * Input objects are owned by the implementation. Output buffers')
+    w(' * point to memory that stays valid until the response is sent;')
+    w(' * on entry, the size is the space available in QTEE.')
+    w(' */')
+    w('struct %s_skel_ops {' % name)
+    for m in iface.methods:
+        args = skel_args(m)
+        proto(w, 'qcomtee_result_t ', '(*%s)' % m.name, args, ';',
+              indent=1)
+    w('};')
+    w()
+    for m in iface.methods:
+        gen_skel(w, iface, m)
+
+    w('typedef qcomtee_result_t (*%s_skel_t)(const struct %s_skel_ops *,' %
+      (name, name))
+    w('\tstruct qcomtee_object *, struct qcomtee_param *, int);')
+    w()
+    w('/* Dispatch a request from QTEE to ops; see qcomtee_object_ops. */')
+    w('static inline qcomtee_result_t')
+    proto(w, '', '%s_dispatch' % name,
+          ['const struct %s_skel_ops *ops' % name,
+           'struct qcomtee_object *self', 'qcomtee_op_t op',
+           'struct qcomtee_param *params', 'int num'])
+    w('{')
+    w('static const %s_skel_t skel[] = {' % name, 1)
+    for m in iface.methods:
+        w('[%s_OP_%s] = %s_skel_%s,' % (name, m.name, name, m.name), 2)
+    w('};', 1)
+    w()
+    w('if (op >= sizeof(skel) / sizeof(skel[0]) || !skel[op])', 1)
+    w('return QCOMTEE_ERROR_INVALID;', 2)
+    w()
+    w('return skel[op](ops, self, params, num);', 1)
+    w('}')
+    w()
+
+
+def generate(interfaces, source):
+    w = Writer()
+    guard = '_%s_H' % re.sub(r'\W', '_',
+                             os.path.splitext(os.path.basename(source))[0]
+                             ).upper()
+    w('// Generated by qcomtee_idlc.py from %s; do not edit.' %
+      os.path.basename(source))
+    w()
+    w('#ifndef %s' % guard)
+    w('#define %s' % guard)
+    w()
+    w('#include <stdint.h>')
+    w('#include <string.h>')
+    w('#include <qcomtee_object.h>')
+    w()
+    for iface in interfaces:
+        gen_interface(w, iface)
+    w('#endif // %s' % guard)
+    return w.text()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('-o', '--output', required=True,
+                        help='generated header')
+    parser.add_argument('idl', help='interface description')
+    args = parser.parse_args()
+
+    try:
+        with open(args.idl) as f:
+            interfaces = Parser(f.read()).parse()
+    except (IDLError, OSError) as e:
+        sys.stderr.write('%s: %s\n' % (args.idl, e))
+        return 1
+
+    with open(args.output, 'w') as f:
+        f.write(generate(interfaces, args.idl))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -142,7 +142,8 @@
  * @def QCOMTEE_ERROR_TIMEOUT
  * @brief It indicates that the invocation for object of type
  *        @ref qcomtee_object_type_t::QCOMTEE_OBJECT_TYPE_CB "Callback Object"
- *        has timed out.
+ *        has timed out, or that the deadline passed in
+ *        @ref qcomtee_object_invoke_timeout has expired.
  */
 #define QCOMTEE_ERROR_TIMEOUT -103
 
@@ -149,15 +149,49 @@ typedef enum {
  * @def QCOMTEE_OBJECT_PARAMS_MAX
  * @brief Size of parameter array minus one passed to the dispatcher.
  *
- * This is allocated on the stack; use your best judgment.
+ * It is the number of parameters a supplicant thread starts with; requests
+ * with more parameters, up to 64, or more input data grow its buffers.
  */
 #define QCOMTEE_OBJECT_PARAMS_MAX 10
 
+/**
+ * @def QCOMTEE_OBJECT_OPS_REENTRANT
+ * @brief The dispatcher handles concurrent calls; it skips the strand.
+ *
+ * See @ref qcomtee_object_root_strands_init.
+ */
+#define QCOMTEE_OBJECT_OPS_REENTRANT (1U << 0)
+
+/**
+ * @def QCOMTEE_OBJECT_PRIORITY_NORMAL
+ * @brief Default priority class of a callback object.
+ */
+#define QCOMTEE_OBJECT_PRIORITY_NORMAL 0
+
+/**
+ * @def QCOMTEE_OBJECT_PRIORITY_HIGH
+ * @brief Priority class for latency-critical callback objects.
+ */
+#define QCOMTEE_OBJECT_PRIORITY_HIGH 1
+
+/**
+ * @def QCOMTEE_OBJECT_PRIORITY_BULK
+ * @brief Priority class for callback objects that move bulk data.
+ */
+#define QCOMTEE_OBJECT_PRIORITY_BULK 2
+
+/**
+ * @def QCOMTEE_OBJECT_PRIORITY_CLASSES
+ * @brief Number of priority classes.
+ */
+#define QCOMTEE_OBJECT_PRIORITY_CLASSES 3
+
 /**
  * @brief Object's operations.
  * 
  * The client implementing these operations should serialize multiple
- * concurrent dispatch calls.
+ * concurrent dispatch calls, unless strands are enabled for the root
+ * object; see @ref qcomtee_object_root_strands_init.
  */
 struct qcomtee_object_ops {
 	/**
@@ -198,6 +232,19 @@ struct qcomtee_object_ops {
 	 * @return If supported a non-zero value; Otherwise 0.
 	 */
 	int (*supported)(qcomtee_op_t op);
+
+	unsigned int flags; /**< QCOMTEE_OBJECT_OPS_* flags. */
+
+	/**
+	 * @brief Priority class, QCOMTEE_OBJECT_PRIORITY_*.
+	 *
+	 * Requests waiting in a dispatch queue, i.e. of a supplicant with
+	 * readers or a supplicant service, are dispatched by class: high
+	 * before normal before bulk. A class with requests waiting is not
+	 * passed over indefinitely. It does not affect requests dispatched
+	 * by the thread that receives them.
+	 */
+	int priority;
 };
 
 /**
@@ -307,6 +354,28 @@ struct qcomtee_object *qcomtee_object_root_init(const char *dev,
 						void (*release)(void *),
 						void *arg);
 
+/**
+ * @brief Serialize dispatch calls for each callback object of a root object.
+ *
+ * Requests for a callback object run one at a time, in the order they are
+ * received. A request for an object that is busy is queued on the object's
+ * strand and the thread that received it goes back to receive the next
+ * request; the thread running the strand dispatches it next. Each object
+ * has its own strand, so requests for different objects still run in
+ * parallel, and a dispatcher may wait for a nested callback to another
+ * object.
+ *
+ * Objects with @ref QCOMTEE_OBJECT_OPS_REENTRANT skip the strand. An object
+ * whose dispatcher waits for another request to the same object, e.g. a
+ * nested callback, must be reentrant.
+ *
+ * Call it before any request is dispatched for the root object.
+ *
+ * @param root The root object.
+ * @return On success, 0; Otherwise, returns -1.
+ */
+int qcomtee_object_root_strands_init(struct qcomtee_object *root);
+
 /**
  * @brief Initialize a callback objet.
  * @param object Object to initialize as callback object.
@@ -318,6 +387,47 @@ int qcomtee_object_cb_init(struct qcomtee_object *object,
 			   struct qcomtee_object_ops *ops,
 			   struct qcomtee_object *root);
 
+struct qcomtee_deferred;
+
+/**
+ * @brief Defer the response to the request being dispatched.
+ *
+ * Call it from @ref qcomtee_object_ops::dispatch "Dispatcher" to send the
+ * response later, from any thread, using
+ * @ref qcomtee_object_dispatch_complete; the return value of the dispatcher
+ * is then ignored. The thread that received the request goes back to
+ * receive the next one.
+ *
+ * The @ref QCOMTEE_UBUF_INPUT buffers in the parameter array remain valid
+ * until the response is sent; the parameter array itself does not.
+ * The object is kept alive until then. If the object runs on a strand, the
+ * strand moves on to the next request once the dispatcher returns.
+ *
+ * @return On success, returns the token for the request; Otherwise, returns
+ *         NULL if it is not called from a dispatcher, the request has
+ *         already been deferred, or there is no memory. Then the dispatcher
+ *         should respond as usual.
+ */
+struct qcomtee_deferred *qcomtee_object_dispatch_defer(void);
+
+/**
+ * @brief Send the response to a deferred request.
+ *
+ * On success, the token is freed. Errors in sending the response are
+ * reported to @ref qcomtee_object_ops::error "error" as usual.
+ *
+ * @param deferred Token from @ref qcomtee_object_dispatch_defer.
+ * @param result Result of the request, as returned by a dispatcher.
+ * @param params Parameter array with the output parameters; on error,
+ *        it is ignored.
+ * @param num Number of parameters in params; the same as passed to the
+ *        dispatcher.
+ * @return On success, 0; Otherwise, returns -1 if num does not match.
+ */
+int qcomtee_object_dispatch_complete(struct qcomtee_deferred *deferred,
+				     qcomtee_result_t result,
+				     struct qcomtee_param *params, int num);
+
 /**
  * @brief Invoke an Object.
  *
@@ -335,6 +445,212 @@ int qcomtee_object_invoke(struct qcomtee_object *object, qcomtee_op_t op,
 			  struct qcomtee_param *params, int num_params,
 			  qcomtee_result_t *result);
 
+/**
+ * @brief Prepared invocation; see @ref qcomtee_object_invoke_prepare.
+ */
+struct qcomtee_invoke_prepared;
+
+/**
+ * @brief Prepare an invocation to be issued repeatedly.
+ *
+ * It validates the parameter array and lays out the driver arguments once,
+ * so that @ref qcomtee_object_invoke_exec only patches buffer addresses,
+ * buffer sizes and input objects before calling QTEE. Only the parameter
+ * types are taken from params; values are ignored.
+ *
+ * The prepared invocation holds a reference to the object. Release it with
+ * @ref qcomtee_object_invoke_prepared_release.
+ *
+ * @param object Object to invoke.
+ * @param op Operation to do on the object.
+ * @param params Parameter array with the types for every call.
+ * @param num_params Number of parameter in the array.
+ * @return On success, returns the prepared invocation;
+ *         Otherwise, returns NULL.
+ */
+struct qcomtee_invoke_prepared *
+qcomtee_object_invoke_prepare(struct qcomtee_object *object, qcomtee_op_t op,
+			      struct qcomtee_param *params, int num_params);
+
+/**
+ * @brief Invoke a prepared invocation.
+ *
+ * It is the same as @ref qcomtee_object_invoke. The parameter array should
+ * have the same types, in the same order, as the one passed to
+ * @ref qcomtee_object_invoke_prepare; they are not checked again.
+ * A prepared invocation should not be invoked concurrently.
+ *
+ * @param prepared The prepared invocation.
+ * @param params Input parameter array to the requested operation.
+ * @param result Result of operation.
+ * @return On success, 0; Otherwise, returns -1.
+ */
+int qcomtee_object_invoke_exec(struct qcomtee_invoke_prepared *prepared,
+			       struct qcomtee_param *params,
+			       qcomtee_result_t *result);
+
+/**
+ * @brief Release a prepared invocation.
+ * @param prepared The prepared invocation.
+ */
+void qcomtee_object_invoke_prepared_release(
+	struct qcomtee_invoke_prepared *prepared);
+
+/**
+ * @brief An entry of @ref qcomtee_object_invoke_batch.
+ */
+struct qcomtee_invoke_desc {
+	struct qcomtee_object *object; /**< Object to invoke. */
+	qcomtee_op_t op; /**< Operation to do on the object. */
+	struct qcomtee_param *params; /**< Parameter array. */
+	int num_params; /**< Number of parameter in the array. */
+	qcomtee_result_t result; /**< Result of operation. */
+	int ret; /**< Return value of @ref qcomtee_object_invoke. */
+};
+
+/**
+ * @brief Invoke a set of independent objects concurrently.
+ *
+ * Each entry is invoked as by @ref qcomtee_object_invoke, on the calling
+ * thread or on a thread of an internal worker pool; there is no ordering
+ * between entries. It returns when all entries are done, with per-entry
+ * ret and result.
+ *
+ * @param descs Array of entries.
+ * @param num Number of entries in the array.
+ * @return Returns 0 if ret is 0 for every entry; Otherwise, returns -1.
+ */
+int qcomtee_object_invoke_batch(struct qcomtee_invoke_desc *descs, int num);
+
+/**
+ * @brief An asynchronous invocation; see @ref qcomtee_object_invoke_async.
+ *
+ * Use @ref QCOMTEE_INVOKE_ASYNC_INIT to initialize it.
+ */
+struct qcomtee_invoke_async {
+	struct qcomtee_object *object; /**< Object to invoke. */
+	qcomtee_op_t op; /**< Operation to do on the object. */
+	struct qcomtee_param *params; /**< Parameter array. */
+	int num_params; /**< Number of parameter in the array. */
+
+	/**
+	 * @brief Called on a library thread when the invocation completes.
+	 *
+	 * If it is not NULL, the library calls it instead of setting done and
+	 * does not access the invocation after calling it.
+	 *
+	 * @param async The completed invocation.
+	 */
+	void (*complete)(struct qcomtee_invoke_async *async);
+
+	/**
+	 * @brief File to signal the completion on, e.g. an eventfd.
+	 *
+	 * If it is not negative, the library writes a uint64_t value of 1 to
+	 * it after setting done or calling complete; the invocation may be
+	 * reused by then. One file can serve many invocations.
+	 */
+	int fd;
+	void *arg; /**< Argument for the owner of the invocation. */
+
+	qcomtee_result_t result; /**< Result of operation. */
+	int ret; /**< Return value of @ref qcomtee_object_invoke. */
+
+	/**
+	 * @brief It is non-zero when the invocation is complete.
+	 *
+	 * It is set only if complete is NULL; the two are mutually exclusive.
+	 * The library does not access the invocation after setting it.
+	 */
+	atomic_int done;
+
+	void *priv[8]; /**< Private to the library. */
+};
+
+/**
+ * @def QCOMTEE_INVOKE_ASYNC_INIT
+ * @brief Initializer for @ref qcomtee_invoke_async without a callback or fd.
+ */
+#define QCOMTEE_INVOKE_ASYNC_INIT(o, p, prm, n)                 \
+	((struct qcomtee_invoke_async){ .object = (o), .op = (p), \
+					.params = (prm),          \
+					.num_params = (n),        \
+					.fd = -1 })
+
+/**
+ * @brief Invoke an object asynchronously.
+ *
+ * The invocation is queued to an internal pool of threads that call
+ * @ref qcomtee_object_invoke; ownership of the parameters is the same.
+ * The invocation and the parameter array should stay valid until
+ * the invocation is complete, as reported by
+ * @ref qcomtee_invoke_async::complete "complete",
+ * @ref qcomtee_invoke_async::fd "fd", or
+ * @ref qcomtee_invoke_async::done "done".
+ *
+ * @param async The invocation.
+ * @return On success, 0; Otherwise, returns -1 and the invocation is not
+ *         queued.
+ */
+int qcomtee_object_invoke_async(struct qcomtee_invoke_async *async);
+
+/**
+ * @brief Cancel an asynchronous invocation.
+ *
+ * If the invocation has not been started, it completes with result
+ * @ref QCOMTEE_ERROR_ABORT without reaching QTEE. An invocation in progress
+ * cannot be cancelled: TEE_IOC_OBJECT_INVOKE carries no cancellation ID.
+ * Its completion is reported when QTEE returns. It should not be called
+ * after the invocation is complete.
+ *
+ * @param async The invocation queued by @ref qcomtee_object_invoke_async.
+ * @return Returns 0 if the invocation has been cancelled; Otherwise,
+ *         returns -1 if it was already in progress.
+ */
+int qcomtee_object_invoke_cancel(struct qcomtee_invoke_async *async);
+
+/**
+ * @def QCOMTEE_INVOKE_TIMEOUT_PENDING_MAX
+ * @brief Most invocations left running in QTEE after their deadline.
+ *
+ * See @ref qcomtee_object_invoke_timeout.
+ */
+#define QCOMTEE_INVOKE_TIMEOUT_PENDING_MAX 16
+
+/**
+ * @brief Invoke an Object with a deadline.
+ *
+ * It is the same as @ref qcomtee_object_invoke, except that if QTEE does not
+ * return within timeout_ms, it returns 0 with result
+ * @ref QCOMTEE_ERROR_TIMEOUT. QTEE is not asked to stop; see
+ * @ref qcomtee_object_invoke_cancel. The invocation runs to completion.
+ * The invocation uses private copies of the buffers and holds references
+ * to the object, its root and the input objects until QTEE returns, so the
+ * caller can reuse the parameters and drop its references right away;
+ * whatever QTEE returns later is dropped. On timeout, treat the input
+ * callback objects as sent.
+ *
+ * The invocation runs on the worker threads shared with
+ * @ref qcomtee_object_invoke_async and @ref qcomtee_object_invoke_batch, and
+ * one that timed out keeps its thread blocked in QTEE until QTEE returns.
+ * So that they cannot take every thread, at most
+ * @ref QCOMTEE_INVOKE_TIMEOUT_PENDING_MAX timed out invocations may be
+ * pending; while that many are, it returns 0 with result
+ * @ref QCOMTEE_ERROR_BUSY without invoking the object.
+ *
+ * @param object Object to invoke.
+ * @param op Operation to do on the object.
+ * @param params Input parameter array to the requested operation.
+ * @param num_params Number of parameter in the input array.
+ * @param result Result of operation.
+ * @param timeout_ms Deadline in milliseconds; if negative, there is none.
+ * @return On success, 0; Otherwise, returns -1.
+ */
+int qcomtee_object_invoke_timeout(struct qcomtee_object *object,
+				  qcomtee_op_t op,
+				  struct qcomtee_param *params, int num_params,
+				  qcomtee_result_t *result, int timeout_ms);
+
 /**
  * @brief Process single request.
  *
@@ -345,14 +661,63 @@ int qcomtee_object_invoke(struct qcomtee_object *object, qcomtee_op_t op,
  * This function calls the random object's @ref qcomtee_object_ops::dispatch
  * operation. Therefore, if it is being executed by a pthread, it is not
  * safe to use PTHREAD_CANCEL_ASYNCHRONOUS.
+ * To stop a thread waiting in it, interrupt it with a signal whose handler
+ * is installed without SA_RESTART, so that tee_call fails with EINTR, as
+ * @ref qcomtee_supplicant_stop does.
  *
  * The @ref qcomtee_object::tee_call function should implement support for
  * reading a new request (i.e., TEE_IOC_SUPPL_RECV) and submitting the response
  * (i.e., TEE_IOC_SUPPL_SEND).
+ *
+ * @ref qcomtee_supplicant_start runs a pool of threads calling this function.
  * 
  * @param root The root object for which the request queue is checked.
  * @return On success, 0; Otherwise, returns -1.
  */
 int qcomtee_object_process_one(struct qcomtee_object *root);
 
+/**
+ * @brief Get a file to poll for requests.
+ *
+ * The driver cannot deliver requests to the application's thread without
+ * blocking it: its fd does not support poll(), and TEE_IOC_SUPPL_RECV has
+ * no non-blocking mode. So on the first call a library thread starts
+ * receiving requests for the root object and hands them over to the
+ * application through a queue. The returned eventfd is readable while
+ * there are queued requests; dispatch them with
+ * @ref qcomtee_object_process_ready on the application's thread, e.g. from
+ * an event loop.
+ *
+ * The file belongs to the root object and is closed when it is released;
+ * requests still queued then are answered with @ref QCOMTEE_ERROR_ABORT.
+ * A thread blocked in TEE_IOC_SUPPL_RECV cannot also wait on an eventfd,
+ * and only a signal makes the driver return, so the thread is woken with
+ * signo on release, as described for @ref qcomtee_supplicant_opts::signo.
+ * The signal's previous handler is restored once nothing in the library
+ * uses it. Only the first call chooses the signal.
+ *
+ * A dispatcher on that thread should not wait for another request, e.g. a
+ * nested callback, as nothing dispatches it meanwhile; it may defer the
+ * response with @ref qcomtee_object_dispatch_defer instead.
+ *
+ * Do not use it with @ref qcomtee_object_process_one or a supplicant on
+ * the same root object.
+ *
+ * @param root The root object.
+ * @param signo Signal used to wake the thread; if 0, SIGRTMIN is used.
+ * @return On success, returns the file descriptor; Otherwise, returns -1.
+ */
+int qcomtee_object_poll_fd(struct qcomtee_object *root, int signo);
+
+/**
+ * @brief Process the requests that are already queued; it does not block.
+ *
+ * See @ref qcomtee_object_poll_fd.
+ *
+ * @param root The root object.
+ * @return On success, returns the number of requests processed; Otherwise,
+ *         returns -1 if @ref qcomtee_object_poll_fd has not been called.
+ */
+int qcomtee_object_process_ready(struct qcomtee_object *root);
+
 #endif // _QCOMTEE_OBJECT_H
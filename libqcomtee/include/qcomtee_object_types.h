@@ -18,6 +18,17 @@ int qcomtee_object_credentials_init(struct qcomtee_object *root,
 /* Select qcomtee_memory_object_alloc vs. qcomtee_memory_object_register. */
 #define qcomtee_memory_object_tee_api_select(a, b, c, d, fun, ...) fun
 
+/**
+ * @brief Get a memory object.
+ *
+ * With (size, root, object), it calls @ref qcomtee_memory_object_alloc;
+ * with (addr, size, root, object), @ref qcomtee_memory_object_register.
+ */
+#define qcomtee_memory_object(...)                               \
+	qcomtee_memory_object_tee_api_select(                    \
+		__VA_ARGS__, qcomtee_memory_object_register,     \
+		qcomtee_memory_object_alloc, 0)(__VA_ARGS__)
+
 /**
  * @brief Allocate a memory object.
  *
@@ -34,6 +45,8 @@ int qcomtee_object_credentials_init(struct qcomtee_object *root,
  *   - The two copies sent to QTEE in the invocations.
  * Owner should release their copy using @ref qcomtee_memory_object_release.
  * QTEE will release its two copies.
+ * The driver handles QTEE's releases; the owner is not told when QTEE is
+ * done with the memory.
  *
  * If the owner wants to donate the memory they can release their copy
  * @ref qcomtee_memory_object_release after the invocation to send the object.
@@ -60,6 +73,96 @@ int qcomtee_object_credentials_init(struct qcomtee_object *root,
 int qcomtee_memory_object_alloc(size_t size, struct qcomtee_object *root,
 				struct qcomtee_object **object);
 
+/**
+ * @brief Register caller's memory as a memory object.
+ *
+ * QTEE accesses the memory in place with no copy, through the pages pinned
+ * by TEE_IOC_SHM_REGISTER. The memory stays owned by the caller: it should
+ * stay valid until the object is released by the caller and QTEE. Releasing
+ * the object only unregisters the memory.
+ *
+ * Sharing and donating the object work as in
+ * @ref qcomtee_memory_object_alloc.
+ *
+ * @param addr Page-aligned address of the memory.
+ * @param size Size of the memory.
+ * @param root The root object to which this object belongs.
+ * @param object Memory object.
+ * @return On success, returns 0; Otherwise, returns -1.
+ */
+int qcomtee_memory_object_register(void *addr, size_t size,
+				   struct qcomtee_object *root,
+				   struct qcomtee_object **object);
+
+/* Flags for memory objects: */
+#define QCOMTEE_MEMORY_POPULATE (1U << 0) /**< Fault the pages in up front. */
+#define QCOMTEE_MEMORY_SEQUENTIAL (1U << 1) /**< Read ahead in file order. */
+#define QCOMTEE_MEMORY_HUGEPAGE (1U << 2) /**< Back with huge pages. */
+
+/**
+ * @brief Allocate a memory object with QCOMTEE_MEMORY_* flags.
+ *
+ * Same as @ref qcomtee_memory_object_alloc, with:
+ *   - @ref QCOMTEE_MEMORY_POPULATE, the pages are faulted in here rather
+ *     than on first touch.
+ *   - @ref QCOMTEE_MEMORY_HUGEPAGE, the library allocates memory aligned
+ *     to and rounded up to 2 MiB, asks for transparent huge pages, and
+ *     registers it with QTEE. If the driver cannot register memory, a TEE
+ *     shm is allocated instead. These objects are not pooled.
+ *
+ * @param size Size of the memory object.
+ * @param flags QCOMTEE_MEMORY_* flags.
+ * @param root The root object to which this object belongs.
+ * @param object Memory object.
+ * @return On success, returns 0; Otherwise, returns -1.
+ */
+int qcomtee_memory_object_alloc_flags(size_t size, unsigned int flags,
+				      struct qcomtee_object *root,
+				      struct qcomtee_object **object);
+
+/**
+ * @brief Make a memory object with the contents of a file.
+ *
+ * The file is mapped privately and the mapping is registered with QTEE.
+ * The driver pins the pages for writing, which breaks copy-on-write: the
+ * kernel copies each page once, from the page cache into anonymous memory,
+ * and QTEE writes never reach the file. This spares a read into a user
+ * buffer, but it is still one copy of the file. If the driver cannot
+ * register memory, the file is read into an allocated memory object
+ * instead.
+ *
+ * With @ref QCOMTEE_MEMORY_POPULATE, the mapping is faulted in before it is
+ * registered. With @ref QCOMTEE_MEMORY_SEQUENTIAL, the kernel is told to
+ * read ahead.
+ *
+ * The object is released like any other, using
+ * @ref qcomtee_memory_object_release; fd can be closed once this returns.
+ *
+ * @param fd File descriptor of a regular, non-empty file, open for reading.
+ * @param flags QCOMTEE_MEMORY_* flags.
+ * @param root The root object to which this object belongs.
+ * @param object Memory object.
+ * @return On success, returns 0; Otherwise, returns -1.
+ */
+int qcomtee_memory_object_from_fd(int fd, unsigned int flags,
+				  struct qcomtee_object *root,
+				  struct qcomtee_object **object);
+
+/**
+ * @brief Make a memory object with the contents of a file.
+ *
+ * Same as @ref qcomtee_memory_object_from_fd, for the file at pathname.
+ *
+ * @param pathname Path to the file.
+ * @param flags QCOMTEE_MEMORY_* flags.
+ * @param root The root object to which this object belongs.
+ * @param object Memory object.
+ * @return On success, returns 0; Otherwise, returns -1.
+ */
+int qcomtee_memory_object_from_file(const char *pathname, unsigned int flags,
+				    struct qcomtee_object *root,
+				    struct qcomtee_object **object);
+
 void *qcomtee_memory_object_addr(struct qcomtee_object *object);
 size_t qcomtee_memory_object_size(struct qcomtee_object *object);
 
@@ -69,4 +172,62 @@ size_t qcomtee_memory_object_size(struct qcomtee_object *object);
  */
 void qcomtee_memory_object_release(struct qcomtee_object *object);
 
+/**
+ * @brief Release a memory object that QTEE is done with.
+ *
+ * Same as @ref qcomtee_memory_object_release, but the pool may reuse the
+ * object even if it was sent to QTEE; see @ref qcomtee_memory_pool_prewarm.
+ * The library is not told when QTEE releases its copies, so only the owner
+ * can know, e.g. from a service that uses the buffer only during the
+ * invocation. Reusing memory QTEE still holds exposes it to the next owner.
+ *
+ * @param object The object being released.
+ */
+void qcomtee_memory_object_recycle(struct qcomtee_object *object);
+
+/**
+ * @brief Statistics of the memory object pool of a root object.
+ */
+struct qcomtee_memory_pool_stats {
+	unsigned long hits; /**< Allocations that reused a released object. */
+	unsigned long misses; /**< Allocations that made a new TEE shm. */
+	size_t resident; /**< Bytes of the released objects kept for reuse. */
+};
+
+/**
+ * @brief Keep released memory objects of a root object for reuse.
+ *
+ * After the first call, @ref qcomtee_memory_object_alloc rounds sizes of
+ * up to 4 MiB to a power of two of at least 4 KiB; each power is a size
+ * class. An object released by its owner goes back to its class, still
+ * mapped, and a later allocation in that class reuses it. Its contents are
+ * not cleared.
+ *
+ * An object that was sent to QTEE is freed on release instead, as QTEE may
+ * still use it. The driver releases QTEE's copies of memory objects itself
+ * and does not tell user space, so the library cannot know when QTEE is
+ * done with the memory. An owner that knows can release the object with
+ * @ref qcomtee_memory_object_recycle to keep it in the pool.
+ *
+ * This allocates count objects for the class of size, less those already
+ * free, and keeps up to count released objects in it; other classes keep a
+ * few. A count of 0 only enables the pool. The objects are freed with root.
+ *
+ * @param root The root object.
+ * @param size Size of the memory objects.
+ * @param count Number of memory objects.
+ * @return On success, returns 0; Otherwise, returns -1.
+ */
+int qcomtee_memory_pool_prewarm(struct qcomtee_object *root, size_t size,
+				int count);
+
+/**
+ * @brief Get the statistics of the memory object pool.
+ * @param root The root object.
+ * @param stats Statistics to fill in.
+ * @return On success, returns 0; -1 if the pool is not enabled.
+ */
+int qcomtee_memory_pool_get_stats(struct qcomtee_object *root,
+				  struct qcomtee_memory_pool_stats *stats);
+
 #endif // _QCOMTEE_OBJECT_TYPES_H
@@ -0,0 +1,227 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef _QCOMTEE_SUPPLICANT_H
+#define _QCOMTEE_SUPPLICANT_H
+
+#include <stddef.h>
+#include "qcomtee_object.h"
+
+/**
+ * @def QCOMTEE_SUPPLICANT_THREADS_MAX
+ * @brief Maximum number of threads in a supplicant.
+ */
+#define QCOMTEE_SUPPLICANT_THREADS_MAX 64
+
+/**
+ * @def QCOMTEE_SUPPLICANT_LINGER_MS
+ * @brief Default time an extra thread waits for a request before it exits.
+ */
+#define QCOMTEE_SUPPLICANT_LINGER_MS 10000
+
+/**
+ * @brief Supplicant options.
+ *
+ * A zero-initialized structure selects the defaults.
+ */
+struct qcomtee_supplicant_opts {
+	size_t stack_size; /**< Stack size of the threads; 0 for default. */
+
+	/**
+	 * @brief Maximum number of threads.
+	 *
+	 * When the last thread waiting for a request receives one, a new
+	 * thread is started, up to max_threads, so that a callback that calls
+	 * into QTEE, which then calls back, always finds a thread to receive
+	 * the nested request. If 0, or less than nthreads, the supplicant
+	 * keeps nthreads threads.
+	 */
+	int max_threads;
+
+	/**
+	 * @brief Milliseconds an extra thread waits for a request.
+	 *
+	 * Threads above nthreads exit when they have been waiting that long;
+	 * one thread is always left waiting. If 0,
+	 * QCOMTEE_SUPPLICANT_LINGER_MS is used.
+	 */
+	int linger_ms;
+
+	/**
+	 * @brief Number of reader threads.
+	 *
+	 * If 0, each thread receives a request and dispatches it. Otherwise,
+	 * readers threads only receive requests and hand them over to the
+	 * dispatch threads, so a slow callback does not delay receiving the
+	 * next request. The number of dispatch threads varies as described
+	 * for max_threads. Release requests are handled by the readers.
+	 */
+	int readers;
+
+	/**
+	 * @brief Signal used to wake the threads on shutdown.
+	 *
+	 * The supplicant installs a handler without SA_RESTART so that a
+	 * thread waiting for a request returns from the driver. The
+	 * application's handler is restored when the last supplicant,
+	 * service, or @ref qcomtee_object_poll_fd queue using the signal
+	 * stops; do not change it meanwhile. If 0, SIGRTMIN is used.
+	 */
+	int signo;
+};
+
+/**
+ * @brief Supplicant statistics.
+ */
+struct qcomtee_supplicant_stats {
+	int threads; /**< Number of threads. */
+	int receiving; /**< Threads waiting in TEE_IOC_SUPPL_RECV. */
+	int dispatching; /**< Threads processing a request. */
+	unsigned long started; /**< Threads started since the beginning. */
+	unsigned long retired; /**< Threads exited after lingering. */
+
+	/**
+	 * @brief Requests taken from the dispatch queue, per priority class.
+	 *
+	 * Indexed by QCOMTEE_OBJECT_PRIORITY_*; see
+	 * @ref qcomtee_object_ops::priority. Only requests handed over by the
+	 * readers are counted.
+	 */
+	unsigned long dispatched[QCOMTEE_OBJECT_PRIORITY_CLASSES];
+	/** Total time those requests waited in the queue, in ns. */
+	uint64_t wait_ns[QCOMTEE_OBJECT_PRIORITY_CLASSES];
+	/** Longest time one of them waited in the queue, in ns. */
+	uint64_t wait_max_ns[QCOMTEE_OBJECT_PRIORITY_CLASSES];
+};
+
+struct qcomtee_supplicant;
+
+/**
+ * @brief Start a supplicant.
+ *
+ * It starts nthreads threads, each calling @ref qcomtee_object_process_one
+ * on root, so that requests from QTEE to callback objects are dispatched at
+ * the same time. The number of threads then varies between nthreads and
+ * @ref qcomtee_supplicant_opts::max_threads. The root object's tee_call
+ * should return -1 with errno set to EINTR when it is interrupted by a signal.
+ *
+ * The supplicant does not keep a reference to root; it should be stopped
+ * before the root object is released, e.g. in the release callback passed to
+ * @ref qcomtee_object_root_init.
+ *
+ * @param root The root object to serve.
+ * @param nthreads Minimum number of threads, 1 to
+ *        QCOMTEE_SUPPLICANT_THREADS_MAX.
+ * @param opts Options; NULL for default.
+ * @return On success, returns the supplicant; Otherwise, returns NULL.
+ */
+struct qcomtee_supplicant *
+qcomtee_supplicant_start(struct qcomtee_object *root, int nthreads,
+			 const struct qcomtee_supplicant_opts *opts);
+
+/**
+ * @brief Get the supplicant statistics.
+ * @param sup The supplicant.
+ * @param stats Statistics.
+ */
+void qcomtee_supplicant_get_stats(struct qcomtee_supplicant *sup,
+				  struct qcomtee_supplicant_stats *stats);
+
+/**
+ * @brief Stop a supplicant.
+ *
+ * Threads finish the request they are dispatching, if any, and exit.
+ * Threads waiting for a request are woken with the signal. Requests
+ * received by the readers and not yet dispatched are answered with
+ * @ref QCOMTEE_ERROR_ABORT. On return, every thread has exited and the
+ * supplicant is freed.
+ *
+ * It may be called from a callback running on one of the supplicant's
+ * threads, e.g. the release callback passed to
+ * @ref qcomtee_object_root_init when QTEE releases the last callback object.
+ * Then, on return, the other threads have exited; the calling thread exits
+ * and frees the supplicant once the callback returns.
+ *
+ * @param sup The supplicant to stop.
+ */
+void qcomtee_supplicant_stop(struct qcomtee_supplicant *sup);
+
+struct qcomtee_supplicant_service;
+
+/**
+ * @brief Start a supplicant service for many root objects.
+ *
+ * A service dispatches requests for the root objects added to it with a
+ * shared pool of nthreads to @ref qcomtee_supplicant_opts::max_threads
+ * threads. The driver waits for requests on one root object at a time, so
+ * each root object with objects exported to QTEE also has a thread
+ * receiving its requests; a root object without them has none.
+ *
+ * Only dispatching is shared: the number of threads grows with the number
+ * of root objects that have objects exported to QTEE, not with the load.
+ * A service for hundreds of such root objects has hundreds of threads,
+ * mostly blocked in the driver, until the driver can wait on many root
+ * objects at once.
+ *
+ * @ref qcomtee_supplicant_opts::readers is ignored.
+ *
+ * @param nthreads Minimum number of dispatch threads, 1 to
+ *        QCOMTEE_SUPPLICANT_THREADS_MAX.
+ * @param opts Options; NULL for default.
+ * @return On success, returns the service; Otherwise, returns NULL.
+ */
+struct qcomtee_supplicant_service *
+qcomtee_supplicant_service_start(int nthreads,
+				 const struct qcomtee_supplicant_opts *opts);
+
+/**
+ * @brief Serve a root object.
+ *
+ * The service keeps a reference to root until it is removed. Do not use
+ * root with another service, a supplicant, @ref qcomtee_object_poll_fd, or
+ * @ref qcomtee_object_process_one.
+ *
+ * @param svc The service.
+ * @param root The root object to serve.
+ * @return On success, 0; Otherwise, returns -1.
+ */
+int qcomtee_supplicant_service_add(struct qcomtee_supplicant_service *svc,
+				   struct qcomtee_object *root);
+
+/**
+ * @brief Stop serving a root object.
+ *
+ * Requests for root not yet dispatched are answered with
+ * @ref QCOMTEE_ERROR_ABORT; on return, no request for root is being
+ * received or dispatched. Do not call it from a callback dispatched by the
+ * service.
+ *
+ * @param svc The service.
+ * @param root The root object to remove.
+ */
+void qcomtee_supplicant_service_remove(struct qcomtee_supplicant_service *svc,
+				       struct qcomtee_object *root);
+
+/**
+ * @brief Get the service statistics.
+ *
+ * threads includes the threads receiving requests.
+ *
+ * @param svc The service.
+ * @param stats Statistics.
+ */
+void qcomtee_supplicant_service_get_stats(
+	struct qcomtee_supplicant_service *svc,
+	struct qcomtee_supplicant_stats *stats);
+
+/**
+ * @brief Stop a service.
+ *
+ * It removes every root object, then stops the threads and frees the
+ * service.
+ *
+ * @param svc The service to stop.
+ */
+void qcomtee_supplicant_service_stop(struct qcomtee_supplicant_service *svc);
+
+#endif // _QCOMTEE_SUPPLICANT_H
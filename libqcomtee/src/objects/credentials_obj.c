@@ -5,6 +5,7 @@
 #include <unistd.h>
 #include <sys/time.h>
 #include <qcomtee_object_types.h>
+#include <IIO.h>
 #ifdef USE_QCBOR
 #include <qcbor/qcbor.h>
 #else
@@ -12,9 +13,6 @@
 #include <string.h>
 #endif
 
-#define IIO_OP_GET_LENGTH 0
-#define IIO_OP_READ_AT_OFFSET 1
-
 static int64_t get_time_in_ms(void)
 {
 	struct timeval tv;
@@ -151,51 +149,48 @@ static void qcomtee_object_credentials_release(struct qcomtee_object *object)
 #define MIN_SIZE_T(a, b) ((a) < (b) ? (a) : (b))
 
 static qcomtee_result_t
-qcomtee_object_credentials_dispatch(struct qcomtee_object *object,
-				    qcomtee_op_t op,
-				    struct qcomtee_param *params, int num)
+qcomtee_object_credentials_get_length(struct qcomtee_object *object,
+				      uint64_t *len)
 {
-	struct qcomtee_credentials *qcomtee_cred = CREDENTIALS(object);
-
-	switch (op) {
-	case IIO_OP_GET_LENGTH:
-		/* Expect one argument: ouput buffer. */
-		if (num != 1 || params[0].attr != QCOMTEE_UBUF_OUTPUT)
-			return QCOMTEE_ERROR_INVALID;
+	*len = CREDENTIALS(object)->ubuf.size;
 
-		params[0].ubuf.addr = &qcomtee_cred->ubuf.size;
-		params[0].ubuf.size = sizeof(qcomtee_cred->ubuf.size);
+	return QCOMTEE_OK;
+}
 
-		break;
-	case IIO_OP_READ_AT_OFFSET: {
-		uint64_t offset;
+static qcomtee_result_t
+qcomtee_object_credentials_read_at_offset(struct qcomtee_object *object,
+					  uint64_t offset, void **data,
+					  size_t *data_len)
+{
+	struct qcomtee_credentials *qcomtee_cred = CREDENTIALS(object);
 
-		/* Expect two arguments: input and outout buffer. */
-		if (num != 2 || params[0].attr != QCOMTEE_UBUF_INPUT ||
-		    params[1].attr != QCOMTEE_UBUF_OUTPUT)
-			return QCOMTEE_ERROR_INVALID;
+	if (offset >= qcomtee_cred->ubuf.size)
+		return QCOMTEE_ERROR_INVALID;
 
-		offset = *((uint64_t *)(params[0].ubuf.addr));
-		if (offset >= qcomtee_cred->ubuf.size)
-			return QCOMTEE_ERROR_INVALID;
+	*data = qcomtee_cred->ubuf.addr + offset;
+	*data_len = MIN_SIZE_T(qcomtee_cred->ubuf.size - offset, *data_len);
 
-		params[1].ubuf.addr = qcomtee_cred->ubuf.addr + offset;
-		params[1].ubuf.size = MIN_SIZE_T(
-			qcomtee_cred->ubuf.size - offset, params[1].ubuf.size);
+	return QCOMTEE_OK;
+}
 
-		break;
-	}
-	default:
-		/* NEVER GET HERE! */
-		return QCOMTEE_ERROR_INVALID;
-	}
+static const struct IIO_skel_ops iio_ops = {
+	.getLength = qcomtee_object_credentials_get_length,
+	.readAtOffset = qcomtee_object_credentials_read_at_offset,
+};
 
-	return QCOMTEE_OK;
+static qcomtee_result_t
+qcomtee_object_credentials_dispatch(struct qcomtee_object *object,
+				    qcomtee_op_t op,
+				    struct qcomtee_param *params, int num)
+{
+	return IIO_dispatch(&iio_ops, object, op, params, num);
 }
 
 static struct qcomtee_object_ops ops = {
 	.release = qcomtee_object_credentials_release,
 	.dispatch = qcomtee_object_credentials_dispatch,
+	/* QTEE reads them while the client waits in registerAsClient. */
+	.priority = QCOMTEE_OBJECT_PRIORITY_HIGH,
 };
 
 int qcomtee_object_credentials_init(struct qcomtee_object *root,
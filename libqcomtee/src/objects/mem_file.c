@@ -0,0 +1,127 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mem_obj_private.h"
+
+/**
+ * @brief Map the file and register the mapping.
+ *
+ * The mapping is private, so QTEE writes never reach the file. The driver
+ * pins it for writing, which breaks copy-on-write; each page is copied once
+ * from the page cache into anonymous memory.
+ */
+static struct qcomtee_memory *
+qcomtee_memory_map_file(struct qcomtee_object *root, int fd, size_t size,
+			unsigned int flags)
+{
+	struct qcomtee_memory *qcomtee_mem;
+	int mmap_flags = MAP_PRIVATE;
+	void *addr;
+
+	if (flags & QCOMTEE_MEMORY_POPULATE)
+		mmap_flags |= MAP_POPULATE;
+
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE, mmap_flags, fd, 0);
+	if (addr == MAP_FAILED)
+		return NULL;
+
+	if (flags & QCOMTEE_MEMORY_SEQUENTIAL)
+		madvise(addr, size, MADV_SEQUENTIAL);
+
+	qcomtee_mem = qcomtee_memory_register(root, addr, size);
+	if (!qcomtee_mem) {
+		munmap(addr, size);
+		return NULL;
+	}
+
+	qcomtee_mem->mapped = 1;
+
+	return qcomtee_mem;
+}
+
+/* Read the whole file into a new shm in a single pass. */
+static int qcomtee_memory_read_file(struct qcomtee_object *root, int fd,
+				    size_t size, struct qcomtee_object **object)
+{
+	struct qcomtee_object *mo;
+	size_t off = 0;
+	ssize_t n;
+	char *addr;
+
+	if (qcomtee_memory_object_alloc(size, root, &mo))
+		return -1;
+
+	addr = qcomtee_memory_object_addr(mo);
+	while (off < size) {
+		n = pread(fd, addr + off, size - off, off);
+		if (n < 0 && errno == EINTR)
+			continue;
+
+		if (n <= 0) {
+			/* The file was truncated under us? */
+			if (!n)
+				errno = EIO;
+
+			qcomtee_memory_object_release(mo);
+			return -1;
+		}
+
+		off += n;
+	}
+
+	*object = mo;
+
+	return 0;
+}
+
+int qcomtee_memory_object_from_fd(int fd, unsigned int flags,
+				  struct qcomtee_object *root,
+				  struct qcomtee_object **object)
+{
+	struct qcomtee_memory *qcomtee_mem;
+	struct stat st;
+
+	if (fstat(fd, &st))
+		return -1;
+
+	if (!S_ISREG(st.st_mode) || !st.st_size) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (flags & QCOMTEE_MEMORY_SEQUENTIAL)
+		posix_fadvise(fd, 0, st.st_size, POSIX_FADV_SEQUENTIAL);
+
+	qcomtee_mem = qcomtee_memory_map_file(root, fd, st.st_size, flags);
+	if (qcomtee_mem) {
+		qcomtee_memory_object_init(qcomtee_mem, root, object);
+
+		return 0;
+	}
+
+	/* The driver may not support registration; copy it instead. */
+	return qcomtee_memory_read_file(root, fd, st.st_size, object);
+}
+
+int qcomtee_memory_object_from_file(const char *pathname, unsigned int flags,
+				    struct qcomtee_object *root,
+				    struct qcomtee_object **object)
+{
+	int fd, ret;
+
+	fd = open(pathname, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	/* The mapping and the shm outlive fd. */
+	ret = qcomtee_memory_object_from_fd(fd, flags, root, object);
+	close(fd);
+
+	return ret;
+}
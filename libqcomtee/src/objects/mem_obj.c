@@ -1,42 +1,18 @@
 // Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
 // SPDX-License-Identifier: BSD-3-Clause
 
+#include <errno.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/mman.h>
 #include <linux/tee.h>
-#include <qcomtee_object_types.h>
-#include <qcomtee_object_private.h>
 
-/* Which TEE API was used to prepare the memory object: */
-enum qcomtee_memory_type {
-	QCOMTEE_MEMORY_TEE_ALLOC = 1,
-	QCOMTEE_MEMORY_TEE_REGISTER
-};
+#include "mem_obj_private.h"
 
-/**
- * @brief Structure representing a memory object in TEE diver.
- *
- * This structure encapsulates information about a memory object
- * used in TEE driver.
- */
-struct qcomtee_memory {
-	struct qcomtee_object object;
-	enum qcomtee_memory_type type;
-	int fd; /**< File descriptor for TEE driver shm. */
-	struct {
-		void *addr; /**< mmaped address. */
-		size_t size; /**< size of memory. */
-	} mem_info;
-};
-
-#define MEMORY(o) container_of((o), struct qcomtee_memory, object)
-
-static void qcomtee_memory_release(struct qcomtee_object *object)
+void qcomtee_memory_free(struct qcomtee_memory *qcomtee_mem)
 {
-	struct qcomtee_memory *qcomtee_mem = MEMORY(object);
-
-	if (qcomtee_mem->type == QCOMTEE_MEMORY_TEE_ALLOC)
+	if (qcomtee_mem->type == QCOMTEE_MEMORY_TEE_ALLOC ||
+	    qcomtee_mem->mapped)
 		munmap(qcomtee_mem->mem_info.addr, qcomtee_mem->mem_info.size);
 
 	/* Release TEE shm. */
@@ -46,6 +22,17 @@ static void qcomtee_memory_release(struct qcomtee_object *object)
 	free(qcomtee_mem);
 }
 
+static void qcomtee_memory_release(struct qcomtee_object *object)
+{
+	struct qcomtee_memory *qcomtee_mem = MEMORY(object);
+
+	/* The owner is done with it; the pool keeps it if QTEE is done too. */
+	if (qcomtee_mem->pool && !qcomtee_memory_pool_put(qcomtee_mem))
+		return;
+
+	qcomtee_memory_free(qcomtee_mem);
+}
+
 /**
  * @brief Allocate and initialize an empty memory object.
  *
@@ -67,55 +54,231 @@ static struct qcomtee_memory *qcomtee_memory_alloc(void)
 		qcomtee_mem->object.ops = &ops;
 		/* TEE shm not assigned yet. */
 		qcomtee_mem->fd = -1;
+		atomic_init(&qcomtee_mem->sent, 0);
 	}
 
 	return qcomtee_mem;
 }
 
-int qcomtee_memory_object_alloc(size_t size, struct qcomtee_object *root,
-				struct qcomtee_object **object)
+struct qcomtee_memory *qcomtee_memory_create(struct qcomtee_object *root,
+					     size_t size, unsigned int flags)
 {
 	struct root_object *root_object = ROOT_OBJECT(root);
 	struct tee_ioctl_shm_alloc_data data;
 	struct qcomtee_memory *qcomtee_mem;
+	int mmap_flags = MAP_SHARED;
 	void *addr;
 	int fd;
 
 	qcomtee_mem = qcomtee_memory_alloc();
 	if (!qcomtee_mem)
-		return -1;
+		return NULL;
 
 	data.size = size;
 	data.flags = 0;
 	data.id = 0;
 	fd = root_object->tee_call(root_object->fd, TEE_IOC_SHM_ALLOC, &data);
 	if (fd < 0)
-		goto err_release;
+		goto err_free;
 
 	/* Assign TEE shm. */
 	qcomtee_mem->object.tee_object_id = data.id;
 	qcomtee_mem->fd = fd;
 
-	addr = mmap(NULL, data.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (flags & QCOMTEE_MEMORY_POPULATE)
+		mmap_flags |= MAP_POPULATE;
+
+	addr = mmap(NULL, data.size, PROT_READ | PROT_WRITE, mmap_flags, fd, 0);
 	if (addr == MAP_FAILED)
-		goto err_release;
+		goto err_free;
 
 	/* INIT the memory object. */
 	qcomtee_mem->mem_info.addr = addr;
 	qcomtee_mem->mem_info.size = data.size;
 	qcomtee_mem->type = QCOMTEE_MEMORY_TEE_ALLOC;
+
+	return qcomtee_mem;
+
+err_free:
+	qcomtee_memory_free(qcomtee_mem);
+
+	return NULL;
+}
+
+/* Fault in the pages of anonymous memory. */
+static void qcomtee_memory_populate(char *addr, size_t size)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	size_t off;
+
+#ifdef MADV_POPULATE_WRITE
+	if (!madvise(addr, size, MADV_POPULATE_WRITE))
+		return;
+#endif
+
+	/* Older kernels; a write fault per page. */
+	for (off = 0; off < size; off += page_size)
+		((volatile char *)addr)[off] = 0;
+}
+
+/**
+ * @brief Allocate anonymous memory backed by huge pages and register it.
+ *
+ * The memory is aligned to and rounded up to MEM_HUGEPAGE_SIZE, so the
+ * kernel can back it with transparent huge pages. The pages the driver pins
+ * are faulted in at registration anyway.
+ */
+static struct qcomtee_memory *
+qcomtee_memory_create_huge(struct qcomtee_object *root, size_t size,
+			   unsigned int flags)
+{
+	struct qcomtee_memory *qcomtee_mem;
+	size_t len, head;
+	char *map, *addr;
+
+	len = (size + MEM_HUGEPAGE_SIZE - 1) & ~(MEM_HUGEPAGE_SIZE - 1);
+	map = mmap(NULL, len + MEM_HUGEPAGE_SIZE, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	/* Trim the mapping to an aligned range. */
+	head = MEM_HUGEPAGE_SIZE - (uintptr_t)map % MEM_HUGEPAGE_SIZE;
+	if (head == MEM_HUGEPAGE_SIZE)
+		head = 0;
+	addr = map + head;
+	if (head)
+		munmap(map, head);
+	if (MEM_HUGEPAGE_SIZE - head)
+		munmap(addr + len, MEM_HUGEPAGE_SIZE - head);
+
+	/* Only a hint; transparent huge pages may be disabled. */
+	madvise(addr, len, MADV_HUGEPAGE);
+	if (flags & QCOMTEE_MEMORY_POPULATE)
+		qcomtee_memory_populate(addr, len);
+
+	qcomtee_mem = qcomtee_memory_register(root, addr, len);
+	if (!qcomtee_mem) {
+		munmap(addr, len);
+		return NULL;
+	}
+
+	qcomtee_mem->mapped = 1;
+
+	return qcomtee_mem;
+}
+
+int qcomtee_memory_object_alloc_flags(size_t size, unsigned int flags,
+				      struct qcomtee_object *root,
+				      struct qcomtee_object **object)
+{
+	struct qcomtee_memory_pool *pool = ROOT_OBJECT(root)->mem_pool;
+	struct qcomtee_memory *qcomtee_mem = NULL;
+	int c = -1;
+
+	/* If the driver cannot register memory, use a TEE shm. */
+	if (flags & QCOMTEE_MEMORY_HUGEPAGE)
+		qcomtee_mem = qcomtee_memory_create_huge(root, size, flags);
+
+	if (!qcomtee_mem && pool) {
+		c = qcomtee_memory_pool_class(size);
+		if (c >= 0) {
+			qcomtee_mem = qcomtee_memory_pool_get(pool, c);
+			/* Make a new object big enough for the whole class. */
+			size = qcomtee_memory_pool_class_size(c);
+		}
+	}
+
+	if (!qcomtee_mem) {
+		qcomtee_mem = qcomtee_memory_create(root, size, flags);
+		if (!qcomtee_mem)
+			return -1;
+
+		if (c >= 0) {
+			qcomtee_mem->pool = pool;
+			qcomtee_mem->pool_class = c;
+		}
+	}
+
+	qcomtee_memory_object_init(qcomtee_mem, root, object);
+
+	return 0;
+}
+
+int qcomtee_memory_object_alloc(size_t size, struct qcomtee_object *root,
+				struct qcomtee_object **object)
+{
+	return qcomtee_memory_object_alloc_flags(size, 0, root, object);
+}
+
+struct qcomtee_memory *qcomtee_memory_register(struct qcomtee_object *root,
+					       void *addr, size_t size)
+{
+	struct root_object *root_object = ROOT_OBJECT(root);
+	struct tee_ioctl_shm_register_data data;
+	struct qcomtee_memory *qcomtee_mem;
+	int fd;
+
+	/* The driver pins whole pages of the caller's memory. */
+	if (!size || (uintptr_t)addr % sysconf(_SC_PAGESIZE)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	qcomtee_mem = qcomtee_memory_alloc();
+	if (!qcomtee_mem)
+		return NULL;
+
+	data.addr = (uintptr_t)addr;
+	data.length = size;
+	data.flags = 0;
+	data.id = 0;
+	fd = root_object->tee_call(root_object->fd, TEE_IOC_SHM_REGISTER,
+				   &data);
+	if (fd < 0) {
+		qcomtee_memory_free(qcomtee_mem);
+		return NULL;
+	}
+
+	/* Assign TEE shm; the caller keeps the memory mapped. */
+	qcomtee_mem->object.tee_object_id = data.id;
+	qcomtee_mem->fd = fd;
+	qcomtee_mem->mem_info.addr = addr;
+	qcomtee_mem->mem_info.size = size;
+	qcomtee_mem->type = QCOMTEE_MEMORY_TEE_REGISTER;
+
+	return qcomtee_mem;
+}
+
+void qcomtee_memory_object_init(struct qcomtee_memory *qcomtee_mem,
+				struct qcomtee_object *root,
+				struct qcomtee_object **object)
+{
 	/* Keep a copy of root object; released in qcomtee_object_refs_dec. */
 	qcomtee_object_refs_inc(root);
 	qcomtee_mem->object.root = root;
 
 	*object = &qcomtee_mem->object;
+}
 
-	return 0;
+int qcomtee_memory_object_register(void *addr, size_t size,
+				   struct qcomtee_object *root,
+				   struct qcomtee_object **object)
+{
+	struct qcomtee_memory *qcomtee_mem;
+
+	qcomtee_mem = qcomtee_memory_register(root, addr, size);
+	if (!qcomtee_mem)
+		return -1;
+
+	qcomtee_memory_object_init(qcomtee_mem, root, object);
 
-err_release:
-	qcomtee_memory_object_release(&qcomtee_mem->object);
+	return 0;
+}
 
-	return -1;
+void qcomtee_memory_object_sent(struct qcomtee_object *object)
+{
+	atomic_store(&MEMORY(object)->sent, 1);
 }
 
 void *qcomtee_memory_object_addr(struct qcomtee_object *object)
@@ -132,3 +295,10 @@ void qcomtee_memory_object_release(struct qcomtee_object *object)
 {
 	qcomtee_object_refs_dec(object);
 }
+
+void qcomtee_memory_object_recycle(struct qcomtee_object *object)
+{
+	/* The owner vouches for QTEE; a later send marks it again. */
+	atomic_store(&MEMORY(object)->sent, 0);
+	qcomtee_object_refs_dec(object);
+}
@@ -0,0 +1,155 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef _MEM_OBJ_PRIVATE_H
+#define _MEM_OBJ_PRIVATE_H
+
+#include <qcomtee_object_types.h>
+#include <qcomtee_object_private.h>
+
+/**
+ * @def MEM_POOL_MIN_SHIFT
+ * @brief Size of the smallest pooled object, as a power of two (4 KiB).
+ */
+#define MEM_POOL_MIN_SHIFT 12
+
+/**
+ * @def MEM_POOL_MAX_SHIFT
+ * @brief Size of the largest pooled object, as a power of two (4 MiB).
+ */
+#define MEM_POOL_MAX_SHIFT 22
+
+#define MEM_POOL_CLASSES (MEM_POOL_MAX_SHIFT - MEM_POOL_MIN_SHIFT + 1)
+
+/**
+ * @def MEM_POOL_KEEP
+ * @brief Released objects kept in a size class that was not prewarmed.
+ */
+#define MEM_POOL_KEEP 4
+
+/**
+ * @def MEM_HUGEPAGE_SIZE
+ * @brief Size and alignment of memory objects with
+ *        @ref QCOMTEE_MEMORY_HUGEPAGE (2 MiB).
+ */
+#define MEM_HUGEPAGE_SIZE ((size_t)2 << 20)
+
+/* Which TEE API was used to prepare the memory object: */
+enum qcomtee_memory_type {
+	QCOMTEE_MEMORY_TEE_ALLOC = 1,
+	QCOMTEE_MEMORY_TEE_REGISTER
+};
+
+/**
+ * @brief Structure representing a memory object in TEE diver.
+ *
+ * This structure encapsulates information about a memory object
+ * used in TEE driver.
+ */
+struct qcomtee_memory {
+	struct qcomtee_object object;
+	enum qcomtee_memory_type type;
+	int fd; /**< File descriptor for TEE driver shm. */
+	struct {
+		void *addr; /**< mmaped address. */
+		size_t size; /**< size of memory. */
+	} mem_info;
+	/* The library mapped the registered memory and unmaps it on release. */
+	int mapped;
+
+	/* QTEE got a copy; the driver does not tell when it is released.
+	 * Cleared by qcomtee_memory_object_recycle.
+	 */
+	atomic_int sent;
+
+	/* Pool the object returns to on release; NULL if it is not pooled. */
+	struct qcomtee_memory_pool *pool;
+	int pool_class; /**< Size class in pool. */
+	struct qcomtee_memory *next; /**< Next free object in the size class. */
+};
+
+#define MEMORY(o) container_of((o), struct qcomtee_memory, object)
+
+/**
+ * @brief Allocate a memory object backed by a new TEE shm.
+ *
+ * The object does not belong to a root yet and is not pooled.
+ *
+ * @param root The root object used to allocate the TEE shm.
+ * @param size Size of the memory object.
+ * @param flags QCOMTEE_MEMORY_POPULATE or 0.
+ * @return On success, returns @ref qcomtee_memory; Otherwise, NULL.
+ */
+struct qcomtee_memory *qcomtee_memory_create(struct qcomtee_object *root,
+					     size_t size, unsigned int flags);
+
+/**
+ * @brief Register caller's memory as a memory object.
+ *
+ * The object does not belong to a root yet.
+ *
+ * @param root The root object used to register the memory.
+ * @param addr Page-aligned address of the memory.
+ * @param size Size of the memory.
+ * @return On success, returns @ref qcomtee_memory; Otherwise, NULL.
+ */
+struct qcomtee_memory *qcomtee_memory_register(struct qcomtee_object *root,
+					       void *addr, size_t size);
+
+/**
+ * @brief Hand a new memory object over to the caller.
+ * @param qcomtee_mem The memory object.
+ * @param root The root object to which the object belongs.
+ * @param object Memory object returned to the caller.
+ */
+void qcomtee_memory_object_init(struct qcomtee_memory *qcomtee_mem,
+				struct qcomtee_object *root,
+				struct qcomtee_object **object);
+
+/**
+ * @brief Unmap and free a memory object with no reference left.
+ * @param qcomtee_mem The memory object to free.
+ */
+void qcomtee_memory_free(struct qcomtee_memory *qcomtee_mem);
+
+/**
+ * @brief Size class for an object of a given size.
+ * @param size Size of the memory object.
+ * @return The size class, or -1 if objects of that size are not pooled.
+ */
+int qcomtee_memory_pool_class(size_t size);
+
+/**
+ * @brief Size of the objects in a size class.
+ * @param c The size class.
+ * @return Size of the objects in the size class.
+ */
+static inline size_t qcomtee_memory_pool_class_size(int c)
+{
+	return (size_t)1 << (MEM_POOL_MIN_SHIFT + c);
+}
+
+/**
+ * @brief Take a free object from a size class.
+ *
+ * The object has a single reference and does not belong to a root yet.
+ *
+ * @param pool The pool to take the object from.
+ * @param c The size class.
+ * @return On success, returns @ref qcomtee_memory; NULL if the class is empty.
+ */
+struct qcomtee_memory *qcomtee_memory_pool_get(struct qcomtee_memory_pool *pool,
+					       int c);
+
+/**
+ * @brief Return an object with no reference left to its pool.
+ *
+ * It is called from the release op, after the object has left the
+ * namespace. An object QTEE may still be using is not kept.
+ *
+ * @param qcomtee_mem The memory object to return.
+ * @return 0 if the pool keeps the object; -1 if the caller should free it.
+ */
+int qcomtee_memory_pool_put(struct qcomtee_memory *qcomtee_mem);
+
+#endif // _MEM_OBJ_PRIVATE_H
@@ -0,0 +1,209 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "mem_obj_private.h"
+
+/**
+ * @brief Memory objects of a root object kept for reuse.
+ *
+ * Objects of up to 1 << MEM_POOL_MAX_SHIFT bytes are rounded up to a power
+ * of two and grouped into size classes. A released object goes back to its
+ * class, with its TEE shm and mapping, unless the class already has keep
+ * objects; the next allocation in that class takes it without a syscall.
+ *
+ * An object released by its owner may still be in use by QTEE if it was
+ * ever sent there; the driver releases QTEE's copies without telling user
+ * space. Such an object is freed, and the driver keeps the shm until QTEE
+ * is done, unless its owner released it with qcomtee_memory_object_recycle.
+ *
+ * The free objects hold no reference to the root; they are freed with it.
+ */
+struct qcomtee_memory_pool {
+	pthread_mutex_t lock; /**< Lock to protect the fields below. */
+	struct qcomtee_memory *free[MEM_POOL_CLASSES];
+	int nfree[MEM_POOL_CLASSES];
+	int keep[MEM_POOL_CLASSES];
+
+	/* See qcomtee_memory_pool_stats. */
+	unsigned long hits;
+	unsigned long misses;
+	size_t resident;
+};
+
+/* Serialize creating the pool of a root object. */
+static pthread_mutex_t mem_pool_init_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int qcomtee_memory_pool_class(size_t size)
+{
+	int c;
+
+	for (c = 0; c < MEM_POOL_CLASSES; c++) {
+		if (size <= qcomtee_memory_pool_class_size(c))
+			return c;
+	}
+
+	return -1;
+}
+
+struct qcomtee_memory *qcomtee_memory_pool_get(struct qcomtee_memory_pool *pool,
+					       int c)
+{
+	struct qcomtee_memory *qcomtee_mem;
+
+	pthread_mutex_lock(&pool->lock);
+	qcomtee_mem = pool->free[c];
+	if (qcomtee_mem) {
+		pool->free[c] = qcomtee_mem->next;
+		pool->nfree[c]--;
+		pool->resident -= qcomtee_mem->mem_info.size;
+		pool->hits++;
+	} else {
+		pool->misses++;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return qcomtee_mem;
+}
+
+int qcomtee_memory_pool_put(struct qcomtee_memory *qcomtee_mem)
+{
+	struct qcomtee_memory_pool *pool = qcomtee_mem->pool;
+	struct qcomtee_object *object = &qcomtee_mem->object;
+	struct qcomtee_object_ops *ops = object->ops;
+	uint64_t tee_object_id = object->tee_object_id;
+	int c = qcomtee_mem->pool_class;
+
+	/* QTEE may still use it; never hand it to another owner. */
+	if (atomic_load(&qcomtee_mem->sent))
+		return -1;
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->nfree[c] >= pool->keep[c]) {
+		pthread_mutex_unlock(&pool->lock);
+
+		return -1;
+	}
+
+	/* Start over as a new object; the shm ID stays with the shm. */
+	QCOMTEE_OBJECT_INIT(object, QCOMTEE_OBJECT_TYPE_MEMORY);
+	object->ops = ops;
+	object->tee_object_id = tee_object_id;
+
+	qcomtee_mem->next = pool->free[c];
+	pool->free[c] = qcomtee_mem;
+	pool->nfree[c]++;
+	pool->resident += qcomtee_mem->mem_info.size;
+	pthread_mutex_unlock(&pool->lock);
+
+	return 0;
+}
+
+static struct qcomtee_memory_pool *
+qcomtee_memory_pool_init(struct root_object *root_object)
+{
+	struct qcomtee_memory_pool *pool;
+	int c;
+
+	pthread_mutex_lock(&mem_pool_init_lock);
+	pool = root_object->mem_pool;
+	if (!pool) {
+		pool = calloc(1, sizeof(*pool));
+		if (pool) {
+			pthread_mutex_init(&pool->lock, NULL);
+			for (c = 0; c < MEM_POOL_CLASSES; c++)
+				pool->keep[c] = MEM_POOL_KEEP;
+
+			root_object->mem_pool = pool;
+		}
+	}
+	pthread_mutex_unlock(&mem_pool_init_lock);
+
+	return pool;
+}
+
+void qcomtee_memory_pool_destroy(struct qcomtee_memory_pool *pool)
+{
+	struct qcomtee_memory *qcomtee_mem;
+	int c;
+
+	for (c = 0; c < MEM_POOL_CLASSES; c++) {
+		while (pool->free[c]) {
+			qcomtee_mem = pool->free[c];
+			pool->free[c] = qcomtee_mem->next;
+			qcomtee_memory_free(qcomtee_mem);
+		}
+	}
+
+	pthread_mutex_destroy(&pool->lock);
+	free(pool);
+}
+
+int qcomtee_memory_pool_prewarm(struct qcomtee_object *root, size_t size,
+				int count)
+{
+	struct qcomtee_memory_pool *pool;
+	struct qcomtee_memory *qcomtee_mem;
+	int c, n;
+
+	if (root == QCOMTEE_OBJECT_NULL ||
+	    root->object_type != QCOMTEE_OBJECT_TYPE_ROOT || count < 0)
+		return -1;
+
+	c = qcomtee_memory_pool_class(size);
+	if (c < 0)
+		return -1;
+
+	pool = qcomtee_memory_pool_init(ROOT_OBJECT(root));
+	if (!pool)
+		return -1;
+
+	size = qcomtee_memory_pool_class_size(c);
+	pthread_mutex_lock(&pool->lock);
+	if (count)
+		pool->keep[c] = count;
+	n = pool->nfree[c];
+	pthread_mutex_unlock(&pool->lock);
+
+	/* Racing allocations may take some; that is what they are for. */
+	for (; n < count; n++) {
+		/* Prewarmed objects are ready to use; fault them in now. */
+		qcomtee_mem = qcomtee_memory_create(root, size,
+						    QCOMTEE_MEMORY_POPULATE);
+		if (!qcomtee_mem)
+			return -1;
+
+		qcomtee_mem->pool = pool;
+		qcomtee_mem->pool_class = c;
+		if (qcomtee_memory_pool_put(qcomtee_mem)) {
+			qcomtee_memory_free(qcomtee_mem);
+			break;
+		}
+	}
+
+	return 0;
+}
+
+int qcomtee_memory_pool_get_stats(struct qcomtee_object *root,
+				  struct qcomtee_memory_pool_stats *stats)
+{
+	struct qcomtee_memory_pool *pool;
+
+	if (root == QCOMTEE_OBJECT_NULL ||
+	    root->object_type != QCOMTEE_OBJECT_TYPE_ROOT)
+		return -1;
+
+	pool = ROOT_OBJECT(root)->mem_pool;
+	if (!pool)
+		return -1;
+
+	pthread_mutex_lock(&pool->lock);
+	stats->hits = pool->hits;
+	stats->misses = pool->misses;
+	stats->resident = pool->resident;
+	pthread_mutex_unlock(&pool->lock);
+
+	return 0;
+}
@@ -0,0 +1,90 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <qcomtee_buf_private.h>
+
+#define BUF_POOL_CLASSES (BUF_POOL_MAX_SHIFT - BUF_POOL_MIN_SHIFT + 1)
+
+/* A free buffer; the link is stored in the buffer itself. */
+struct qcomtee_buf {
+	struct qcomtee_buf *next;
+};
+
+/**
+ * @brief Buffer pool.
+ *
+ * One free list for each power-of-two size class. Buffers larger than
+ * 1 << BUF_POOL_MAX_SHIFT are not pooled.
+ */
+static struct {
+	pthread_mutex_t lock; /**< Lock to protect the free lists. */
+	struct qcomtee_buf *free[BUF_POOL_CLASSES];
+	int count[BUF_POOL_CLASSES]; /**< Number of buffers in free. */
+} buf_pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* Size class of size, or BUF_POOL_CLASSES if it is too large. */
+static int qcomtee_buf_class(size_t size)
+{
+	int c = 0;
+
+	while (c < BUF_POOL_CLASSES &&
+	       ((size_t)1 << (c + BUF_POOL_MIN_SHIFT)) < size)
+		c++;
+
+	return c;
+}
+
+void *qcomtee_buf_alloc(size_t *size)
+{
+	struct qcomtee_buf *buf = NULL;
+	void *ptr;
+	int c;
+
+	c = qcomtee_buf_class(*size);
+	if (c < BUF_POOL_CLASSES) {
+		*size = (size_t)1 << (c + BUF_POOL_MIN_SHIFT);
+
+		pthread_mutex_lock(&buf_pool.lock);
+		buf = buf_pool.free[c];
+		if (buf) {
+			buf_pool.free[c] = buf->next;
+			buf_pool.count[c]--;
+		}
+		pthread_mutex_unlock(&buf_pool.lock);
+
+		if (buf)
+			return buf;
+	}
+
+	if (posix_memalign(&ptr, 64, *size))
+		return NULL;
+
+	return ptr;
+}
+
+void qcomtee_buf_free(void *buf, size_t size)
+{
+	struct qcomtee_buf *b = buf;
+	int c;
+
+	if (!b)
+		return;
+
+	c = qcomtee_buf_class(size);
+	if (c < BUF_POOL_CLASSES) {
+		pthread_mutex_lock(&buf_pool.lock);
+		if (buf_pool.count[c] < BUF_POOL_KEEP) {
+			b->next = buf_pool.free[c];
+			buf_pool.free[c] = b;
+			buf_pool.count[c]++;
+			b = NULL;
+		}
+		pthread_mutex_unlock(&buf_pool.lock);
+	}
+
+	free(b);
+}
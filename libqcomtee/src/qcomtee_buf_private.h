@@ -0,0 +1,46 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef _QCOMTEE_BUF_PRIVATE_H
+#define _QCOMTEE_BUF_PRIVATE_H
+
+#include <stddef.h>
+
+/**
+ * @def BUF_POOL_MIN_SHIFT
+ * @brief log2 of the smallest buffer in the pool.
+ */
+#define BUF_POOL_MIN_SHIFT 8 /* 256 Bytes. */
+
+/**
+ * @def BUF_POOL_MAX_SHIFT
+ * @brief log2 of the largest buffer in the pool.
+ */
+#define BUF_POOL_MAX_SHIFT 20 /* 1 MiB. */
+
+/**
+ * @def BUF_POOL_KEEP
+ * @brief Number of free buffers kept in each size class.
+ */
+#define BUF_POOL_KEEP 16
+
+/**
+ * @brief Allocate a buffer from the pool.
+ *
+ * The size is rounded up to a power of two, at least
+ * 1 << BUF_POOL_MIN_SHIFT. Buffers are aligned to a cache line and are not
+ * zeroed.
+ *
+ * @param size Requested size; on return, the size of the buffer.
+ * @return On success, returns the buffer; Otherwise, returns NULL.
+ */
+void *qcomtee_buf_alloc(size_t *size);
+
+/**
+ * @brief Return a buffer to the pool.
+ * @param buf Buffer from @ref qcomtee_buf_alloc; NULL is ignored.
+ * @param size Size of the buffer returned by @ref qcomtee_buf_alloc.
+ */
+void qcomtee_buf_free(void *buf, size_t size);
+
+#endif // _QCOMTEE_BUF_PRIVATE_H
@@ -0,0 +1,403 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <qcomtee_object_private.h>
+#include <qcomtee_pool_private.h>
+
+/* ''Invocations on the worker pool''. */
+
+/**
+ * @brief A batch in progress.
+ *
+ * Entries are claimed in order by the caller and by helpers running on the
+ * worker pool. The batch lives on the caller's stack; the caller returns
+ * only after every helper has finished or has been removed from the pool.
+ */
+struct qcomtee_batch {
+	struct qcomtee_invoke_desc *descs;
+	int num;
+	atomic_int next; /**< Next entry to claim. */
+
+	int helpers; /**< Number of helpers queued or running. */
+	pthread_mutex_t lock; /**< Lock to protect helpers. */
+	pthread_cond_t cond; /**< Signalled when helpers reaches zero. */
+};
+
+struct qcomtee_batch_helper {
+	struct qcomtee_work work;
+	struct qcomtee_batch *batch;
+};
+
+/* Invoke entries until there is nothing left to claim. */
+static void qcomtee_batch_run(struct qcomtee_batch *batch)
+{
+	struct qcomtee_invoke_desc *desc;
+	int i;
+
+	while ((i = atomic_fetch_add(&batch->next, 1)) < batch->num) {
+		desc = &batch->descs[i];
+		desc->ret = qcomtee_object_invoke(desc->object, desc->op,
+						  desc->params,
+						  desc->num_params,
+						  &desc->result);
+	}
+}
+
+static void qcomtee_batch_helper(struct qcomtee_work *work)
+{
+	struct qcomtee_batch_helper *helper =
+		container_of(work, struct qcomtee_batch_helper, work);
+	struct qcomtee_batch *batch = helper->batch;
+
+	qcomtee_batch_run(batch);
+
+	pthread_mutex_lock(&batch->lock);
+	if (--batch->helpers == 0)
+		pthread_cond_signal(&batch->cond);
+	pthread_mutex_unlock(&batch->lock);
+}
+
+int qcomtee_object_invoke_batch(struct qcomtee_invoke_desc *descs, int num)
+{
+	struct qcomtee_batch_helper helpers[POOL_THREADS_MAX];
+	struct qcomtee_batch batch;
+	int i, n;
+
+	if (num < 0)
+		return -1;
+
+	batch.descs = descs;
+	batch.num = num;
+	atomic_init(&batch.next, 0);
+	batch.helpers = 0;
+	pthread_mutex_init(&batch.lock, NULL);
+	pthread_cond_init(&batch.cond, NULL);
+
+	/* The caller takes one entry itself. */
+	n = num > 1 ? qcomtee_pool_cpus() : 0;
+	if (n > num - 1)
+		n = num - 1;
+
+	pthread_mutex_lock(&batch.lock);
+	for (i = 0; i < n; i++) {
+		helpers[i].work.func = qcomtee_batch_helper;
+		helpers[i].batch = &batch;
+		if (qcomtee_pool_queue(&helpers[i].work))
+			break;
+
+		batch.helpers++;
+	}
+	pthread_mutex_unlock(&batch.lock);
+
+	n = i;
+	qcomtee_batch_run(&batch);
+
+	/* Helpers that did not start yet have nothing left to do. */
+	pthread_mutex_lock(&batch.lock);
+	for (i = 0; i < n; i++) {
+		if (!qcomtee_pool_cancel(&helpers[i].work))
+			batch.helpers--;
+	}
+
+	while (batch.helpers)
+		pthread_cond_wait(&batch.cond, &batch.lock);
+	pthread_mutex_unlock(&batch.lock);
+
+	pthread_cond_destroy(&batch.cond);
+	pthread_mutex_destroy(&batch.lock);
+
+	for (i = 0; i < num; i++) {
+		if (descs[i].ret)
+			return -1;
+	}
+
+	return 0;
+}
+
+#define ASYNC_WORK(a) ((struct qcomtee_work *)(a)->priv)
+#define WORK_ASYNC(w) container_of((w), struct qcomtee_invoke_async, priv)
+
+_Static_assert(sizeof(struct qcomtee_work) <=
+		       sizeof(((struct qcomtee_invoke_async *)0)->priv),
+	       "qcomtee_invoke_async::priv is too small");
+
+/* Report the completion; the caller may reuse async afterwards. */
+static void qcomtee_invoke_async_complete(struct qcomtee_invoke_async *async)
+{
+	void (*complete)(struct qcomtee_invoke_async *) = async->complete;
+	int fd = async->fd;
+	uint64_t one = 1;
+
+	/* Either may hand async back to the caller; it is the last access. */
+	if (complete)
+		complete(async);
+	else
+		atomic_store(&async->done, 1);
+
+	if (fd >= 0) {
+		while (write(fd, &one, sizeof(one)) < 0 && errno == EINTR)
+			;
+	}
+}
+
+static void qcomtee_invoke_async_work(struct qcomtee_work *work)
+{
+	struct qcomtee_invoke_async *async = WORK_ASYNC(work);
+
+	async->ret = qcomtee_object_invoke(async->object, async->op,
+					   async->params, async->num_params,
+					   &async->result);
+
+	qcomtee_invoke_async_complete(async);
+}
+
+int qcomtee_object_invoke_async(struct qcomtee_invoke_async *async)
+{
+	struct qcomtee_object *object = async->object;
+
+	/* Use can only invoke QTEE object ot root object. */
+	if (qcomtee_object_typeof(object) != QCOMTEE_OBJECT_TYPE_ROOT &&
+	    qcomtee_object_typeof(object) != QCOMTEE_OBJECT_TYPE_TEE)
+		return -1;
+
+	async->ret = -1;
+	async->result = QCOMTEE_ERROR_UNAVAIL;
+	atomic_store(&async->done, 0);
+
+	ASYNC_WORK(async)->func = qcomtee_invoke_async_work;
+
+	return qcomtee_pool_queue(ASYNC_WORK(async));
+}
+
+int qcomtee_object_invoke_cancel(struct qcomtee_invoke_async *async)
+{
+	/* Started; async may be complete and reused by now; do not touch it.
+	 * TEE_IOC_OBJECT_INVOKE carries no cancellation ID, so QTEE cannot be
+	 * asked to stop it.
+	 */
+	if (qcomtee_pool_cancel(ASYNC_WORK(async)))
+		return -1;
+
+	/* Not started yet; it never reaches QTEE. */
+	async->ret = 0;
+	async->result = QCOMTEE_ERROR_ABORT;
+	qcomtee_invoke_async_complete(async);
+
+	return 0;
+}
+
+_Static_assert(QCOMTEE_INVOKE_TIMEOUT_PENDING_MAX < POOL_THREADS_MAX,
+	       "timed out invocations may take every worker");
+
+/* Timed out invocations still in QTEE, each holding a worker. */
+static atomic_int invoke_timed_pending;
+
+/**
+ * @brief An invocation with a deadline.
+ *
+ * It is an asynchronous invocation on private copies of the parameters and
+ * buffers, so the caller can leave at the deadline while QTEE still holds
+ * the request. It holds references to the object, its root and the input
+ * objects for the same reason. Whoever is last, the caller or the
+ * completion, frees it. While it runs abandoned, it counts in
+ * invoke_timed_pending.
+ */
+struct qcomtee_invoke_timed {
+	struct qcomtee_invoke_async async;
+	pthread_mutex_t lock; /**< Lock to protect done and abandoned. */
+	pthread_cond_t cond; /**< Signalled on completion. */
+	int done; /**< The invocation is complete. */
+	int abandoned; /**< The caller has left. */
+	struct qcomtee_param params[]; /**< Followed by the buffers. */
+};
+
+static void qcomtee_invoke_timed_free(struct qcomtee_invoke_timed *timed)
+{
+	struct qcomtee_object *object = timed->async.object;
+	struct qcomtee_object *root = object->root;
+	int i;
+
+	/* Drop the references taken by qcomtee_invoke_timed_alloc. */
+	for (i = 0; i < timed->async.num_params; i++) {
+		if (timed->params[i].attr == QCOMTEE_OBJREF_INPUT)
+			qcomtee_object_refs_dec(timed->params[i].object);
+	}
+
+	qcomtee_object_refs_dec(object);
+	qcomtee_object_refs_dec(root);
+
+	pthread_cond_destroy(&timed->cond);
+	pthread_mutex_destroy(&timed->lock);
+	free(timed);
+}
+
+static void qcomtee_invoke_timed_complete(struct qcomtee_invoke_async *async)
+{
+	struct qcomtee_invoke_timed *timed =
+		container_of(async, struct qcomtee_invoke_timed, async);
+	int i;
+
+	pthread_mutex_lock(&timed->lock);
+	if (!timed->abandoned) {
+		timed->done = 1;
+		pthread_cond_signal(&timed->cond);
+		pthread_mutex_unlock(&timed->lock);
+
+		return;
+	}
+	pthread_mutex_unlock(&timed->lock);
+
+	atomic_fetch_sub(&invoke_timed_pending, 1);
+	/* The caller is gone; drop what QTEE returned. */
+	if (!async->ret && async->result == QCOMTEE_OK) {
+		for (i = 0; i < async->num_params; i++) {
+			struct qcomtee_param *param = &timed->params[i];
+
+			if (param->attr == QCOMTEE_OBJREF_OUTPUT)
+				qcomtee_object_refs_dec(param->object);
+		}
+	}
+
+	qcomtee_invoke_timed_free(timed);
+}
+
+/* Allocate the invocation and copy the parameters and input buffers. */
+static struct qcomtee_invoke_timed *
+qcomtee_invoke_timed_alloc(struct qcomtee_object *object, qcomtee_op_t op,
+			   struct qcomtee_param *params, int num_params)
+{
+	struct qcomtee_invoke_timed *timed;
+	pthread_condattr_t attr;
+	size_t size = 0;
+	char *buf;
+	int i;
+
+	for (i = 0; i < num_params; i++) {
+		if (params[i].attr == QCOMTEE_UBUF_INPUT ||
+		    params[i].attr == QCOMTEE_UBUF_OUTPUT)
+			size += (params[i].ubuf.size + 7) & ~(size_t)7;
+	}
+
+	timed = malloc(sizeof(*timed) + num_params * sizeof(*params) + size);
+	if (!timed)
+		return NULL;
+
+	buf = (char *)&timed->params[num_params];
+	for (i = 0; i < num_params; i++) {
+		timed->params[i] = params[i];
+		if (params[i].attr == QCOMTEE_UBUF_INPUT ||
+		    params[i].attr == QCOMTEE_UBUF_OUTPUT) {
+			if (params[i].attr == QCOMTEE_UBUF_INPUT)
+				memcpy(buf, params[i].ubuf.addr,
+				       params[i].ubuf.size);
+			timed->params[i].ubuf.addr = buf;
+			buf += (params[i].ubuf.size + 7) & ~(size_t)7;
+		}
+	}
+
+	/* Keep what QTEE may still be using after the caller has left. */
+	qcomtee_object_refs_inc(object->root);
+	qcomtee_object_refs_inc(object);
+	for (i = 0; i < num_params; i++) {
+		if (params[i].attr == QCOMTEE_OBJREF_INPUT)
+			qcomtee_object_refs_inc(params[i].object);
+	}
+
+	timed->async = QCOMTEE_INVOKE_ASYNC_INIT(object, op, timed->params,
+						 num_params);
+	timed->async.complete = qcomtee_invoke_timed_complete;
+	timed->done = 0;
+	timed->abandoned = 0;
+	pthread_mutex_init(&timed->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&timed->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	return timed;
+}
+
+int qcomtee_object_invoke_timeout(struct qcomtee_object *object,
+				  qcomtee_op_t op,
+				  struct qcomtee_param *params, int num_params,
+				  qcomtee_result_t *result, int timeout_ms)
+{
+	struct qcomtee_invoke_timed *timed;
+	struct timespec ts;
+	int i, ret;
+
+	if (timeout_ms < 0)
+		return qcomtee_object_invoke(object, op, params, num_params,
+					     result);
+
+	/* Keep workers for everything else. */
+	if (atomic_load(&invoke_timed_pending) >=
+	    QCOMTEE_INVOKE_TIMEOUT_PENDING_MAX) {
+		*result = QCOMTEE_ERROR_BUSY;
+		return 0;
+	}
+
+	timed = qcomtee_invoke_timed_alloc(object, op, params, num_params);
+	if (!timed)
+		return -1;
+
+	if (qcomtee_object_invoke_async(&timed->async)) {
+		qcomtee_invoke_timed_free(timed);
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ts.tv_sec += timeout_ms / 1000;
+	ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&timed->lock);
+	while (!timed->done) {
+		if (pthread_cond_timedwait(&timed->cond, &timed->lock, &ts) ==
+		    ETIMEDOUT)
+			break;
+	}
+
+	if (!timed->done) {
+		timed->abandoned = 1;
+		atomic_fetch_add(&invoke_timed_pending, 1);
+		pthread_mutex_unlock(&timed->lock);
+
+		*result = QCOMTEE_ERROR_TIMEOUT;
+		/* If still queued, free it; otherwise, the completion does. */
+		if (!qcomtee_pool_cancel(ASYNC_WORK(&timed->async))) {
+			atomic_fetch_sub(&invoke_timed_pending, 1);
+			qcomtee_invoke_timed_free(timed);
+		}
+
+		return 0;
+	}
+	pthread_mutex_unlock(&timed->lock);
+
+	ret = timed->async.ret;
+	*result = timed->async.result;
+	/* Copy out as qcomtee_object_marshal_out would, only on SUCCESS. */
+	if (!ret && *result == QCOMTEE_OK) {
+		for (i = 0; i < num_params; i++) {
+			if (params[i].attr == QCOMTEE_UBUF_OUTPUT) {
+				params[i].ubuf.size = timed->params[i].ubuf.size;
+				memcpy(params[i].ubuf.addr,
+				       timed->params[i].ubuf.addr,
+				       params[i].ubuf.size);
+			} else if (params[i].attr == QCOMTEE_OBJREF_OUTPUT) {
+				params[i].object = timed->params[i].object;
+			}
+		}
+	}
+
+	qcomtee_invoke_timed_free(timed);
+
+	return ret;
+}
@@ -2,32 +2,231 @@
 // SPDX-License-Identifier: BSD-3-Clause
 
 #include <fcntl.h>
+#include <sched.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include <linux/tee.h>
+#include <qcomtee_buf_private.h>
 #include <qcomtee_object_private.h>
 
 /**
  * @def DISP_BUFFER
- * @brief The size of the buffer allocated for TEE_IOC_SUPPL_RECV
+ * @brief The initial size of the buffer allocated for TEE_IOC_SUPPL_RECV
  *        and TEE_IOC_SUPPL_SEND IOCTLs, which require user buffers for
  *        @ref QCOMTEE_UBUF_INPUT and @ref QCOMTEE_UBUF_OUTPUT parameters.
  */
 #define DISP_BUFFER 1024
 
+/**
+ * @def DISP_BUFFER_MAX
+ * @brief The size the buffer for TEE_IOC_SUPPL_RECV can grow to.
+ */
+#define DISP_BUFFER_MAX (1 << BUF_POOL_MAX_SHIFT)
+
 /**
  * @defgroup ObjectNS Namespace
  * @brief Functions to manage @ref qcomtee_object_namespace "Namespace".
  * @{
  */
 
+#define NS_TABLE_SIZE(t) (1U << (t)->bits)
+#define NS_TABLE_WORDS(t) (NS_TABLE_SIZE(t) / 64)
+
+/**
+ * @brief Hash a QTEE object ID and object type into a bucket index.
+ * @param id QTEE object ID.
+ * @param object_type Object type.
+ * @param bits log2 of the number of buckets.
+ * @return Returns the bucket index.
+ */
+static inline unsigned int qcomtee_object_ns_hash(uint64_t id,
+						  qcomtee_object_type_t object_type,
+						  unsigned int bits)
+{
+	/* Fibonacci hashing; IDs are mostly small and sequential. */
+	return ((id ^ ((uint64_t)object_type << 32)) * 0x9E3779B97F4A7C15ULL) >>
+	       (64 - bits);
+}
+
+/**
+ * @brief Start a lookup in the namespace.
+ * @param ns The namespace to search.
+ * @return Returns the epoch to pass to @ref qcomtee_object_ns_read_unlock.
+ */
+static inline unsigned int
+qcomtee_object_ns_read_lock(struct qcomtee_object_namespace *ns)
+{
+	unsigned int epoch;
+
+	while (1) {
+		epoch = atomic_load(&ns->epoch) & 1;
+		atomic_fetch_add(&ns->readers[epoch], 1);
+		/* If a writer flipped the epoch meanwhile, it may not wait for us. */
+		if ((atomic_load(&ns->epoch) & 1) == epoch)
+			return epoch;
+
+		atomic_fetch_sub(&ns->readers[epoch], 1);
+	}
+}
+
+static inline void
+qcomtee_object_ns_read_unlock(struct qcomtee_object_namespace *ns,
+			      unsigned int epoch)
+{
+	atomic_fetch_sub(&ns->readers[epoch], 1);
+}
+
+/**
+ * @brief Wait for all lookups that may have seen a removed entry.
+ *
+ * The caller should hold the lock. Lookups never block, so this only
+ * waits for a handful of instructions on other threads.
+ *
+ * @param ns The namespace being updated.
+ */
+static void qcomtee_object_ns_synchronize(struct qcomtee_object_namespace *ns)
+{
+	unsigned int epoch;
+
+	epoch = atomic_fetch_add(&ns->epoch, 1) & 1;
+	while (atomic_load(&ns->readers[epoch]))
+		sched_yield();
+}
+
+/**
+ * @brief Allocate an empty namespace table.
+ * @param bits log2 of the number of entries.
+ * @return On success, returns the table; Otherwise, NULL.
+ */
+static struct qcomtee_object_ns_table *
+qcomtee_object_ns_table_alloc(unsigned int bits)
+{
+	struct qcomtee_object_ns_table *table;
+	size_t size = (size_t)1 << bits;
+
+	/* One allocation: the table followed by entries, used, buckets and next. */
+	table = calloc(1, sizeof(*table) +
+				  size * (sizeof(*table->entries) +
+					  sizeof(*table->buckets) +
+					  sizeof(*table->next)) +
+				  (size / 64) * sizeof(*table->used));
+	if (!table)
+		return NULL;
+
+	table->bits = bits;
+	table->entries = (void *)(table + 1);
+	table->used = (void *)(table->entries + size);
+	table->buckets = (void *)(table->used + size / 64);
+	table->next = table->buckets + size;
+	/* ID "0" is never allocated. */
+	table->used[0] = 1;
+
+	return table;
+}
+
+/**
+ * @brief Add an entry to the lookup index of a table.
+ *
+ * The caller should hold the lock. The entry is visible to lookups
+ * once this returns.
+ *
+ * @param table The table to add the entry to.
+ * @param object Object in entries[] to add.
+ */
+static void qcomtee_object_ns_table_link(struct qcomtee_object_ns_table *table,
+					 struct qcomtee_object *object)
+{
+	unsigned int hash;
+
+	hash = qcomtee_object_ns_hash(object->tee_object_id,
+				      object->object_type, table->bits);
+	atomic_store_explicit(&table->next[object->object_id],
+			      atomic_load_explicit(&table->buckets[hash],
+						   memory_order_relaxed),
+			      memory_order_relaxed);
+	/* Publish fully initialized entry. */
+	atomic_store_explicit(&table->buckets[hash], object->object_id,
+			      memory_order_release);
+}
+
+/**
+ * @brief Double the size of the namespace table.
+ *
+ * The caller should hold the lock.
+ *
+ * @param ns The namespace to grow.
+ * @return On success, returns 0; Otherwise, returns -1.
+ */
+static int qcomtee_object_ns_grow(struct qcomtee_object_namespace *ns)
+{
+	struct qcomtee_object_ns_table *table, *new_table;
+	struct qcomtee_object *object;
+	unsigned int idx;
+
+	table = atomic_load_explicit(&ns->table, memory_order_relaxed);
+	if (table->bits == NS_TABLE_BITS_MAX)
+		return -1;
+
+	new_table = qcomtee_object_ns_table_alloc(table->bits + 1);
+	if (!new_table)
+		return -1;
+
+	/* Object IDs do not change; only the lookup index is rebuilt. */
+	memcpy(new_table->used, table->used,
+	       NS_TABLE_WORDS(table) * sizeof(*table->used));
+	for (idx = 1; idx < NS_TABLE_SIZE(table); idx++) {
+		object = atomic_load_explicit(&table->entries[idx],
+					      memory_order_relaxed);
+		if (object == QCOMTEE_OBJECT_NULL)
+			continue;
+
+		atomic_store_explicit(&new_table->entries[idx], object,
+				      memory_order_relaxed);
+		qcomtee_object_ns_table_link(new_table, object);
+	}
+
+	atomic_store_explicit(&ns->table, new_table, memory_order_release);
+	/* Lookups may still walk the old table. */
+	qcomtee_object_ns_synchronize(ns);
+	free(table);
+
+	return 0;
+}
+
+/**
+ * @brief Find the first free entry at or after an index.
+ * @param table The table to search.
+ * @param start Index to start the search from.
+ * @return On success, returns the index; Otherwise, returns 0.
+ */
+static unsigned int
+qcomtee_object_ns_find_free(struct qcomtee_object_ns_table *table,
+			    unsigned int start)
+{
+	unsigned int w = start / 64, words = NS_TABLE_WORDS(table);
+	uint64_t free_bits;
+
+	/* The first word is partial; ignore entries before start. */
+	free_bits = ~table->used[w] & (~0ULL << (start % 64));
+	while (!free_bits) {
+		if (++w == words)
+			return 0;
+
+		free_bits = ~table->used[w];
+	}
+
+	return w * 64 + __builtin_ctzll(free_bits);
+}
+
 /**
  * @brief Initialize object ID.
  *
  * This allocates an ID for the object if and only if it does not
  * already have one. The caller should hold the lock.
  * The ID is allocated in a round-robin fashion, between 1 (inclusive) and
- * TABLE_SIZE (exclusive).
+ * the size of the table (exclusive), so a released ID is not reused before
+ * the rest of the table. If the table is full, it grows.
  *
  * @param object Object to allocate an ID. 
  * @param ns The namespace to which this object belongs.
@@ -37,28 +236,48 @@
 static int qcomtee_object_id_init(struct qcomtee_object *object,
 				  struct qcomtee_object_namespace *ns)
 {
-	int i, idx;
+	struct qcomtee_object_ns_table *table;
+	unsigned int idx, size;
 
 	/* Own an ID?! */
 	if (object->queued)
 		return 1;
 
-	/* Simple id allocator. */
-	for (i = 0; i < TABLE_SIZE; i++) {
-		idx = (ns->current_idx + i) % TABLE_SIZE;
-		/* Skip "0". */
-		if (idx == 0)
-			continue;
+	table = atomic_load_explicit(&ns->table, memory_order_relaxed);
+	size = NS_TABLE_SIZE(table);
 
-		if (ns->entries[idx] == QCOMTEE_OBJECT_NULL) {
-			object->object_id = idx;
-			ns->current_idx = (idx + 1) % TABLE_SIZE;
+	/* Search from current_idx to the end, then wrap around. */
+	idx = qcomtee_object_ns_find_free(table, ns->current_idx);
+	if (!idx)
+		idx = qcomtee_object_ns_find_free(table, 0);
 
-			return 0;
-		}
+	if (!idx) {
+		/* Table is full; the first new slot is free. */
+		if (qcomtee_object_ns_grow(ns))
+			return -1;
+
+		table = atomic_load_explicit(&ns->table, memory_order_relaxed);
+		idx = size;
+		size = NS_TABLE_SIZE(table);
 	}
 
-	return -1;
+	table->used[idx / 64] |= 1ULL << (idx % 64);
+	object->object_id = idx;
+	ns->current_idx = (idx + 1) % size;
+
+	return 0;
+}
+
+/* Count objects in ns and tell the watcher; called with the lock held. */
+static void qcomtee_object_ns_count(struct qcomtee_object_namespace *ns,
+				    int delta)
+{
+	struct root_object *root_object =
+		container_of(ns, struct root_object, ns);
+
+	ns->count += delta;
+	if (root_object->watch && ns->count == (delta > 0 ? 1 : 0))
+		root_object->watch(root_object->watch_arg, ns->count);
 }
 
 /**
@@ -72,6 +291,8 @@ static int qcomtee_object_id_init(struct qcomtee_object *object,
  * identifies these objects as different instances, so if QTEE releases
  * one copy, it cannot continue using it with the same ID.
  *
+ * If no QTEE object ID is assigned to the object, its namespace ID is used.
+ *
  * @param object Object to insert.
  * @param ns Namespace where to insert the object.
  * @return On success, returns the 0; Otherwise, returns -1. 
@@ -79,14 +300,23 @@ static int qcomtee_object_id_init(struct qcomtee_object *object,
 static int qcomtee_object_ns_insert(struct qcomtee_object *object,
 				    struct qcomtee_object_namespace *ns)
 {
+	struct qcomtee_object_ns_table *table;
 	int ret;
 
 	pthread_mutex_lock(&ns->lock);
 	ret = qcomtee_object_id_init(object, ns);
 	if (ret == 0) {
-		ns->entries[object->object_id] = object;
+		if (!object->tee_object_id)
+			object->tee_object_id = object->object_id;
+
+		/* qcomtee_object_id_init may have replaced the table. */
+		table = atomic_load_explicit(&ns->table, memory_order_relaxed);
+		atomic_store_explicit(&table->entries[object->object_id],
+				      object, memory_order_relaxed);
+		qcomtee_object_ns_table_link(table, object);
 		/* Enqueue object. */
 		object->queued = 1;
+		qcomtee_object_ns_count(ns, 1);
 	} else if (ret == 1) {
 		/* Already queued. */
 		ret = 0;
@@ -117,23 +347,31 @@ qcomtee_object_ns_find(uint64_t id, qcomtee_object_type_t object_type,
 		       struct qcomtee_object_namespace *ns)
 {
 	struct qcomtee_object *object = QCOMTEE_OBJECT_NULL;
-	int i;
-
-	pthread_mutex_lock(&ns->lock);
-	for (i = 0; i < TABLE_SIZE; i++) {
-		if (ns->entries[i] != QCOMTEE_OBJECT_NULL &&
-		    ns->entries[i]->tee_object_id == id &&
-		    ns->entries[i]->object_type == object_type) {
-			object = ns->entries[i];
-
+	struct qcomtee_object_ns_table *table;
+	struct qcomtee_object *entry;
+	unsigned int epoch;
+	uint32_t idx;
+
+	epoch = qcomtee_object_ns_read_lock(ns);
+	table = atomic_load_explicit(&ns->table, memory_order_acquire);
+	idx = atomic_load_explicit(
+		&table->buckets[qcomtee_object_ns_hash(id, object_type,
+						       table->bits)],
+		memory_order_acquire);
+	for (; idx; idx = atomic_load_explicit(&table->next[idx],
+					       memory_order_acquire)) {
+		entry = atomic_load_explicit(&table->entries[idx],
+					     memory_order_relaxed);
+		if (entry->tee_object_id == id &&
+		    entry->object_type == object_type) {
 			/* Is object still valid?! */
-			if (qcomtee_object_refs_inc(object))
-				object = QCOMTEE_OBJECT_NULL;
+			if (!qcomtee_object_refs_inc(entry))
+				object = entry;
 
 			break;
 		}
 	}
-	pthread_mutex_unlock(&ns->lock);
+	qcomtee_object_ns_read_unlock(ns, epoch);
 
 	return object;
 }
@@ -142,6 +380,7 @@ qcomtee_object_ns_find(uint64_t id, qcomtee_object_type_t object_type,
  * @brief Delete an object from the namespace.
  *
  * This is only called when the last reference to the object is dropped. 
+ * On return, no lookup references the object, so it can be released.
  *
  * @param object Object to delete.
  * @param ns Namespace to delete the object from.
@@ -149,18 +388,77 @@ qcomtee_object_ns_find(uint64_t id, qcomtee_object_type_t object_type,
 static void qcomtee_object_ns_del(struct qcomtee_object *object,
 				  struct qcomtee_object_namespace *ns)
 {
+	struct qcomtee_object_ns_table *table;
+	_Atomic(uint32_t) *pidx;
+
 	/* It is not queued using qcomtee_object_ns_insert, so nothing to do. */
 	if (object->queued != 1)
 		return;
 
 	pthread_mutex_lock(&ns->lock);
-	/* Dequeue object. */
-	ns->entries[object->object_id] = QCOMTEE_OBJECT_NULL;
+	table = atomic_load_explicit(&ns->table, memory_order_relaxed);
+	/* Remove from the lookup index; next[] stays valid for lookups. */
+	pidx = &table->buckets[qcomtee_object_ns_hash(object->tee_object_id,
+						      object->object_type,
+						      table->bits)];
+	while (atomic_load_explicit(pidx, memory_order_relaxed) !=
+	       object->object_id)
+		pidx = &table->next[atomic_load_explicit(pidx,
+							 memory_order_relaxed)];
+	atomic_store_explicit(pidx,
+			      atomic_load_explicit(&table->next[object->object_id],
+						   memory_order_relaxed),
+			      memory_order_release);
+	qcomtee_object_ns_synchronize(ns);
+	/* Dequeue object; the slot can be reused. */
+	atomic_store_explicit(&table->entries[object->object_id],
+			      QCOMTEE_OBJECT_NULL, memory_order_relaxed);
+	table->used[object->object_id / 64] &=
+		~(1ULL << (object->object_id % 64));
+	qcomtee_object_ns_count(ns, -1);
 	pthread_mutex_unlock(&ns->lock);
 
 	object->queued = 0;
 }
 
+/**
+ * @brief Initialize a namespace.
+ * @param ns The namespace to initialize.
+ * @return On success, returns 0; Otherwise, returns -1.
+ */
+static int qcomtee_object_ns_init(struct qcomtee_object_namespace *ns)
+{
+	struct qcomtee_object_ns_table *table;
+
+	/* Start small; qcomtee_object_id_init grows the table on demand. */
+	table = qcomtee_object_ns_table_alloc(NS_TABLE_BITS_MIN);
+	if (!table)
+		return -1;
+
+	ns->current_idx = 0;
+	ns->count = 0;
+	atomic_init(&ns->table, table);
+	atomic_init(&ns->epoch, 0);
+	atomic_init(&ns->readers[0], 0);
+	atomic_init(&ns->readers[1], 0);
+	pthread_mutex_init(&ns->lock, NULL);
+
+	return 0;
+}
+
+/**
+ * @brief Release a namespace.
+ *
+ * No object should be left in the namespace.
+ *
+ * @param ns The namespace to release.
+ */
+static void qcomtee_object_ns_destroy(struct qcomtee_object_namespace *ns)
+{
+	free(atomic_load(&ns->table));
+	pthread_mutex_destroy(&ns->lock);
+}
+
 /** @} */ // end of ObjectNS
 
 /* OBJECT CLASSES: */
@@ -171,15 +469,45 @@ static void qcomtee_object_ns_del(struct qcomtee_object *object,
 
 /* ''ROOT OBJECT''. */
 
+/* Free the strands of a root object; none is busy. */
+static void qcomtee_strands_free(struct qcomtee_strand_bucket *strands)
+{
+	struct qcomtee_strand *strand;
+	int i;
+
+	for (i = 0; i < ROOT_STRANDS; i++) {
+		while (strands[i].free) {
+			strand = strands[i].free;
+			strands[i].free = strand->next;
+			free(strand);
+		}
+
+		pthread_mutex_destroy(&strands[i].lock);
+	}
+
+	free(strands);
+}
+
 static void qcomtee_object_root_release(struct qcomtee_object *object)
 {
 	struct root_object *root_object = ROOT_OBJECT(object);
+	struct qcomtee_strand_bucket *strands =
+		atomic_load(&root_object->strands);
 
 	if (root_object->release)
 		root_object->release(root_object->arg);
 
+	/* The reader is using fd. */
+	if (root_object->poll)
+		qcomtee_poll_stop(root_object->poll);
+
+	if (root_object->mem_pool)
+		qcomtee_memory_pool_destroy(root_object->mem_pool);
+
 	close(root_object->fd);
-	pthread_mutex_destroy(&root_object->ns.lock);
+	qcomtee_object_ns_destroy(&root_object->ns);
+	if (strands)
+		qcomtee_strands_free(strands);
 	free(root_object);
 }
 
@@ -212,19 +540,67 @@ struct qcomtee_object *qcomtee_object_root_init(const char *dev,
 	}
 
 	/* INIT the namespace. */
-	root_object->ns.current_idx = 0;
-	memset(root_object->ns.entries, 0, sizeof(root_object->ns.entries));
-	pthread_mutex_init(&root_object->ns.lock, NULL);
+	if (qcomtee_object_ns_init(&root_object->ns)) {
+		close(root_object->fd);
+
+		goto failed_out;
+	}
 
 	root_object->release = release;
 	root_object->arg = arg;
+	atomic_init(&root_object->strands, NULL);
+	root_object->poll = NULL;
+	root_object->mem_pool = NULL;
+	root_object->watch = NULL;
 
 	return root_object->object.root;
 
 failed_out:
+	free(root_object);
+
 	return QCOMTEE_OBJECT_NULL;
 }
 
+void qcomtee_object_root_watch(struct qcomtee_object *root,
+			       void (*watch)(void *, int), void *arg)
+{
+	struct root_object *root_object = ROOT_OBJECT(root);
+
+	pthread_mutex_lock(&root_object->ns.lock);
+	root_object->watch = watch;
+	root_object->watch_arg = arg;
+	if (watch && root_object->ns.count)
+		watch(arg, 1);
+	pthread_mutex_unlock(&root_object->ns.lock);
+}
+
+int qcomtee_object_root_strands_init(struct qcomtee_object *root)
+{
+	struct root_object *root_object = ROOT_OBJECT(root);
+	struct qcomtee_strand_bucket *strands, *expected = NULL;
+	int i;
+
+	if (atomic_load(&root_object->strands))
+		return 0;
+
+	strands = malloc(ROOT_STRANDS * sizeof(*strands));
+	if (!strands)
+		return -1;
+
+	for (i = 0; i < ROOT_STRANDS; i++) {
+		pthread_mutex_init(&strands[i].lock, NULL);
+		strands[i].busy = NULL;
+		strands[i].free = NULL;
+	}
+
+	/* Whoever comes second frees its strands and uses the first's. */
+	if (!atomic_compare_exchange_strong(&root_object->strands, &expected,
+					    strands))
+		qcomtee_strands_free(strands);
+
+	return 0;
+}
+
 /* ''QTEE OBJECT''. */
 
 static void qcomtee_object_tee_release(struct qcomtee_object *object)
@@ -364,14 +740,10 @@ static int qcomtee_object_param_to_tee_param(struct tee_ioctl_param *tee_param,
 		if (object->root != root)
 			return -1;
 
-		/* Namespace is full?! */
+		/* Namespace is full?! It also assigns the QTEE object ID. */
 		if (qcomtee_object_ns_insert(object, OBJECT_NS(object)))
 			return -1;
 
-		/* If no QTEE object ID assigned to this object, assign one. */
-		if (!object->tee_object_id)
-			object->tee_object_id = object->object_id;
-
 		tee_param->a = object->tee_object_id;
 
 		if (object_type == QCOMTEE_OBJECT_TYPE_CB)
@@ -440,6 +812,62 @@ qcomtee_object_param_from_tee_param(struct qcomtee_param *param,
  *   - qcomtee_object_cb_marshal_out on callback path to QTEE
  */
 
+/**
+ * @brief Mark the memory objects QTEE accepted in an invocation as sent.
+ *
+ * Call it only once QTEE returned QCOMTEE_OK; a failed invocation did not
+ * give QTEE a copy.
+ *
+ * @param params Parameter array of the invocation.
+ * @param num_params Number of parameter in the array.
+ */
+static void qcomtee_object_mem_sent(struct qcomtee_param *params,
+				    int num_params)
+{
+	int i;
+
+	for (i = 0; i < num_params; i++) {
+		if (params[i].attr == QCOMTEE_OBJREF_INPUT &&
+		    qcomtee_object_typeof(params[i].object) ==
+			    QCOMTEE_OBJECT_TYPE_MEMORY)
+			qcomtee_memory_object_sent(params[i].object);
+	}
+}
+
+/**
+ * @brief Mark the memory objects QTEE accepted in a response as sent.
+ *
+ * Same as @ref qcomtee_object_mem_sent, once TEE_IOC_SUPPL_SEND succeeded.
+ * The objects are found in the namespace, where
+ * @ref qcomtee_object_cb_marshal_out put them.
+ *
+ * @param tee_params Response parameter array, without the meta parameter.
+ * @param num_params Number of parameter in the array.
+ * @param root The root object that the response belongs.
+ */
+static void qcomtee_object_mem_sent_cb(struct tee_ioctl_param *tee_params,
+				       int num_params,
+				       struct qcomtee_object *root)
+{
+	struct qcomtee_object *object;
+	int i;
+
+	for (i = 0; i < num_params; i++) {
+		if (tee_params[i].attr !=
+			    TEE_IOCTL_PARAM_ATTR_TYPE_OBJREF_OUTPUT ||
+		    tee_params[i].b != QCOMTEE_OBJREF_MEM)
+			continue;
+
+		object = qcomtee_object_ns_find(tee_params[i].a,
+						QCOMTEE_OBJECT_TYPE_MEMORY,
+						ROOT_OBJECT_NS(root));
+		if (object != QCOMTEE_OBJECT_NULL) {
+			qcomtee_memory_object_sent(object);
+			qcomtee_object_refs_dec(object);
+		}
+	}
+}
+
 /**
  * @brief Convert array of @ref qcomtee_param to tee_ioctl_param.
  * @param tee_params Output parameter array.
@@ -455,7 +883,9 @@ static int qcomtee_object_marshal_in(struct tee_ioctl_param *tee_params,
 {
 	int i;
 
+	/* tee_params may be reused; initialize every field. */
 	for (i = 0; i < num_params; i++) {
+		tee_params[i].c = 0;
 		switch (params[i].attr) {
 		case QCOMTEE_UBUF_INPUT:
 		case QCOMTEE_UBUF_OUTPUT:
@@ -478,6 +908,8 @@ static int qcomtee_object_marshal_in(struct tee_ioctl_param *tee_params,
 		case QCOMTEE_OBJREF_OUTPUT:
 			tee_params[i].attr =
 				TEE_IOCTL_PARAM_ATTR_TYPE_OBJREF_OUTPUT;
+			tee_params[i].a = 0;
+			tee_params[i].b = 0;
 
 			break;
 		default:
@@ -683,89 +1115,603 @@ union tee_ioctl_arg {
 /* Plus one for the meta parameters. */
 #define DISP_PARAMS_MAX (QCOMTEE_OBJECT_PARAMS_MAX + 1)
 
-/* Direct object invocation. */
-int qcomtee_object_invoke(struct qcomtee_object *object, qcomtee_op_t op,
-			  struct qcomtee_param *params, int num_params,
-			  qcomtee_result_t *result)
+/* QTEE does not support more than 64 parameter. */
+#define INVOKE_PARAMS_MAX 64
+
+/* The number of parameters TEE_IOC_SUPPL_RECV can grow to. */
+#define DISP_PARAMS_LIMIT (INVOKE_PARAMS_MAX + 1)
+
+/* Size of an argument buffer in uint64_t, for np parameters. */
+#define ARG_WORDS(np)                                                       \
+	((sizeof(union tee_ioctl_arg) + (np) * sizeof(struct tee_ioctl_param) + \
+	  sizeof(uint64_t) - 1) /                                           \
+	 sizeof(uint64_t))
+
+#define CACHE_LINE 64
+
+/**
+ * @brief Buffers to receive a request.
+ *
+ * They start with room for DISP_PARAMS_MAX parameters and DISP_BUFFER bytes
+ * of input buffers, and grow when the driver rejects a request that does not
+ * fit; see @ref qcomtee_object_recv_arg. They are kept for the next request.
+ */
+struct qcomtee_disp_buf {
+	union tee_ioctl_arg *arg; /**< Argument buffer. */
+	size_t arg_size; /**< Size of arg. */
+	int num_params; /**< Number of parameters that fit in arg. */
+	uint64_t *buffer; /**< Buffer for the input parameters. */
+	size_t size; /**< Size of buffer. */
+};
+
+static void qcomtee_disp_buf_release(struct qcomtee_disp_buf *db)
 {
-	struct qcomtee_object *root = object->root;
-	struct root_object *root_object = ROOT_OBJECT(root);
-	struct tee_ioctl_buf_data buf_data;
-	struct tee_ioctl_param *tee_params;
-	union tee_ioctl_arg *arg;
+	qcomtee_buf_free(db->arg, db->arg_size);
+	qcomtee_buf_free(db->buffer, db->size);
+	db->arg = NULL;
+	db->buffer = NULL;
+}
 
-	/* Use can only invoke QTEE object ot root object. */
-	if (object->object_type != QCOMTEE_OBJECT_TYPE_ROOT &&
-	    object->object_type != QCOMTEE_OBJECT_TYPE_TEE)
-		return -1;
-	/* QTEE does not support more than 64 parameter. */
-	if (num_params > 64)
+/**
+ * @brief Allocate buffers for num_params parameters and size bytes.
+ * @param db Buffers to allocate.
+ * @param num_params Number of parameters, including the meta parameter.
+ * @param size Size of the buffer for the input parameters.
+ * @return On success, 0; Otherwise, returns -1.
+ */
+static int qcomtee_disp_buf_alloc(struct qcomtee_disp_buf *db, int num_params,
+				  size_t size)
+{
+	db->arg_size = ARG_WORDS(num_params) * sizeof(uint64_t);
+	db->arg = qcomtee_buf_alloc(&db->arg_size);
+	db->size = size;
+	db->buffer = qcomtee_buf_alloc(&db->size);
+	if (!db->arg || !db->buffer) {
+		qcomtee_disp_buf_release(db);
 		return -1;
+	}
 
-	arg = qcomtee_arg_alloca(num_params);
-	if (!arg)
-		return -1;
+	/* Use what the size class leaves room for. */
+	db->num_params = (db->arg_size - sizeof(union tee_ioctl_arg)) /
+			 sizeof(struct tee_ioctl_param);
+	if (db->num_params > DISP_PARAMS_LIMIT)
+		db->num_params = DISP_PARAMS_LIMIT;
 
-	/* INIT IOCTL argument. */
-	buf_data.buf_ptr = (uintptr_t)arg;
-	buf_data.buf_len = sizeof(arg->invoke) +
-			   sizeof(struct tee_ioctl_param) * num_params;
+	return 0;
+}
 
-	/* INVOKE object: */
-	arg->invoke.op = op;
-	arg->invoke.id = object->tee_object_id;
-	arg->invoke.num_params = num_params;
-	tee_params = (struct tee_ioctl_param *)(&arg->invoke + 1);
+static int qcomtee_disp_buf_init(struct qcomtee_disp_buf *db)
+{
+	return qcomtee_disp_buf_alloc(db, DISP_PARAMS_MAX, DISP_BUFFER);
+}
 
-	if (qcomtee_object_marshal_in(tee_params, params, num_params, root))
-		return -1;
+/**
+ * @brief Double the buffers.
+ * @param db Buffers to grow; on failure, they are left as they are.
+ * @return On success, 0; Otherwise, returns -1 if they are as large as they
+ *         can be or there is no memory.
+ */
+static int qcomtee_disp_buf_grow(struct qcomtee_disp_buf *db)
+{
+	struct qcomtee_disp_buf new_db;
+	int num_params;
+	size_t size;
 
-	if (root_object->tee_call(root_object->fd, TEE_IOC_OBJECT_INVOKE,
-				  &buf_data))
+	if (db->num_params >= DISP_PARAMS_LIMIT && db->size >= DISP_BUFFER_MAX)
 		return -1;
 
-	*result = arg->invoke.ret;
-	/* Only marshal out on SUCCESS. */
-	if (arg->invoke.ret)
-		return 0;
+	num_params = db->num_params * 2;
+	if (num_params > DISP_PARAMS_LIMIT)
+		num_params = DISP_PARAMS_LIMIT;
+	size = db->size * 2;
+	if (size > DISP_BUFFER_MAX)
+		size = DISP_BUFFER_MAX;
 
-	/* On failure, qcomtee_object_marshal_out does the cleanup; Override result. */
-	if (qcomtee_object_marshal_out(params, tee_params, num_params, root))
-		*result = QCOMTEE_ERROR_UNAVAIL;
+	if (qcomtee_disp_buf_alloc(&new_db, num_params, size))
+		return -1;
 
-	/* DONE!*/
+	qcomtee_disp_buf_release(db);
+	*db = new_db;
 
 	return 0;
 }
 
-/* See qcomtee_object_dispatch_request docs for return value. */
-#define WITH_RESPONSE 0
-#define WITH_RESPONSE_ERR 1
-#define WITH_RESPONSE_NO_NOTIFY 2
-#define WITHOUT_RESPONSE 3
+/* Go back to the initial size; on failure, db is left as it is. */
+static void qcomtee_disp_buf_reset(struct qcomtee_disp_buf *db)
+{
+	struct qcomtee_disp_buf new_db;
+
+	if (db->num_params <= DISP_PARAMS_MAX && db->size <= DISP_BUFFER)
+		return;
+
+	if (qcomtee_disp_buf_init(&new_db))
+		return;
+
+	qcomtee_disp_buf_release(db);
+	*db = new_db;
+}
 
 /**
- * @brief Dispatch a request.
+ * @brief Per-thread invoke context.
  *
- * This process a request and update the argument buffer if needed.
- * This also handles the reserved operations:
- *    - %ref QCOMTEE_OBJREF_OP_RELEASE
- *
- * @param object Object to dispatch the request for.
- * @param arg The argument buffer for the request.
- * @param root The root object that the request belongs.
- * @return Returns WITHOUT_RESPONSE if the argument buffer has not been updated;
+ * It holds the argument buffers for TEE_IOC_OBJECT_INVOKE and
+ * TEE_IOC_SUPPL_RECV/TEE_IOC_SUPPL_SEND so that they are not allocated and
+ * zeroed on every call. Only the header and the parameters that are used
+ * are initialized. A nested call on the same thread, e.g. releasing a QTEE
+ * object from qcomtee_object_marshal_out, falls back to a stack buffer.
+ */
+struct qcomtee_invoke_ctx {
+	int invoke_busy; /**< invoke_arg is in use. */
+	int process_busy; /**< disp is in use. */
+	struct qcomtee_disp_buf disp; /**< Allocated on first use. */
+	/* Buffer is on its own cache lines. */
+	uint64_t invoke_arg[ARG_WORDS(INVOKE_PARAMS_MAX)]
+		__attribute__((aligned(CACHE_LINE)));
+};
+
+static _Thread_local struct qcomtee_invoke_ctx *invoke_ctx;
+/* Only to free invoke_ctx when the thread exits. */
+static pthread_key_t invoke_ctx_key;
+static pthread_once_t invoke_ctx_once = PTHREAD_ONCE_INIT;
+
+static void qcomtee_invoke_ctx_free(void *arg)
+{
+	struct qcomtee_invoke_ctx *ctx = arg;
+
+	qcomtee_disp_buf_release(&ctx->disp);
+	free(ctx);
+}
+
+static void qcomtee_invoke_ctx_key_init(void)
+{
+	if (pthread_key_create(&invoke_ctx_key, qcomtee_invoke_ctx_free))
+		abort();
+}
+
+/**
+ * @brief Get the invoke context of the calling thread.
+ * @return On success, returns the context; Otherwise, returns NULL.
+ */
+static struct qcomtee_invoke_ctx *qcomtee_invoke_ctx_get(void)
+{
+	void *ctx;
+
+	if (invoke_ctx)
+		return invoke_ctx;
+
+	pthread_once(&invoke_ctx_once, qcomtee_invoke_ctx_key_init);
+	if (posix_memalign(&ctx, CACHE_LINE, sizeof(*invoke_ctx)))
+		return NULL;
+
+	if (pthread_setspecific(invoke_ctx_key, ctx)) {
+		free(ctx);
+		return NULL;
+	}
+
+	invoke_ctx = ctx;
+	invoke_ctx->invoke_busy = 0;
+	invoke_ctx->process_busy = 0;
+	invoke_ctx->disp.arg = NULL;
+	invoke_ctx->disp.buffer = NULL;
+
+	return invoke_ctx;
+}
+
+/**
+ * @brief Invoke a QTEE object using a given argument buffer.
+ * @param arg Argument buffer with room for num_params parameters.
+ * @param object Object being invoked.
+ * @param op Operation to perform.
+ * @param params Parameter array.
+ * @param num_params Number of parameter in the array.
+ * @param result Result of the invocation.
+ * @return On success, 0; Otherwise, returns -1.
+ */
+static int qcomtee_object_invoke_arg(union tee_ioctl_arg *arg,
+				     struct qcomtee_object *object,
+				     qcomtee_op_t op,
+				     struct qcomtee_param *params,
+				     int num_params, qcomtee_result_t *result)
+{
+	struct qcomtee_object *root = object->root;
+	struct root_object *root_object = ROOT_OBJECT(root);
+	struct tee_ioctl_buf_data buf_data;
+	struct tee_ioctl_param *tee_params;
+
+	/* INIT IOCTL argument. */
+	buf_data.buf_ptr = (uintptr_t)arg;
+	buf_data.buf_len = sizeof(arg->invoke) +
+			   sizeof(struct tee_ioctl_param) * num_params;
+
+	/* INVOKE object: */
+	arg->invoke.op = op;
+	arg->invoke.id = object->tee_object_id;
+	arg->invoke.ret = 0;
+	arg->invoke.num_params = num_params;
+	tee_params = (struct tee_ioctl_param *)(&arg->invoke + 1);
+
+	if (qcomtee_object_marshal_in(tee_params, params, num_params, root))
+		return -1;
+
+	if (root_object->tee_call(root_object->fd, TEE_IOC_OBJECT_INVOKE,
+				  &buf_data))
+		return -1;
+
+	*result = arg->invoke.ret;
+	/* Only marshal out on SUCCESS. */
+	if (arg->invoke.ret)
+		return 0;
+
+	qcomtee_object_mem_sent(params, num_params);
+
+	/* On failure, qcomtee_object_marshal_out does the cleanup; Override result. */
+	if (qcomtee_object_marshal_out(params, tee_params, num_params, root))
+		*result = QCOMTEE_ERROR_UNAVAIL;
+
+	/* DONE!*/
+
+	return 0;
+}
+
+/* Direct object invocation. */
+int qcomtee_object_invoke(struct qcomtee_object *object, qcomtee_op_t op,
+			  struct qcomtee_param *params, int num_params,
+			  qcomtee_result_t *result)
+{
+	struct qcomtee_invoke_ctx *ctx;
+	union tee_ioctl_arg *arg;
+	int ret;
+
+	/* Use can only invoke QTEE object ot root object. */
+	if (object->object_type != QCOMTEE_OBJECT_TYPE_ROOT &&
+	    object->object_type != QCOMTEE_OBJECT_TYPE_TEE)
+		return -1;
+	if (num_params > INVOKE_PARAMS_MAX)
+		return -1;
+
+	ctx = qcomtee_invoke_ctx_get();
+	if (ctx && !ctx->invoke_busy) {
+		ctx->invoke_busy = 1;
+		ret = qcomtee_object_invoke_arg(
+			(union tee_ioctl_arg *)ctx->invoke_arg, object, op,
+			params, num_params, result);
+		ctx->invoke_busy = 0;
+
+		return ret;
+	}
+
+	arg = qcomtee_arg_alloca(num_params);
+	if (!arg)
+		return -1;
+
+	return qcomtee_object_invoke_arg(arg, object, op, params, num_params,
+					 result);
+}
+
+/**
+ * @brief Prepared invocation.
+ *
+ * The argument buffer is laid out once by @ref qcomtee_object_invoke_prepare;
+ * @ref qcomtee_object_invoke_exec only patches the parameters that change
+ * from call to call.
+ */
+struct qcomtee_invoke_prepared {
+	struct qcomtee_object *object; /**< Object being invoked. */
+	struct tee_ioctl_buf_data buf_data; /**< IOCTL argument. */
+	int num_ubufs; /**< Number of buffer parameters. */
+	int num_objects; /**< Number of object parameters. */
+	uint8_t ubufs[INVOKE_PARAMS_MAX]; /**< Indexes of buffer parameters. */
+	uint8_t objects[INVOKE_PARAMS_MAX]; /**< Indexes of object parameters. */
+	/* Argument buffer; it follows the structure. */
+	uint64_t arg[] __attribute__((aligned(CACHE_LINE)));
+};
+
+struct qcomtee_invoke_prepared *
+qcomtee_object_invoke_prepare(struct qcomtee_object *object, qcomtee_op_t op,
+			      struct qcomtee_param *params, int num_params)
+{
+	struct qcomtee_invoke_prepared *prepared;
+	struct tee_ioctl_param *tee_params;
+	union tee_ioctl_arg *arg;
+	void *ptr;
+	int i;
+
+	/* Use can only invoke QTEE object ot root object. */
+	if (object->object_type != QCOMTEE_OBJECT_TYPE_ROOT &&
+	    object->object_type != QCOMTEE_OBJECT_TYPE_TEE)
+		return NULL;
+	if (num_params < 0 || num_params > INVOKE_PARAMS_MAX)
+		return NULL;
+
+	if (posix_memalign(&ptr, CACHE_LINE,
+			   sizeof(*prepared) +
+				   ARG_WORDS(num_params) * sizeof(uint64_t)))
+		return NULL;
+
+	prepared = ptr;
+	prepared->num_ubufs = 0;
+	prepared->num_objects = 0;
+
+	arg = (union tee_ioctl_arg *)prepared->arg;
+	arg->invoke.op = op;
+	arg->invoke.id = object->tee_object_id;
+	arg->invoke.ret = 0;
+	arg->invoke.num_params = num_params;
+	tee_params = (struct tee_ioctl_param *)(&arg->invoke + 1);
+
+	/* Same as qcomtee_object_marshal_in, without the values. */
+	for (i = 0; i < num_params; i++) {
+		tee_params[i].a = 0;
+		tee_params[i].b = 0;
+		tee_params[i].c = 0;
+		switch (params[i].attr) {
+		case QCOMTEE_UBUF_INPUT:
+			tee_params[i].attr = TEE_IOCTL_PARAM_ATTR_TYPE_UBUF_INPUT;
+			prepared->ubufs[prepared->num_ubufs++] = i;
+
+			break;
+		case QCOMTEE_UBUF_OUTPUT:
+			tee_params[i].attr = TEE_IOCTL_PARAM_ATTR_TYPE_UBUF_OUTPUT;
+			prepared->ubufs[prepared->num_ubufs++] = i;
+
+			break;
+		case QCOMTEE_OBJREF_INPUT:
+			tee_params[i].attr =
+				TEE_IOCTL_PARAM_ATTR_TYPE_OBJREF_INPUT;
+			prepared->objects[prepared->num_objects++] = i;
+
+			break;
+		case QCOMTEE_OBJREF_OUTPUT:
+			tee_params[i].attr =
+				TEE_IOCTL_PARAM_ATTR_TYPE_OBJREF_OUTPUT;
+			prepared->objects[prepared->num_objects++] = i;
+
+			break;
+		default:
+			free(prepared);
+			return NULL;
+		}
+	}
+
+	prepared->buf_data.buf_ptr = (uintptr_t)arg;
+	prepared->buf_data.buf_len =
+		sizeof(arg->invoke) +
+		sizeof(struct tee_ioctl_param) * num_params;
+
+	/* The object should outlive the prepared invocation. */
+	if (qcomtee_object_refs_inc(object)) {
+		free(prepared);
+		return NULL;
+	}
+
+	prepared->object = object;
+
+	return prepared;
+}
+
+int qcomtee_object_invoke_exec(struct qcomtee_invoke_prepared *prepared,
+			       struct qcomtee_param *params,
+			       qcomtee_result_t *result)
+{
+	struct qcomtee_object *root = prepared->object->root;
+	struct root_object *root_object = ROOT_OBJECT(root);
+	union tee_ioctl_arg *arg = (union tee_ioctl_arg *)prepared->arg;
+	struct tee_ioctl_param *tee_params;
+	int i, j;
+
+	tee_params = (struct tee_ioctl_param *)(&arg->invoke + 1);
+
+	/* Patch what may have changed since the last call. */
+	for (i = 0; i < prepared->num_ubufs; i++) {
+		j = prepared->ubufs[i];
+		tee_params[j].a = (uintptr_t)params[j].ubuf.addr;
+		tee_params[j].b = params[j].ubuf.size;
+	}
+
+	for (i = 0; i < prepared->num_objects; i++) {
+		j = prepared->objects[i];
+		if (tee_params[j].attr ==
+		    TEE_IOCTL_PARAM_ATTR_TYPE_OBJREF_OUTPUT) {
+			tee_params[j].a = 0;
+			tee_params[j].b = 0;
+		} else if (qcomtee_object_param_to_tee_param(&tee_params[j],
+							     &params[j], root)) {
+			return -1;
+		}
+	}
+
+	if (root_object->tee_call(root_object->fd, TEE_IOC_OBJECT_INVOKE,
+				  &prepared->buf_data))
+		return -1;
+
+	*result = arg->invoke.ret;
+	/* Only marshal out on SUCCESS. */
+	if (arg->invoke.ret)
+		return 0;
+
+	/* Output objects need the full qcomtee_object_marshal_out cleanup. */
+	if (prepared->num_objects) {
+		qcomtee_object_mem_sent(params, arg->invoke.num_params);
+
+		if (qcomtee_object_marshal_out(params, tee_params,
+					       arg->invoke.num_params, root))
+			*result = QCOMTEE_ERROR_UNAVAIL;
+
+		return 0;
+	}
+
+	for (i = 0; i < prepared->num_ubufs; i++) {
+		j = prepared->ubufs[i];
+		if (tee_params[j].attr == TEE_IOCTL_PARAM_ATTR_TYPE_UBUF_OUTPUT)
+			params[j].ubuf.size = (size_t)tee_params[j].b;
+	}
+
+	return 0;
+}
+
+void qcomtee_object_invoke_prepared_release(
+	struct qcomtee_invoke_prepared *prepared)
+{
+	if (!prepared)
+		return;
+
+	qcomtee_object_refs_dec(prepared->object);
+	free(prepared);
+}
+
+/* See qcomtee_object_dispatch_request docs for return value. */
+#define WITH_RESPONSE 0
+#define WITH_RESPONSE_ERR 1
+#define WITH_RESPONSE_NO_NOTIFY 2
+#define WITHOUT_RESPONSE 3
+#define WITH_RESPONSE_DEFERRED 4
+
+static void qcomtee_object_dispatch_done(struct qcomtee_object *root,
+					 struct qcomtee_object *object,
+					 union tee_ioctl_arg *arg,
+					 uint64_t request_id, int err);
+
+/**
+ * @brief A deferred request; see @ref qcomtee_object_dispatch_defer.
+ */
+struct qcomtee_deferred {
+	struct qcomtee_object *root;
+	struct qcomtee_object *object; /**< The object invoked; holds a ref. */
+	uint64_t request_id;
+	int num_params; /**< Number of parameters passed to the dispatcher. */
+	struct qcomtee_disp_buf disp; /**< Buffers the request is in. */
+};
+
+/**
+ * @brief The request being dispatched by a thread.
+ */
+struct qcomtee_dispatch_frame {
+	struct qcomtee_object *root;
+	struct qcomtee_object *object;
+	struct qcomtee_disp_buf *db; /**< Buffers the request is in. */
+	int num_params;
+	struct qcomtee_deferred *deferred; /**< Set if deferred. */
+	struct qcomtee_dispatch_frame *prev; /**< Outer dispatch, if nested. */
+};
+
+static _Thread_local struct qcomtee_dispatch_frame *dispatch_frame;
+
+struct qcomtee_deferred *qcomtee_object_dispatch_defer(void)
+{
+	struct qcomtee_dispatch_frame *frame = dispatch_frame;
+	struct qcomtee_deferred *deferred;
+	struct tee_ioctl_param *tee_params;
+	struct qcomtee_disp_buf db;
+
+	if (!frame || frame->deferred)
+		return NULL;
+
+	deferred = malloc(sizeof(*deferred));
+	if (!deferred)
+		return NULL;
+
+	/* The thread keeps receiving with new buffers. */
+	if (qcomtee_disp_buf_init(&db)) {
+		free(deferred);
+		return NULL;
+	}
+
+	tee_params = (struct tee_ioctl_param *)(&frame->db->arg->recv + 1);
+	deferred->root = frame->root;
+	deferred->object = frame->object;
+	deferred->request_id = tee_params[0].b;
+	deferred->num_params = frame->num_params;
+	deferred->disp = *frame->db;
+	*frame->db = db;
+
+	frame->deferred = deferred;
+
+	return deferred;
+}
+
+/**
+ * @brief Prepare the response to a dispatched request.
+ * @param arg The argument buffer for the request.
+ * @param res Result of the dispatcher.
+ * @param params Parameter array passed to the dispatcher.
+ * @param np Number of parameters in params.
+ * @param root The root object that the request belongs.
+ * @return Returns WITH_RESPONSE, WITH_RESPONSE_ERR, or WITH_RESPONSE_NO_NOTIFY;
+ *         see @ref qcomtee_object_dispatch_request.
+ */
+static int qcomtee_object_dispatch_response(union tee_ioctl_arg *arg,
+					    qcomtee_result_t res,
+					    struct qcomtee_param *params,
+					    int np, struct qcomtee_object *root)
+{
+	struct tee_ioctl_param *tee_params;
+
+	if (res != QCOMTEE_OK) {
+		TEE_IOCTL_ARG_SEND_INIT(arg, res, 0);
+		return WITH_RESPONSE_NO_NOTIFY;
+	}
+
+	/* Update response parameters. */
+	tee_params = (struct tee_ioctl_param *)(&arg->send + 1);
+	if (qcomtee_object_cb_marshal_out(tee_params + 1, params, np, root)) {
+		TEE_IOCTL_ARG_SEND_INIT(arg, QCOMTEE_ERROR_UNAVAIL, 0);
+		/* Object requires some form of cleanup. */
+		return WITH_RESPONSE_ERR;
+	}
+
+	/* SUCCESS. */
+	TEE_IOCTL_ARG_SEND_INIT(arg, QCOMTEE_OK, np);
+	return WITH_RESPONSE;
+}
+
+/**
+ * @brief Find the callback object a received request is for.
+ *
+ * This calls @ref qcomtee_object_refs_inc on the object.
+ *
+ * @param root The root object that the request belongs.
+ * @param arg The received request.
+ * @return On success, returns the object;
+ *         Otherwise, returns @ref QCOMTEE_OBJECT_NULL.
+ */
+static struct qcomtee_object *
+qcomtee_object_request_find(struct qcomtee_object *root,
+			    union tee_ioctl_arg *arg)
+{
+	struct tee_ioctl_param *tee_params;
+
+	/* See qcomtee_object_dispatch_arg. */
+	tee_params = (struct tee_ioctl_param *)(&arg->recv + 1);
+
+	return qcomtee_object_ns_find(tee_params[0].a, QCOMTEE_OBJECT_TYPE_CB,
+				      ROOT_OBJECT_NS(root));
+}
+
+/**
+ * @brief Dispatch a request.
+ *
+ * This process a request and update the argument buffer if needed.
+ * This also handles the reserved operations:
+ *    - %ref QCOMTEE_OBJREF_OP_RELEASE
+ *
+ * @param object Object to dispatch the request for.
+ * @param db Buffers the request is in.
+ * @param root The root object that the request belongs.
+ * @return Returns WITHOUT_RESPONSE if the argument buffer has not been updated;
  *         Returns WITH_RESPONSE, WITH_RESPONSE_ERR, or WITH_RESPONSE_NO_NOTIFY
  *         if the argument buffer has been updated, indicating whether there
  *         was a transport error and whether a notification should be sent
- *         to the object.
+ *         to the object. Returns WITH_RESPONSE_DEFERRED if the dispatcher
+ *         deferred the response; the buffers in db have been replaced.
  */
 static int qcomtee_object_dispatch_request(struct qcomtee_object *object,
-					   union tee_ioctl_arg *arg,
+					   struct qcomtee_disp_buf *db,
 					   struct qcomtee_object *root)
 {
-	struct qcomtee_param params[DISP_PARAMS_MAX];
+	struct qcomtee_param params[DISP_PARAMS_LIMIT];
+	struct qcomtee_dispatch_frame frame;
 	struct tee_ioctl_param *tee_params;
+	union tee_ioctl_arg *arg = db->arg;
 	qcomtee_result_t res;
 	qcomtee_op_t op;
 	int np;
@@ -797,93 +1743,149 @@ static int qcomtee_object_dispatch_request(struct qcomtee_object *object,
 		return WITHOUT_RESPONSE;
 
 	default:
+		frame.root = root;
+		frame.object = object;
+		frame.db = db;
+		frame.num_params = np;
+		frame.deferred = NULL;
+		frame.prev = dispatch_frame;
+		dispatch_frame = &frame;
+
 		res = object->ops->dispatch(object, op, params, np);
-		if (res != QCOMTEE_OK) {
-			TEE_IOCTL_ARG_SEND_INIT(arg, res, 0);
-			return WITH_RESPONSE_NO_NOTIFY;
-		}
-	}
 
-	/* Update response parameters. */
-	tee_params = (struct tee_ioctl_param *)(&arg->send + 1);
-	if (qcomtee_object_cb_marshal_out(tee_params + 1, params, np, root)) {
-		TEE_IOCTL_ARG_SEND_INIT(arg, QCOMTEE_ERROR_UNAVAIL, 0);
-		/* Object requires some form of cleanup. */
-		return WITH_RESPONSE_ERR;
+		dispatch_frame = frame.prev;
+		/* The response is sent by qcomtee_object_dispatch_complete. */
+		if (frame.deferred)
+			return WITH_RESPONSE_DEFERRED;
 	}
 
-	/* SUCCESS. */
-	TEE_IOCTL_ARG_SEND_INIT(arg, QCOMTEE_OK, np);
-	return WITH_RESPONSE;
+	return qcomtee_object_dispatch_response(arg, res, params, np, root);
 }
 
-int qcomtee_object_process_one(struct qcomtee_object *root)
+int qcomtee_object_dispatch_complete(struct qcomtee_deferred *deferred,
+				     qcomtee_result_t result,
+				     struct qcomtee_param *params, int num)
 {
-	struct root_object *root_object = ROOT_OBJECT(root);
-	struct tee_ioctl_buf_data buf_data;
-	struct tee_ioctl_param *tee_params;
-	struct qcomtee_object *object;
-	union tee_ioctl_arg *arg;
-	uint64_t request_id;
 	int err;
 
-	/* Buffer used for input parameter for dispatcher. */
-	uint64_t buffer[DISP_BUFFER / sizeof(uint64_t)];
-
-	arg = qcomtee_arg_alloca(DISP_PARAMS_MAX);
-	if (!arg)
+	if (result == QCOMTEE_OK && num != deferred->num_params)
 		return -1;
 
-	buf_data.buf_ptr = (uintptr_t)arg;
+	err = qcomtee_object_dispatch_response(deferred->disp.arg, result,
+					       params, num, deferred->root);
+	qcomtee_object_dispatch_done(deferred->root, deferred->object,
+				     deferred->disp.arg, deferred->request_id,
+				     err);
 
-	/* INIT IOCTL arguments for recv. */
-	buf_data.buf_len = sizeof(arg->recv) +
-			   sizeof(struct tee_ioctl_param) * DISP_PARAMS_MAX;
+	qcomtee_disp_buf_release(&deferred->disp);
+	free(deferred);
 
-	/* RECV: */
-	arg->recv.num_params = DISP_PARAMS_MAX;
+	return 0;
+}
 
-	/* ''Prepare to receive request''.
-	 * tee_params[0] is meta parameter to receive request:
-	 *  - a is buffer for TEE_IOCTL_PARAM_ATTR_TYPE_UBUF_INPUT parameters,
-	 *  - b is buffer size.
-	 */
-	tee_params = (struct tee_ioctl_param *)(&arg->recv + 1);
-	tee_params[0].attr = (TEE_IOCTL_PARAM_ATTR_TYPE_VALUE_INOUT |
-			      TEE_IOCTL_PARAM_ATTR_META);
-	tee_params[0].a = (uintptr_t)buffer;
-	tee_params[0].b = DISP_BUFFER;
-	tee_params[0].c = 0;
+/**
+ * @def DISP_BUF_TOO_SMALL
+ * @brief Error from TEE_IOC_SUPPL_RECV for a request that does not fit.
+ *
+ * The driver rejects a request with more parameters than the argument
+ * buffer has room for, or more input data than the buffer can hold, with
+ * EMSGSIZE and keeps it pending. Any other error, EINVAL included, is a
+ * real failure and is not retried with larger buffers.
+ */
+#define DISP_BUF_TOO_SMALL(err) ((err) == EMSGSIZE)
 
-	/* Wait to receive a request ... */
-	if (root_object->tee_call(root_object->fd, TEE_IOC_SUPPL_RECV,
-				  &buf_data))
-		return -1;
+/**
+ * @brief Receive one request using given buffers.
+ *
+ * If the request does not fit, the buffers are doubled and the receive is
+ * retried, up to DISP_PARAMS_LIMIT parameters and DISP_BUFFER_MAX bytes.
+ * If it still fails, the buffers go back to their initial size.
+ *
+ * @param root The root object for which the request is received.
+ * @param db Buffers to receive the request in.
+ * @return On success, 0; Otherwise, returns -1 and sets errno.
+ */
+static int qcomtee_object_recv_arg(struct qcomtee_object *root,
+				   struct qcomtee_disp_buf *db)
+{
+	struct root_object *root_object = ROOT_OBJECT(root);
+	struct tee_ioctl_buf_data buf_data;
+	struct tee_ioctl_param *tee_params;
+	union tee_ioctl_arg *arg;
+	int i, err;
+
+	while (1) {
+		arg = db->arg;
+		buf_data.buf_ptr = (uintptr_t)arg;
+
+		/* INIT IOCTL arguments for recv. */
+		buf_data.buf_len = sizeof(arg->recv) +
+				   sizeof(struct tee_ioctl_param) *
+					   db->num_params;
+
+		/* RECV: */
+		arg->recv.num_params = db->num_params;
+
+		/* ''Prepare to receive request''.
+		 * tee_params[0] is meta parameter to receive request:
+		 *  - a is buffer for TEE_IOCTL_PARAM_ATTR_TYPE_UBUF_INPUT
+		 *    parameters,
+		 *  - b is buffer size.
+		 */
+		tee_params = (struct tee_ioctl_param *)(&arg->recv + 1);
+		tee_params[0].attr = (TEE_IOCTL_PARAM_ATTR_TYPE_VALUE_INOUT |
+				      TEE_IOCTL_PARAM_ATTR_META);
+		tee_params[0].a = (uintptr_t)db->buffer;
+		tee_params[0].b = db->size;
+		tee_params[0].c = 0;
+		/* arg may be reused; the driver only looks at attr of the
+		 * rest.
+		 */
+		for (i = 1; i < db->num_params; i++)
+			tee_params[i].attr = TEE_IOCTL_PARAM_ATTR_TYPE_NONE;
+
+		/* Wait to receive a request ... */
+		if (!root_object->tee_call(root_object->fd, TEE_IOC_SUPPL_RECV,
+					   &buf_data))
+			return 0;
 
-	/* ''Process received request''.
-	 * tee_params[0] is meta parameter for request information:
-	 *  - a is object ID,
-	 *  - b is request ID.
-	 *  - c is reserved.
-	 */
-	request_id = tee_params[0].b;
+		err = errno;
+		if (DISP_BUF_TOO_SMALL(err) && !qcomtee_disp_buf_grow(db))
+			continue;
 
-	/* Find the requested object and call dispatcher: */
+		qcomtee_disp_buf_reset(db);
+		errno = err;
 
-	object = qcomtee_object_ns_find(tee_params[0].a, QCOMTEE_OBJECT_TYPE_CB,
-					ROOT_OBJECT_NS(root));
-	if (object == QCOMTEE_OBJECT_NULL) {
-		TEE_IOCTL_ARG_SEND_INIT(arg, QCOMTEE_ERROR_DEFUNCT, 0);
-		err = WITH_RESPONSE_NO_NOTIFY;
-
-	} else {
-		/* Is there any response we should send!?*/
-		err = qcomtee_object_dispatch_request(object, arg, root);
-		if (err == WITHOUT_RESPONSE)
-			goto out;
+		return -1;
 	}
+}
+
+/**
+ * @brief Send the response to a request.
+ * @param root The root object for which the request is received.
+ * @param object The object invoked, or NULL; its reference is dropped.
+ * @param arg Argument buffer with the response.
+ * @param request_id ID of the request.
+ * @param err Return value of @ref qcomtee_object_dispatch_request.
+ */
+static void qcomtee_object_dispatch_done(struct qcomtee_object *root,
+					 struct qcomtee_object *object,
+					 union tee_ioctl_arg *arg,
+					 uint64_t request_id, int err)
+{
+	struct root_object *root_object = ROOT_OBJECT(root);
+	struct tee_ioctl_buf_data buf_data;
+	struct tee_ioctl_param *tee_params;
+
+	/* The object is still in use by the deferred request. */
+	if (err == WITH_RESPONSE_DEFERRED)
+		return;
+
+	if (err == WITHOUT_RESPONSE)
+		goto out;
 
 	/* INIT IOCTL arguments for send. */
+	buf_data.buf_ptr = (uintptr_t)arg;
 	buf_data.buf_len = sizeof(arg->send) + sizeof(struct tee_ioctl_param) *
 						       arg->send.num_params;
 
@@ -907,6 +1909,9 @@ int qcomtee_object_process_one(struct qcomtee_object *root)
 				  &buf_data))
 		err = err == WITH_RESPONSE_NO_NOTIFY ? WITH_RESPONSE_NO_NOTIFY :
 						       WITH_RESPONSE_ERR;
+	else if (err == WITH_RESPONSE)
+		qcomtee_object_mem_sent_cb(tee_params + 1,
+					   arg->send.num_params - 1, root);
 
 	/* DONE! */
 
@@ -917,6 +1922,398 @@ int qcomtee_object_process_one(struct qcomtee_object *root)
 
 out:
 	qcomtee_object_refs_dec(object);
+}
+
+/**
+ * @brief Dispatch a received request for an object and send the response.
+ * @param root The root object for which the request is received.
+ * @param object The object invoked; its reference is dropped.
+ * @param db Buffers filled by @ref qcomtee_object_recv_arg; if the response
+ *        is deferred, they are replaced.
+ */
+static void qcomtee_object_dispatch_run(struct qcomtee_object *root,
+					struct qcomtee_object *object,
+					struct qcomtee_disp_buf *db)
+{
+	struct tee_ioctl_param *tee_params;
+	union tee_ioctl_arg *arg = db->arg;
+	uint64_t request_id;
+	int err;
+
+	tee_params = (struct tee_ioctl_param *)(&arg->recv + 1);
+	request_id = tee_params[0].b;
+
+	err = qcomtee_object_dispatch_request(object, db, root);
+	qcomtee_object_dispatch_done(root, object, arg, request_id, err);
+}
+
+/**
+ * @brief A request queued on a strand.
+ *
+ * It owns the buffers the request was received in.
+ */
+struct qcomtee_strand_item {
+	struct qcomtee_strand_item *next;
+	struct qcomtee_object *object; /**< The object invoked. */
+	struct qcomtee_disp_buf disp;
+};
+
+/* Find the busy strand of an object; bucket->lock is held. */
+static struct qcomtee_strand **
+qcomtee_strand_find(struct qcomtee_strand_bucket *bucket,
+		    struct qcomtee_object *object)
+{
+	struct qcomtee_strand **link;
+
+	for (link = &bucket->busy; *link; link = &(*link)->next) {
+		if ((*link)->object == object)
+			break;
+	}
+
+	return link;
+}
+
+/* Make a strand busy for an object; bucket->lock is held. */
+static struct qcomtee_strand *
+qcomtee_strand_start(struct qcomtee_strand_bucket *bucket,
+		     struct qcomtee_object *object)
+{
+	struct qcomtee_strand *strand = bucket->free;
+
+	if (strand)
+		bucket->free = strand->next;
+	else if (!(strand = malloc(sizeof(*strand))))
+		return NULL;
+
+	strand->object = object;
+	strand->head = NULL;
+	strand->tail = &strand->head;
+	strand->next = bucket->busy;
+	bucket->busy = strand;
+
+	return strand;
+}
+
+/* Dispatch the queued requests until the strand is empty, then retire it. */
+static void qcomtee_strand_drain(struct qcomtee_object *root,
+				 struct qcomtee_strand_bucket *bucket,
+				 struct qcomtee_strand *strand)
+{
+	struct qcomtee_strand_item *item;
+	struct qcomtee_strand **link;
+
+	while (1) {
+		pthread_mutex_lock(&bucket->lock);
+		item = strand->head;
+		if (!item) {
+			/* The object may be gone; do not look at it. */
+			for (link = &bucket->busy; *link != strand;
+			     link = &(*link)->next)
+				;
+			*link = strand->next;
+			strand->next = bucket->free;
+			bucket->free = strand;
+			pthread_mutex_unlock(&bucket->lock);
+
+			return;
+		}
+
+		strand->head = item->next;
+		if (!strand->head)
+			strand->tail = &strand->head;
+		pthread_mutex_unlock(&bucket->lock);
+
+		qcomtee_object_dispatch_run(root, item->object, &item->disp);
+		qcomtee_disp_buf_release(&item->disp);
+		free(item);
+	}
+}
+
+/* Answer a request that could not be queued with QCOMTEE_ERROR_MEM. */
+static void qcomtee_strand_fail(struct qcomtee_object *root,
+				struct qcomtee_object *object,
+				struct qcomtee_disp_buf *db)
+{
+	struct tee_ioctl_param *tee_params;
+
+	tee_params = (struct tee_ioctl_param *)(&db->arg->recv + 1);
+	TEE_IOCTL_ARG_SEND_INIT(db->arg, QCOMTEE_ERROR_MEM, 0);
+	qcomtee_object_dispatch_done(root, object, db->arg, tee_params[0].b,
+				     WITH_RESPONSE_NO_NOTIFY);
+}
+
+/**
+ * @brief Dispatch a received request on the object's strand.
+ *
+ * If the object has no busy strand, the request is dispatched by the
+ * calling thread, followed by any request queued meanwhile. Otherwise, the
+ * request is queued with the buffers it was received in, and db gets new
+ * buffers.
+ *
+ * @param root The root object for which the request is received.
+ * @param bucket The strand bucket of the object.
+ * @param object The object invoked; its reference is dropped.
+ * @param db Buffers the request was received in.
+ */
+static void qcomtee_strand_dispatch(struct qcomtee_object *root,
+				    struct qcomtee_strand_bucket *bucket,
+				    struct qcomtee_object *object,
+				    struct qcomtee_disp_buf *db)
+{
+	struct qcomtee_strand_item *item;
+	struct qcomtee_strand *strand;
+	struct qcomtee_disp_buf tmp;
+
+	pthread_mutex_lock(&bucket->lock);
+	if (!*qcomtee_strand_find(bucket, object)) {
+		strand = qcomtee_strand_start(bucket, object);
+		pthread_mutex_unlock(&bucket->lock);
+		if (!strand) {
+			qcomtee_strand_fail(root, object, db);
+
+			return;
+		}
+
+		qcomtee_object_dispatch_run(root, object, db);
+		qcomtee_strand_drain(root, bucket, strand);
+
+		return;
+	}
+	pthread_mutex_unlock(&bucket->lock);
+
+	/* Busy; swap the buffers for new ones, outside the lock. */
+	item = malloc(sizeof(*item));
+	if (!item || qcomtee_disp_buf_init(&tmp)) {
+		free(item);
+		qcomtee_strand_fail(root, object, db);
+
+		return;
+	}
+
+	item->next = NULL;
+	item->object = object;
+	item->disp = *db;
+	*db = tmp;
+
+	pthread_mutex_lock(&bucket->lock);
+	strand = *qcomtee_strand_find(bucket, object);
+	if (strand) {
+		*strand->tail = item;
+		strand->tail = &item->next;
+		pthread_mutex_unlock(&bucket->lock);
+
+		return;
+	}
+
+	/* It is done meanwhile. */
+	strand = qcomtee_strand_start(bucket, object);
+	pthread_mutex_unlock(&bucket->lock);
+	if (strand)
+		qcomtee_object_dispatch_run(root, object, &item->disp);
+	else
+		qcomtee_strand_fail(root, object, &item->disp);
+
+	qcomtee_disp_buf_release(&item->disp);
+	free(item);
+	if (strand)
+		qcomtee_strand_drain(root, bucket, strand);
+}
+
+/**
+ * @brief Dispatch a received request and send the response.
+ * @param root The root object for which the request is received.
+ * @param db Buffers filled by @ref qcomtee_object_recv_arg; if the request
+ *        is queued on a strand, they are replaced.
+ */
+static void qcomtee_object_dispatch_arg(struct qcomtee_object *root,
+					struct qcomtee_disp_buf *db)
+{
+	struct qcomtee_strand_bucket *strands =
+		atomic_load(&ROOT_OBJECT(root)->strands);
+	struct tee_ioctl_param *tee_params;
+	struct qcomtee_object *object;
+	union tee_ioctl_arg *arg = db->arg;
+
+	/* ''Process received request''.
+	 * tee_params[0] is meta parameter for request information:
+	 *  - a is object ID,
+	 *  - b is request ID.
+	 *  - c is reserved.
+	 */
+	tee_params = (struct tee_ioctl_param *)(&arg->recv + 1);
+
+	/* A release may drop the last reference to root; keep it for now. */
+	qcomtee_object_refs_inc(root);
+
+	/* Find the requested object and call dispatcher: */
+
+	object = qcomtee_object_request_find(root, arg);
+	if (object == QCOMTEE_OBJECT_NULL) {
+		TEE_IOCTL_ARG_SEND_INIT(arg, QCOMTEE_ERROR_DEFUNCT, 0);
+		qcomtee_object_dispatch_done(root, object, arg, tee_params[0].b,
+					     WITH_RESPONSE_NO_NOTIFY);
+
+	} else if (strands &&
+		   !(object->ops->flags & QCOMTEE_OBJECT_OPS_REENTRANT)) {
+		qcomtee_strand_dispatch(
+			root, &strands[object->object_id % ROOT_STRANDS],
+			object, db);
+
+	} else {
+		qcomtee_object_dispatch_run(root, object, db);
+	}
+
+	/* It may release root and run its release callback. */
+	qcomtee_object_refs_dec(root);
+}
+
+/**
+ * @brief Receive and process one request using given buffers.
+ * @param root The root object for which the request is received.
+ * @param db Buffers to receive the request in.
+ * @param received If not NULL, called once a request is received.
+ * @param data Argument passed to received.
+ * @return On success, 0; Otherwise, returns -1.
+ */
+static int qcomtee_object_process_arg(struct qcomtee_object *root,
+				      struct qcomtee_disp_buf *db,
+				      void (*received)(void *), void *data)
+{
+	if (qcomtee_object_recv_arg(root, db))
+		return -1;
+
+	if (received)
+		received(data);
+
+	qcomtee_object_dispatch_arg(root, db);
 
 	return 0;
 }
+
+int qcomtee_object_process_one_notify(struct qcomtee_object *root,
+				      void (*received)(void *), void *data)
+{
+	struct qcomtee_invoke_ctx *ctx;
+	struct qcomtee_disp_buf db;
+	int ret, err;
+
+	ctx = qcomtee_invoke_ctx_get();
+	if (ctx && !ctx->process_busy) {
+		if (!ctx->disp.arg && qcomtee_disp_buf_init(&ctx->disp))
+			return -1;
+
+		ctx->process_busy = 1;
+		ret = qcomtee_object_process_arg(root, &ctx->disp, received,
+						 data);
+		ctx->process_busy = 0;
+
+		return ret;
+	}
+
+	/* Nested call; buffers come from the pool. */
+	if (qcomtee_disp_buf_init(&db))
+		return -1;
+
+	ret = qcomtee_object_process_arg(root, &db, received, data);
+	err = errno;
+	qcomtee_disp_buf_release(&db);
+	errno = err;
+
+	return ret;
+}
+
+int qcomtee_object_process_one(struct qcomtee_object *root)
+{
+	return qcomtee_object_process_one_notify(root, NULL, NULL);
+}
+
+/* ''Requests handed over between threads''. */
+
+struct qcomtee_request {
+	struct qcomtee_object *root;
+	struct qcomtee_disp_buf disp;
+	uint64_t queued; /**< When it was queued for dispatch, in ns. */
+};
+
+static uint64_t qcomtee_request_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct qcomtee_request *qcomtee_request_alloc(struct qcomtee_object *root)
+{
+	struct qcomtee_request *req;
+
+	req = malloc(sizeof(*req));
+	if (!req)
+		return NULL;
+
+	if (qcomtee_disp_buf_init(&req->disp)) {
+		free(req);
+		return NULL;
+	}
+
+	req->root = root;
+
+	return req;
+}
+
+void qcomtee_request_free(struct qcomtee_request *req)
+{
+	qcomtee_disp_buf_release(&req->disp);
+	free(req);
+}
+
+int qcomtee_request_recv(struct qcomtee_request *req)
+{
+	return qcomtee_object_recv_arg(req->root, &req->disp);
+}
+
+int qcomtee_request_is_release(struct qcomtee_request *req)
+{
+	return req->disp.arg->recv.func == QCOMTEE_OBJREF_OP_RELEASE;
+}
+
+int qcomtee_request_enqueue(struct qcomtee_request *req)
+{
+	struct qcomtee_object *object;
+	int prio = QCOMTEE_OBJECT_PRIORITY_NORMAL;
+
+	object = qcomtee_object_request_find(req->root, req->disp.arg);
+	if (object != QCOMTEE_OBJECT_NULL) {
+		if (object->ops->priority > 0 &&
+		    object->ops->priority < QCOMTEE_OBJECT_PRIORITY_CLASSES)
+			prio = object->ops->priority;
+		qcomtee_object_refs_dec(object);
+	}
+
+	req->queued = qcomtee_request_now();
+
+	return prio;
+}
+
+uint64_t qcomtee_request_dequeue(struct qcomtee_request *req)
+{
+	return qcomtee_request_now() - req->queued;
+}
+
+void qcomtee_request_process(struct qcomtee_request *req)
+{
+	qcomtee_object_dispatch_arg(req->root, &req->disp);
+}
+
+void qcomtee_request_abort(struct qcomtee_request *req)
+{
+	union tee_ioctl_arg *arg = req->disp.arg;
+	struct tee_ioctl_param *tee_params;
+
+	/* See qcomtee_object_dispatch_arg. */
+	tee_params = (struct tee_ioctl_param *)(&arg->recv + 1);
+	TEE_IOCTL_ARG_SEND_INIT(arg, QCOMTEE_ERROR_ABORT, 0);
+	qcomtee_object_dispatch_done(req->root, QCOMTEE_OBJECT_NULL, arg,
+				     tee_params[0].b, WITH_RESPONSE_NO_NOTIFY);
+}
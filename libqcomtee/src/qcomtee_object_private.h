@@ -9,10 +9,41 @@
 #include <qcomtee_object.h>
 
 /**
- * @def TABLE_SIZE
- * @brief The number of objects that can be exported to QTEE in each root object.
+ * @def NS_TABLE_BITS_MIN
+ * @brief log2 of the initial size of the namespace table.
  */
-#define TABLE_SIZE 1024
+#define NS_TABLE_BITS_MIN 6 /* One word of used[]. */
+
+/**
+ * @def NS_TABLE_BITS_MAX
+ * @brief log2 of the maximum size of the namespace table.
+ *
+ * The number of objects that can be exported to QTEE in each root object
+ * is one less than the maximum size of the table.
+ */
+#define NS_TABLE_BITS_MAX 20
+
+/**
+ * @brief Namespace table.
+ *
+ * The table doubles in size when it is full. A new table is published
+ * and the old one is freed once no lookup is using it.
+ *
+ * The lookup index is keyed by (tee_object_id, object_type). Entries with
+ * the same hash are chained through next[] using their index in entries[].
+ * Index 0 is never allocated, so it terminates a chain.
+ *
+ * Each bit in used[] tracks one entry. A bit is set while its ID is
+ * allocated; it is cleared only after lookups are done with the entry.
+ * Only writers, holding the lock, access used[].
+ */
+struct qcomtee_object_ns_table {
+	unsigned int bits; /**< log2 of the number of entries and buckets. */
+	_Atomic(struct qcomtee_object *) *entries; /**< Callback object table. */
+	_Atomic(uint32_t) *buckets; /**< First entry of each hash bucket. */
+	_Atomic(uint32_t) *next; /**< Next entry in the same bucket. */
+	uint64_t *used; /**< Occupancy bitmap. */
+};
 
 /**
  * @brief Object namespace.
@@ -22,11 +53,65 @@
  * can only be referenced by QTEE in the namespace maintained by the root
  * object. For QTEE objects, the kernel driver guarantees that objects
  * received using a root object are not visible to others.
+ *
+ * Lookups do not take the lock. Writers serialize on the lock and publish
+ * with atomic stores; a slot is reused, an old table freed, and an object
+ * released, only after every lookup that may have seen it has finished
+ * (see readers).
  */
 struct qcomtee_object_namespace {
 	int current_idx; /**< Index to start searching for free entry. */
-	struct qcomtee_object *entries[TABLE_SIZE]; /**< Callback object table. */
-	pthread_mutex_t lock; /**< lock to protect members of this struct. */
+	_Atomic(struct qcomtee_object_ns_table *) table; /**< Current table. */
+
+	/**
+	 * @brief Number of lookups in progress in each epoch.
+	 *
+	 * A lookup registers in the epoch selected by the low bit of epoch.
+	 * A writer flips epoch and waits for the lookups in the previous
+	 * epoch to finish.
+	 */
+	atomic_uint epoch;
+	atomic_int readers[2];
+
+	pthread_mutex_t lock; /**< lock to serialize writers. */
+	int count; /**< Number of objects in the namespace. */
+};
+
+/**
+ * @def ROOT_STRANDS
+ * @brief Number of hash buckets for the strands of a root object; callback
+ *        objects are spread over them by object_id.
+ */
+#define ROOT_STRANDS 64
+
+struct qcomtee_strand_item;
+struct qcomtee_poll;
+struct qcomtee_memory_pool;
+
+/**
+ * @brief Serial executor for a callback object.
+ *
+ * A strand exists while a thread is dispatching for its object; requests
+ * that arrive meanwhile are queued and dispatched by that thread in order.
+ * When the queue is empty, the strand goes back to the free list of its
+ * bucket.
+ */
+struct qcomtee_strand {
+	struct qcomtee_object *object; /**< The object it serializes. */
+	struct qcomtee_strand_item *head; /**< Queued requests. */
+	struct qcomtee_strand_item **tail;
+	struct qcomtee_strand *next; /**< Next strand in the same list. */
+};
+
+/**
+ * @brief Strands of the callback objects that hash to a bucket.
+ *
+ * Objects in the same bucket only share the lock; each has its own strand.
+ */
+struct qcomtee_strand_bucket {
+	pthread_mutex_t lock; /**< Lock to protect the lists. */
+	struct qcomtee_strand *busy; /**< Strands of objects in dispatch. */
+	struct qcomtee_strand *free; /**< Strands kept for reuse. */
 };
 
 /**
@@ -41,6 +126,15 @@ struct root_object {
 	tee_call_t tee_call; /**< API to call to TEE driver (e.g. ioctl()). */
 	void (*release)(void *);
 	void *arg; /**< Argument passed to release. */
+	/* NULL unless strands are enabled; see qcomtee_object_root_strands_init. */
+	_Atomic(struct qcomtee_strand_bucket *) strands;
+	/* NULL unless qcomtee_object_poll_fd has been called. */
+	struct qcomtee_poll *poll;
+	/* NULL unless qcomtee_memory_pool_prewarm has been called. */
+	struct qcomtee_memory_pool *mem_pool;
+	/* See qcomtee_object_root_watch; protected by the namespace lock. */
+	void (*watch)(void *, int);
+	void *watch_arg;
 };
 
 #define ROOT_OBJECT(ro) container_of((ro), struct root_object, object)
@@ -67,4 +161,129 @@ static inline void QCOMTEE_OBJECT_INIT(struct qcomtee_object *object,
 	object->root = QCOMTEE_OBJECT_NULL;
 }
 
+/**
+ * @brief Process single request and report when it is received.
+ *
+ * Same as @ref qcomtee_object_process_one; received is called after a
+ * request is received from QTEE and before it is dispatched, so the caller
+ * can tell a thread waiting in TEE_IOC_SUPPL_RECV from a busy one.
+ *
+ * @param root The root object for which the request queue is checked.
+ * @param received If not NULL, called once a request is received.
+ * @param data Argument passed to received.
+ * @return On success, 0; Otherwise, returns -1.
+ */
+int qcomtee_object_process_one_notify(struct qcomtee_object *root,
+				      void (*received)(void *), void *data);
+
+/**
+ * @brief A request from QTEE with its own buffers.
+ *
+ * Unlike @ref qcomtee_object_process_one, which receives and dispatches on
+ * the calling thread, a request can be received on one thread and
+ * dispatched on another.
+ */
+struct qcomtee_request;
+
+/**
+ * @brief Allocate a request.
+ * @param root The root object for which requests are received.
+ * @return On success, returns the request; Otherwise, returns NULL.
+ */
+struct qcomtee_request *qcomtee_request_alloc(struct qcomtee_object *root);
+
+/**
+ * @brief Free a request.
+ * @param req The request to free.
+ */
+void qcomtee_request_free(struct qcomtee_request *req);
+
+/**
+ * @brief Receive a request from QTEE into req.
+ * @param req The request to receive into.
+ * @return On success, 0; Otherwise, returns -1 and sets errno.
+ */
+int qcomtee_request_recv(struct qcomtee_request *req);
+
+/**
+ * @brief Check if a received request is QCOMTEE_OBJREF_OP_RELEASE.
+ * @param req The received request.
+ * @return Returns non-zero if it is a release request; Otherwise, 0.
+ */
+int qcomtee_request_is_release(struct qcomtee_request *req);
+
+/**
+ * @brief Note that a received request is queued for dispatch.
+ * @param req The received request.
+ * @return Returns the priority class of the object it is for, or
+ *         QCOMTEE_OBJECT_PRIORITY_NORMAL if there is no such object.
+ */
+int qcomtee_request_enqueue(struct qcomtee_request *req);
+
+/**
+ * @brief Note that a request is taken from the queue.
+ * @param req The request passed to @ref qcomtee_request_enqueue.
+ * @return Returns the time it spent in the queue, in ns.
+ */
+uint64_t qcomtee_request_dequeue(struct qcomtee_request *req);
+
+/**
+ * @brief Dispatch a received request and send the response, if any.
+ *
+ * req can be reused for @ref qcomtee_request_recv on return.
+ *
+ * @param req The received request.
+ */
+void qcomtee_request_process(struct qcomtee_request *req);
+
+/**
+ * @brief Send QCOMTEE_ERROR_ABORT for a received request without
+ *        dispatching it.
+ *
+ * It is for requests still queued when a supplicant stops; do not use it
+ * for a release request, which has no response.
+ *
+ * @param req The received request.
+ */
+void qcomtee_request_abort(struct qcomtee_request *req);
+
+/**
+ * @brief Watch a root object for objects exported to QTEE.
+ *
+ * watch is called with a non-zero value when the first object is added to
+ * the namespace, i.e. QTEE may send requests, and with 0 when the last one
+ * is removed. It is called right away if the namespace is not empty.
+ * It is called with the namespace lock held; it should not block.
+ *
+ * @param root The root object.
+ * @param watch Function to call; NULL to stop watching.
+ * @param arg Argument passed to watch.
+ */
+void qcomtee_object_root_watch(struct qcomtee_object *root,
+			       void (*watch)(void *, int), void *arg);
+
+/**
+ * @brief Stop the reader started by @ref qcomtee_object_poll_fd and free
+ *        the queue, including its eventfd.
+ * @param poll The queue of the root object.
+ */
+void qcomtee_poll_stop(struct qcomtee_poll *poll);
+
+/**
+ * @brief Mark a memory object as sent to QTEE.
+ *
+ * It is called once QTEE has accepted the object, i.e. the invocation or
+ * the response that carries it has succeeded. The object is not reused by
+ * the pool after that; see @ref qcomtee_memory_pool_prewarm.
+ *
+ * @param object The memory object.
+ */
+void qcomtee_memory_object_sent(struct qcomtee_object *object);
+
+/**
+ * @brief Free the memory objects kept by a root object and its pool.
+ * @param pool The pool of the root object.
+ */
+void qcomtee_memory_pool_destroy(struct qcomtee_memory_pool *pool);
+
 #endif // _QCOMTEE_OBJECT_PRIVATE_H
@@ -0,0 +1,272 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <qcomtee_object_private.h>
+#include <qcomtee_signal_private.h>
+
+/**
+ * @def POLL_REQUESTS
+ * @brief Requests the reader can receive ahead of the application.
+ */
+#define POLL_REQUESTS 16
+
+/**
+ * @def POLL_KICK_NS
+ * @brief Interval for signalling the reader until it leaves the driver.
+ */
+#define POLL_KICK_NS 1000000
+
+/**
+ * @brief Pollable request queue of a root object.
+ *
+ * TEE_IOC_SUPPL_RECV blocks and the driver's fd cannot be polled, so a
+ * reader thread receives requests into free requests and queues them on
+ * ready. It writes to efd for each one; the application dispatches them in
+ * @ref qcomtee_object_process_ready. This handoff is the cost of the
+ * driver's interface; the dispatch itself stays on the application's
+ * thread.
+ *
+ * The reader is woken from TEE_IOC_SUPPL_RECV with a signal, as in
+ * @ref qcomtee_supplicant_stop; an eventfd cannot interrupt the ioctl. It
+ * is signalled only while waiting is set.
+ */
+struct qcomtee_poll {
+	struct qcomtee_object *root;
+	int efd; /**< The eventfd returned by qcomtee_object_poll_fd. */
+	int signo;
+	pthread_t reader;
+
+	pthread_mutex_t lock; /**< Lock to protect the fields below. */
+	pthread_cond_t cond; /**< Signalled when a request is freed. */
+	int stop;
+	int waiting; /**< The reader is in the driver, or about to be. */
+	int exited;
+	struct qcomtee_request *free[POLL_REQUESTS];
+	int nfree;
+	struct qcomtee_request *ready[POLL_REQUESTS];
+	int head; /**< Index of the oldest request in ready. */
+	int nready;
+
+	struct qcomtee_request *requests[POLL_REQUESTS];
+	int nrequests;
+};
+
+/* Serialize qcomtee_object_poll_fd calls. */
+static pthread_mutex_t poll_init_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *qcomtee_poll_reader(void *arg)
+{
+	struct qcomtee_poll *poll = arg;
+	struct qcomtee_request *req;
+	sigset_t set;
+	int err;
+
+	sigemptyset(&set);
+	sigaddset(&set, poll->signo);
+	pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+
+	pthread_mutex_lock(&poll->lock);
+	while (1) {
+		/* Wait for the application to catch up. */
+		while (!poll->nfree && !poll->stop)
+			pthread_cond_wait(&poll->cond, &poll->lock);
+
+		if (poll->stop)
+			break;
+
+		req = poll->free[--poll->nfree];
+		poll->waiting = 1;
+		pthread_mutex_unlock(&poll->lock);
+
+		err = 0;
+		if (qcomtee_request_recv(req))
+			err = errno;
+
+		pthread_mutex_lock(&poll->lock);
+		poll->waiting = 0;
+		if (err) {
+			poll->free[poll->nfree++] = req;
+			if (err == EINTR)
+				continue;
+
+			MSGE("%s: %s\n", __func__, strerror(err));
+			break;
+		}
+
+		poll->ready[(poll->head + poll->nready) % POLL_REQUESTS] = req;
+		poll->nready++;
+		eventfd_write(poll->efd, 1);
+	}
+
+	poll->exited = 1;
+	pthread_mutex_unlock(&poll->lock);
+
+	return NULL;
+}
+
+static void qcomtee_poll_free(struct qcomtee_poll *poll)
+{
+	struct qcomtee_request *req;
+	int i;
+
+	/* Answer what the application has not processed; QTEE waits. */
+	for (; poll->nready; poll->nready--) {
+		req = poll->ready[poll->head];
+		poll->head = (poll->head + 1) % POLL_REQUESTS;
+		if (!qcomtee_request_is_release(req))
+			qcomtee_request_abort(req);
+	}
+
+	for (i = 0; i < poll->nrequests; i++)
+		qcomtee_request_free(poll->requests[i]);
+
+	close(poll->efd);
+	pthread_cond_destroy(&poll->cond);
+	pthread_mutex_destroy(&poll->lock);
+	qcomtee_signal_put(poll->signo);
+	free(poll);
+}
+
+static struct qcomtee_poll *qcomtee_poll_start(struct qcomtee_object *root,
+					       int signo)
+{
+	struct qcomtee_poll *poll;
+	sigset_t set, oldset;
+	int ret;
+
+	if (qcomtee_signal_get(signo))
+		return NULL;
+
+	poll = calloc(1, sizeof(*poll));
+	if (!poll) {
+		qcomtee_signal_put(signo);
+		return NULL;
+	}
+
+	poll->root = root;
+	poll->signo = signo;
+	pthread_mutex_init(&poll->lock, NULL);
+	pthread_cond_init(&poll->cond, NULL);
+
+	poll->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (poll->efd < 0)
+		goto failed_out;
+
+	for (; poll->nrequests < POLL_REQUESTS; poll->nrequests++) {
+		poll->requests[poll->nrequests] = qcomtee_request_alloc(root);
+		if (!poll->requests[poll->nrequests])
+			goto failed_out;
+
+		poll->free[poll->nfree++] = poll->requests[poll->nrequests];
+	}
+
+	/* Leave other signals to the application. */
+	sigfillset(&set);
+	pthread_sigmask(SIG_SETMASK, &set, &oldset);
+	ret = pthread_create(&poll->reader, NULL, qcomtee_poll_reader, poll);
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+	if (ret)
+		goto failed_out;
+
+	return poll;
+
+failed_out:
+	if (poll->efd >= 0) {
+		qcomtee_poll_free(poll);
+	} else {
+		qcomtee_signal_put(signo);
+		free(poll);
+	}
+
+	return NULL;
+}
+
+void qcomtee_poll_stop(struct qcomtee_poll *poll)
+{
+	struct timespec ts = { 0, POLL_KICK_NS };
+
+	pthread_mutex_lock(&poll->lock);
+	poll->stop = 1;
+	pthread_cond_broadcast(&poll->cond);
+	while (!poll->exited) {
+		/* It may miss a signal just before entering the driver. */
+		if (poll->waiting)
+			pthread_kill(poll->reader, poll->signo);
+
+		pthread_mutex_unlock(&poll->lock);
+		nanosleep(&ts, NULL);
+		pthread_mutex_lock(&poll->lock);
+	}
+	pthread_mutex_unlock(&poll->lock);
+
+	pthread_join(poll->reader, NULL);
+	qcomtee_poll_free(poll);
+}
+
+int qcomtee_object_poll_fd(struct qcomtee_object *root, int signo)
+{
+	struct root_object *root_object;
+
+	if (root == QCOMTEE_OBJECT_NULL ||
+	    root->object_type != QCOMTEE_OBJECT_TYPE_ROOT)
+		return -1;
+
+	root_object = ROOT_OBJECT(root);
+
+	pthread_mutex_lock(&poll_init_lock);
+	if (!root_object->poll)
+		root_object->poll =
+			qcomtee_poll_start(root, signo ? signo : SIGRTMIN);
+	pthread_mutex_unlock(&poll_init_lock);
+
+	return root_object->poll ? root_object->poll->efd : -1;
+}
+
+int qcomtee_object_process_ready(struct qcomtee_object *root)
+{
+	struct qcomtee_poll *poll = ROOT_OBJECT(root)->poll;
+	struct qcomtee_request *req;
+	eventfd_t value;
+	int n = 0;
+
+	if (!poll)
+		return -1;
+
+	/* Clear it first; a request queued after this sets it again. */
+	eventfd_read(poll->efd, &value);
+
+	/* A release may drop the last reference to root; keep it for now. */
+	qcomtee_object_refs_inc(root);
+
+	while (1) {
+		pthread_mutex_lock(&poll->lock);
+		if (!poll->nready) {
+			pthread_mutex_unlock(&poll->lock);
+			break;
+		}
+
+		req = poll->ready[poll->head];
+		poll->head = (poll->head + 1) % POLL_REQUESTS;
+		poll->nready--;
+		pthread_mutex_unlock(&poll->lock);
+
+		qcomtee_request_process(req);
+		n++;
+
+		pthread_mutex_lock(&poll->lock);
+		poll->free[poll->nfree++] = req;
+		pthread_cond_signal(&poll->cond);
+		pthread_mutex_unlock(&poll->lock);
+	}
+
+	qcomtee_object_refs_dec(root);
+
+	return n;
+}
@@ -0,0 +1,169 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <qcomtee_pool_private.h>
+
+/**
+ * @brief Worker pool.
+ *
+ * A FIFO of work items. A thread is started when an item is queued and
+ * there are more items than idle threads; a thread exits when it has been
+ * idle for POOL_LINGER_SEC.
+ */
+static struct {
+	pthread_mutex_t lock; /**< Lock to protect the pool. */
+	pthread_cond_t cond; /**< Signalled when an item is queued. */
+	struct qcomtee_work *head;
+	struct qcomtee_work *tail;
+	int queued; /**< Number of items in the queue. */
+	int nthreads; /**< Number of threads. */
+	int idle; /**< Number of threads waiting for an item. */
+} pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static int pool_cpus;
+
+static void *qcomtee_pool_worker(void *arg)
+{
+	struct qcomtee_work *work;
+	struct timespec ts;
+	int err;
+
+	(void)arg;
+
+	pthread_mutex_lock(&pool.lock);
+	while (1) {
+		err = 0;
+		while (!pool.head && err != ETIMEDOUT) {
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_sec += POOL_LINGER_SEC;
+
+			pool.idle++;
+			err = pthread_cond_timedwait(&pool.cond, &pool.lock,
+						     &ts);
+			pool.idle--;
+		}
+
+		if (!pool.head)
+			break;
+
+		work = pool.head;
+		pool.head = work->next;
+		if (!pool.head)
+			pool.tail = NULL;
+		pool.queued--;
+		pthread_mutex_unlock(&pool.lock);
+
+		work->func(work);
+
+		pthread_mutex_lock(&pool.lock);
+	}
+
+	pool.nthreads--;
+	pthread_mutex_unlock(&pool.lock);
+
+	return NULL;
+}
+
+/* Start a worker; called with the pool lock held. */
+static int qcomtee_pool_start_worker(void)
+{
+	sigset_t set, oldset;
+	pthread_attr_t attr;
+	pthread_t thread;
+	int ret;
+
+	if (pthread_attr_init(&attr))
+		return -1;
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	/* Workers inherit the signal mask; leave signals to the application. */
+	sigfillset(&set);
+	pthread_sigmask(SIG_SETMASK, &set, &oldset);
+	ret = pthread_create(&thread, &attr, qcomtee_pool_worker, NULL);
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+
+	pthread_attr_destroy(&attr);
+	if (ret)
+		return -1;
+
+	pool.nthreads++;
+
+	return 0;
+}
+
+static void qcomtee_pool_init(void)
+{
+	long n;
+
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n < 1)
+		n = 1;
+	if (n > POOL_THREADS_MAX)
+		n = POOL_THREADS_MAX;
+
+	pool_cpus = n;
+}
+
+int qcomtee_pool_cpus(void)
+{
+	pthread_once(&pool_once, qcomtee_pool_init);
+
+	return pool_cpus;
+}
+
+int qcomtee_pool_queue(struct qcomtee_work *work)
+{
+	work->next = NULL;
+
+	pthread_mutex_lock(&pool.lock);
+	if (pool.queued >= pool.idle && pool.nthreads < POOL_THREADS_MAX) {
+		/* No thread at all is a failure; otherwise, just wait. */
+		if (qcomtee_pool_start_worker() && !pool.nthreads) {
+			pthread_mutex_unlock(&pool.lock);
+			return -1;
+		}
+	}
+
+	if (pool.tail)
+		pool.tail->next = work;
+	else
+		pool.head = work;
+	pool.tail = work;
+	pool.queued++;
+	pthread_cond_signal(&pool.cond);
+	pthread_mutex_unlock(&pool.lock);
+
+	return 0;
+}
+
+int qcomtee_pool_cancel(struct qcomtee_work *work)
+{
+	struct qcomtee_work **p, *prev = NULL;
+	int ret = -1;
+
+	pthread_mutex_lock(&pool.lock);
+	for (p = &pool.head; *p; prev = *p, p = &(*p)->next) {
+		if (*p == work) {
+			*p = work->next;
+			if (pool.tail == work)
+				pool.tail = prev;
+			pool.queued--;
+			ret = 0;
+
+			break;
+		}
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	return ret;
+}
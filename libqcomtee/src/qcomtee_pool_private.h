@@ -0,0 +1,57 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef _QCOMTEE_POOL_PRIVATE_H
+#define _QCOMTEE_POOL_PRIVATE_H
+
+/**
+ * @def POOL_THREADS_MAX
+ * @brief Maximum number of threads in the worker pool.
+ *
+ * Work items mostly block in QTEE, so the pool is not limited to the
+ * number of CPUs.
+ */
+#define POOL_THREADS_MAX 64
+
+/**
+ * @def POOL_LINGER_SEC
+ * @brief Seconds an idle worker waits for work before it exits.
+ */
+#define POOL_LINGER_SEC 10
+
+/**
+ * @brief Work item for the worker pool.
+ *
+ * The item is owned by the caller and should stay valid until func is
+ * called or @ref qcomtee_pool_cancel removes it.
+ */
+struct qcomtee_work {
+	void (*func)(struct qcomtee_work *work); /**< Called by a worker. */
+	struct qcomtee_work *next; /**< Next item in the queue. */
+};
+
+/**
+ * @brief Queue a work item to the worker pool.
+ *
+ * It starts a new worker if every worker is busy.
+ *
+ * @param work The work item to run.
+ * @return On success, 0; Otherwise, returns -1 if there is no worker.
+ */
+int qcomtee_pool_queue(struct qcomtee_work *work);
+
+/**
+ * @brief Remove a work item that has not been started yet.
+ * @param work The work item queued with @ref qcomtee_pool_queue.
+ * @return Returns 0 if the item is removed; Otherwise, returns -1 if a
+ *         worker has already taken it.
+ */
+int qcomtee_pool_cancel(struct qcomtee_work *work);
+
+/**
+ * @brief Number of online CPUs.
+ * @return Returns the number of CPUs, at most POOL_THREADS_MAX.
+ */
+int qcomtee_pool_cpus(void);
+
+#endif // _QCOMTEE_POOL_PRIVATE_H
@@ -0,0 +1,99 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <qcomtee_ring_private.h>
+
+int qcomtee_ring_init(struct qcomtee_ring *ring, size_t size)
+{
+	size_t i;
+
+	if (!size || (size & (size - 1)))
+		return -1;
+
+	ring->cells = malloc(size * sizeof(*ring->cells));
+	if (!ring->cells)
+		return -1;
+
+	for (i = 0; i < size; i++)
+		atomic_init(&ring->cells[i].seq, i);
+
+	ring->mask = size - 1;
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+
+	return 0;
+}
+
+void qcomtee_ring_destroy(struct qcomtee_ring *ring)
+{
+	free(ring->cells);
+}
+
+int qcomtee_ring_push(struct qcomtee_ring *ring, void *data)
+{
+	struct qcomtee_ring_cell *cell;
+	size_t pos, seq;
+	intptr_t diff;
+
+	pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	while (1) {
+		cell = &ring->cells[pos & ring->mask];
+		seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+		diff = (intptr_t)seq - (intptr_t)pos;
+		if (diff == 0) {
+			/* The cell is free; claim the position. */
+			if (atomic_compare_exchange_weak_explicit(
+				    &ring->head, &pos, pos + 1,
+				    memory_order_relaxed, memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			/* A lap behind the consumers; full. */
+			return -1;
+		} else {
+			pos = atomic_load_explicit(&ring->head,
+						   memory_order_relaxed);
+		}
+	}
+
+	cell->data = data;
+	atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+
+	return 0;
+}
+
+void *qcomtee_ring_pop(struct qcomtee_ring *ring)
+{
+	struct qcomtee_ring_cell *cell;
+	size_t pos, seq;
+	intptr_t diff;
+	void *data;
+
+	pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	while (1) {
+		cell = &ring->cells[pos & ring->mask];
+		seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+		diff = (intptr_t)seq - (intptr_t)(pos + 1);
+		if (diff == 0) {
+			/* The cell is written; claim the position. */
+			if (atomic_compare_exchange_weak_explicit(
+				    &ring->tail, &pos, pos + 1,
+				    memory_order_relaxed, memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			/* Nothing written at this position yet; empty. */
+			return NULL;
+		} else {
+			pos = atomic_load_explicit(&ring->tail,
+						   memory_order_relaxed);
+		}
+	}
+
+	data = cell->data;
+	/* Hand the cell to the producer one lap ahead. */
+	atomic_store_explicit(&cell->seq, pos + ring->mask + 1,
+			      memory_order_release);
+
+	return data;
+}
@@ -0,0 +1,70 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef _QCOMTEE_RING_PRIVATE_H
+#define _QCOMTEE_RING_PRIVATE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/**
+ * @brief A cell in the ring.
+ *
+ * seq tells whose turn it is: a producer at position pos may write the cell
+ * when seq == pos; a consumer at position pos may read it when
+ * seq == pos + 1.
+ */
+struct qcomtee_ring_cell {
+	atomic_size_t seq;
+	void *data;
+};
+
+/**
+ * @brief Bounded lock-free multi-producer multi-consumer ring of pointers.
+ *
+ * Producers and consumers each claim a position with a compare-and-swap on
+ * their own counter and then hand the cell over through its seq, so they
+ * never wait on each other except for the cell they share.
+ */
+struct qcomtee_ring {
+	size_t mask; /**< Number of cells minus one. */
+	struct qcomtee_ring_cell *cells;
+	/* Counters are on their own cache lines. */
+	atomic_size_t head __attribute__((aligned(64))); /**< Next to push. */
+	atomic_size_t tail __attribute__((aligned(64))); /**< Next to pop. */
+};
+
+/**
+ * @brief Initialize a ring.
+ * @param ring The ring to initialize.
+ * @param size Number of cells; a power of two.
+ * @return On success, 0; Otherwise, returns -1.
+ */
+int qcomtee_ring_init(struct qcomtee_ring *ring, size_t size);
+
+/**
+ * @brief Release the cells of a ring.
+ * @param ring The ring to destroy.
+ */
+void qcomtee_ring_destroy(struct qcomtee_ring *ring);
+
+/**
+ * @brief Add a pointer to the ring.
+ * @param ring The ring.
+ * @param data The pointer to add.
+ * @return On success, 0; Otherwise, returns -1 if the ring is full.
+ */
+int qcomtee_ring_push(struct qcomtee_ring *ring, void *data);
+
+/**
+ * @brief Take the oldest pointer from the ring.
+ *
+ * It may return NULL while a producer that claimed an earlier position is
+ * still writing its cell.
+ *
+ * @param ring The ring.
+ * @return Returns the pointer; Otherwise, returns NULL if the ring is empty.
+ */
+void *qcomtee_ring_pop(struct qcomtee_ring *ring);
+
+#endif // _QCOMTEE_RING_PRIVATE_H
@@ -0,0 +1,83 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <qcomtee_sched_private.h>
+
+/* Classes from the most to the least urgent. */
+static const int sched_rank[QCOMTEE_OBJECT_PRIORITY_CLASSES] = {
+	QCOMTEE_OBJECT_PRIORITY_HIGH,
+	QCOMTEE_OBJECT_PRIORITY_NORMAL,
+	QCOMTEE_OBJECT_PRIORITY_BULK,
+};
+
+void qcomtee_sched_init(struct qcomtee_sched *sched)
+{
+	int c;
+
+	for (c = 0; c < QCOMTEE_OBJECT_PRIORITY_CLASSES; c++) {
+		atomic_init(&sched->queued[c], 0);
+		atomic_init(&sched->passed[c], 0);
+		atomic_init(&sched->dispatched[c], 0);
+		atomic_init(&sched->wait_ns[c], 0);
+		atomic_init(&sched->wait_max_ns[c], 0);
+	}
+}
+
+void qcomtee_sched_queued(struct qcomtee_sched *sched, int prio)
+{
+	atomic_fetch_add(&sched->queued[prio], 1);
+}
+
+void qcomtee_sched_order(struct qcomtee_sched *sched,
+			 int order[QCOMTEE_OBJECT_PRIORITY_CLASSES])
+{
+	int i, n, starved = 0, most = SCHED_STARVE_LIMIT - 1;
+
+	for (i = 0; i < QCOMTEE_OBJECT_PRIORITY_CLASSES; i++) {
+		order[i] = sched_rank[i];
+		n = atomic_load(&sched->passed[order[i]]);
+		if (n > most) {
+			most = n;
+			starved = i;
+		}
+	}
+
+	/* Move the starved class to the front; the rest keep their rank. */
+	for (i = starved; i > 0; i--)
+		order[i] = order[i - 1];
+	order[0] = sched_rank[starved];
+}
+
+void qcomtee_sched_taken(struct qcomtee_sched *sched, int prio,
+			 uint64_t wait_ns)
+{
+	uint64_t max;
+	int c;
+
+	atomic_fetch_sub(&sched->queued[prio], 1);
+	atomic_store(&sched->passed[prio], 0);
+	for (c = 0; c < QCOMTEE_OBJECT_PRIORITY_CLASSES; c++) {
+		if (c != prio && atomic_load(&sched->queued[c]) > 0)
+			atomic_fetch_add(&sched->passed[c], 1);
+	}
+
+	atomic_fetch_add(&sched->dispatched[prio], 1);
+	atomic_fetch_add(&sched->wait_ns[prio], wait_ns);
+	max = atomic_load(&sched->wait_max_ns[prio]);
+	while (wait_ns > max &&
+	       !atomic_compare_exchange_weak(&sched->wait_max_ns[prio], &max,
+					     wait_ns))
+		;
+}
+
+void qcomtee_sched_get_stats(struct qcomtee_sched *sched,
+			     struct qcomtee_supplicant_stats *stats)
+{
+	int c;
+
+	for (c = 0; c < QCOMTEE_OBJECT_PRIORITY_CLASSES; c++) {
+		stats->dispatched[c] = atomic_load(&sched->dispatched[c]);
+		stats->wait_ns[c] = atomic_load(&sched->wait_ns[c]);
+		stats->wait_max_ns[c] = atomic_load(&sched->wait_max_ns[c]);
+	}
+}
@@ -0,0 +1,80 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef _QCOMTEE_SCHED_PRIVATE_H
+#define _QCOMTEE_SCHED_PRIVATE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <qcomtee_supplicant.h>
+
+/**
+ * @def SCHED_STARVE_LIMIT
+ * @brief Number of times a class with waiting requests may be passed over.
+ *
+ * A class passed over that many times goes first for the next request.
+ */
+#define SCHED_STARVE_LIMIT 8
+
+/**
+ * @brief Scheduling state of a dispatch queue.
+ *
+ * The queue keeps one FIFO for each priority class; see
+ * @ref qcomtee_object_ops::priority. The owner of the queue tries the FIFOs
+ * in the order given by @ref qcomtee_sched_order and reports the request
+ * it takes with @ref qcomtee_sched_taken. Each time a request is taken,
+ * every other class with requests waiting is passed over once.
+ */
+struct qcomtee_sched {
+	atomic_int queued[QCOMTEE_OBJECT_PRIORITY_CLASSES];
+	atomic_int passed[QCOMTEE_OBJECT_PRIORITY_CLASSES];
+
+	/* See qcomtee_supplicant_stats. */
+	atomic_ulong dispatched[QCOMTEE_OBJECT_PRIORITY_CLASSES];
+	_Atomic(uint64_t) wait_ns[QCOMTEE_OBJECT_PRIORITY_CLASSES];
+	_Atomic(uint64_t) wait_max_ns[QCOMTEE_OBJECT_PRIORITY_CLASSES];
+};
+
+/**
+ * @brief Initialize the scheduling state.
+ * @param sched The state to initialize.
+ */
+void qcomtee_sched_init(struct qcomtee_sched *sched);
+
+/**
+ * @brief Account for a request added to a FIFO.
+ * @param sched The scheduling state.
+ * @param prio Class of the request.
+ */
+void qcomtee_sched_queued(struct qcomtee_sched *sched, int prio);
+
+/**
+ * @brief Order in which to try the FIFOs.
+ *
+ * High, normal, then bulk; the class passed over the most goes first once
+ * it reaches SCHED_STARVE_LIMIT.
+ *
+ * @param sched The scheduling state.
+ * @param order Classes, in the order to try them.
+ */
+void qcomtee_sched_order(struct qcomtee_sched *sched,
+			 int order[QCOMTEE_OBJECT_PRIORITY_CLASSES]);
+
+/**
+ * @brief Account for a request taken from a FIFO.
+ * @param sched The scheduling state.
+ * @param prio Class of the request.
+ * @param wait_ns Time the request waited in the FIFO.
+ */
+void qcomtee_sched_taken(struct qcomtee_sched *sched, int prio,
+			 uint64_t wait_ns);
+
+/**
+ * @brief Copy the per-class statistics.
+ * @param sched The scheduling state.
+ * @param stats Statistics to fill in.
+ */
+void qcomtee_sched_get_stats(struct qcomtee_sched *sched,
+			     struct qcomtee_supplicant_stats *stats);
+
+#endif // _QCOMTEE_SCHED_PRIVATE_H
@@ -0,0 +1,653 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+#include <qcomtee_object_private.h>
+#include <qcomtee_sched_private.h>
+#include <qcomtee_signal_private.h>
+#include <qcomtee_supplicant.h>
+
+/**
+ * @def SERVICE_KICK_NS
+ * @brief Interval for signalling a reader until it leaves the driver.
+ */
+#define SERVICE_KICK_NS 1000000
+
+/**
+ * @brief A request received for a root object.
+ */
+struct qcomtee_service_item {
+	struct qcomtee_service_item *next;
+	struct qcomtee_service_root *sr; /**< The root it is received for. */
+	struct qcomtee_request *req;
+};
+
+/**
+ * @brief A root object registered with a service.
+ */
+struct qcomtee_service_root {
+	struct qcomtee_service_root *next;
+	struct qcomtee_supplicant_service *svc;
+	struct qcomtee_object *root;
+
+	/* Fields below are protected by the service lock. */
+	int active; /**< There are objects exported to QTEE. */
+	int removed; /**< It is being removed; the reader exits. */
+	int reader; /**< The reader is running. */
+	int waiting; /**< The reader is in the driver, or about to be. */
+	pthread_t thread; /**< The reader. */
+	int inflight; /**< Requests queued or being dispatched. */
+	struct qcomtee_service_item *free; /**< Items to receive into. */
+};
+
+/**
+ * @brief Supplicant service.
+ *
+ * TEE_IOC_SUPPL_RECV waits on a single root object, so each active root,
+ * i.e. one with objects exported to QTEE, has a reader; the namespace tells
+ * the service when a root becomes active or idle (see
+ * @ref qcomtee_object_root_watch). An idle root has no thread.
+ *
+ * Readers queue requests, one queue for each priority class, for a shared
+ * pool of dispatchers, which take them in the order given by sched and vary
+ * between min_threads and max_threads like the dispatchers of a supplicant
+ * with readers. Threads are detached; nthreads and nreaders are decremented
+ * as the last thing a thread does with the service.
+ */
+struct qcomtee_supplicant_service {
+	int signo;
+	int min_threads;
+	int max_threads;
+	uint64_t linger_ns;
+	size_t stack_size;
+
+	pthread_mutex_t lock; /**< Lock to protect the fields below. */
+	pthread_cond_t cond; /**< Signalled when a thread exits. */
+	pthread_cond_t work; /**< Signalled when a request is queued. */
+	int stop;
+	struct qcomtee_service_root *roots;
+	/* Requests to dispatch, per priority class. */
+	struct qcomtee_service_item *head[QCOMTEE_OBJECT_PRIORITY_CLASSES];
+	struct qcomtee_service_item **tail[QCOMTEE_OBJECT_PRIORITY_CLASSES];
+	struct qcomtee_sched sched;
+	int queued; /**< Requests in the queues. */
+	int nthreads; /**< Number of dispatchers. */
+	int idle; /**< Dispatchers waiting for a request. */
+	int nreaders; /**< Number of readers. */
+	int receiving; /**< Readers waiting for a request. */
+	int dispatching; /**< Threads processing a request. */
+	unsigned long started;
+	unsigned long retired;
+};
+
+static uint64_t qcomtee_service_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Start a detached thread with only the service's signal unblocked. */
+static int qcomtee_service_spawn(struct qcomtee_supplicant_service *svc,
+				 pthread_t *thread,
+				 void *(*start_routine)(void *), void *arg)
+{
+	sigset_t set, oldset;
+	pthread_attr_t attr;
+	int ret;
+
+	if (pthread_attr_init(&attr))
+		return -1;
+	if (svc->stack_size)
+		pthread_attr_setstacksize(&attr, svc->stack_size);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	/* Leave other signals to the application. */
+	sigfillset(&set);
+	pthread_sigmask(SIG_SETMASK, &set, &oldset);
+	ret = pthread_create(thread, &attr, start_routine, arg);
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+	pthread_attr_destroy(&attr);
+
+	return ret ? -1 : 0;
+}
+
+static void qcomtee_service_unblock(struct qcomtee_supplicant_service *svc)
+{
+	sigset_t set;
+
+	sigemptyset(&set);
+	sigaddset(&set, svc->signo);
+	pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+}
+
+/* ''Dispatchers''. */
+
+static void *qcomtee_service_dispatcher(void *arg);
+
+/* Start a dispatcher; called with the lock held. */
+static int qcomtee_service_spawn_dispatcher(struct qcomtee_supplicant_service *svc)
+{
+	pthread_t thread;
+
+	if (qcomtee_service_spawn(svc, &thread, qcomtee_service_dispatcher,
+				  svc))
+		return -1;
+
+	svc->nthreads++;
+	svc->idle++;
+	svc->started++;
+
+	return 0;
+}
+
+/* Take the next request to dispatch, if any; called with the lock held. */
+static struct qcomtee_service_item *
+qcomtee_service_pop(struct qcomtee_supplicant_service *svc)
+{
+	int order[QCOMTEE_OBJECT_PRIORITY_CLASSES];
+	struct qcomtee_service_item *item;
+	int i, c;
+
+	if (!svc->queued)
+		return NULL;
+
+	qcomtee_sched_order(&svc->sched, order);
+	for (i = 0; i < QCOMTEE_OBJECT_PRIORITY_CLASSES; i++) {
+		c = order[i];
+		item = svc->head[c];
+		if (!item)
+			continue;
+
+		svc->head[c] = item->next;
+		if (!svc->head[c])
+			svc->tail[c] = &svc->head[c];
+		svc->queued--;
+		qcomtee_sched_taken(&svc->sched, c,
+				    qcomtee_request_dequeue(item->req));
+
+		return item;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Signal readers of idle roots that missed their signal.
+ *
+ * It is called with the lock held.
+ *
+ * @param svc The service.
+ * @return Returns the number of readers signalled.
+ */
+static int qcomtee_service_kick_idle(struct qcomtee_supplicant_service *svc)
+{
+	struct qcomtee_service_root *sr;
+	int n = 0;
+
+	for (sr = svc->roots; sr; sr = sr->next) {
+		if (!sr->active && sr->waiting) {
+			pthread_kill(sr->thread, svc->signo);
+			n++;
+		}
+	}
+
+	return n;
+}
+
+static void *qcomtee_service_dispatcher(void *arg)
+{
+	struct qcomtee_supplicant_service *svc = arg;
+	struct qcomtee_service_item *item;
+	struct qcomtee_service_root *sr;
+	struct timespec ts;
+	uint64_t deadline, now, wake;
+	int err;
+
+	pthread_mutex_lock(&svc->lock);
+	while (1) {
+		deadline = qcomtee_service_now() + svc->linger_ns;
+
+		err = 0;
+		while (!svc->queued && !svc->stop && err != ETIMEDOUT) {
+			/* Until they leave, signal idle readers every
+			 * SERVICE_KICK_NS rather than every linger period.
+			 */
+			now = qcomtee_service_now();
+			wake = deadline;
+			if (qcomtee_service_kick_idle(svc) &&
+			    now + SERVICE_KICK_NS < deadline)
+				wake = now + SERVICE_KICK_NS;
+
+			ts.tv_sec = wake / 1000000000ULL;
+			ts.tv_nsec = wake % 1000000000ULL;
+			err = pthread_cond_timedwait(&svc->work, &svc->lock,
+						     &ts);
+			if (err == ETIMEDOUT && wake < deadline)
+				err = 0;
+		}
+
+		item = qcomtee_service_pop(svc);
+		if (!item) {
+			if (svc->stop)
+				break;
+
+			if (svc->nthreads > svc->min_threads) {
+				svc->retired++;
+				break;
+			}
+
+			continue;
+		}
+
+		svc->idle--;
+		svc->dispatching++;
+		pthread_mutex_unlock(&svc->lock);
+
+		qcomtee_request_process(item->req);
+
+		pthread_mutex_lock(&svc->lock);
+		svc->dispatching--;
+		svc->idle++;
+		sr = item->sr;
+		item->next = sr->free;
+		sr->free = item;
+		if (!--sr->inflight && sr->removed)
+			pthread_cond_broadcast(&svc->cond);
+	}
+
+	svc->idle--;
+	svc->nthreads--;
+	pthread_cond_broadcast(&svc->cond);
+	pthread_mutex_unlock(&svc->lock);
+
+	return NULL;
+}
+
+/* ''Readers''. */
+
+/* Take an item to receive into; called with the lock held. */
+static struct qcomtee_service_item *
+qcomtee_service_get_item(struct qcomtee_service_root *sr)
+{
+	struct qcomtee_supplicant_service *svc = sr->svc;
+	struct qcomtee_service_item *item = sr->free;
+
+	if (item) {
+		sr->free = item->next;
+		return item;
+	}
+
+	pthread_mutex_unlock(&svc->lock);
+	item = malloc(sizeof(*item));
+	if (item) {
+		item->sr = sr;
+		item->req = qcomtee_request_alloc(sr->root);
+		if (!item->req) {
+			free(item);
+			item = NULL;
+		}
+	}
+	pthread_mutex_lock(&svc->lock);
+
+	return item;
+}
+
+static void *qcomtee_service_reader(void *arg)
+{
+	struct qcomtee_service_root *sr = arg;
+	struct qcomtee_supplicant_service *svc = sr->svc;
+	struct qcomtee_service_item *item = NULL;
+	int err, prio = QCOMTEE_OBJECT_PRIORITY_NORMAL;
+
+	qcomtee_service_unblock(svc);
+
+	pthread_mutex_lock(&svc->lock);
+	while (sr->active && !sr->removed && !svc->stop) {
+		if (!item) {
+			item = qcomtee_service_get_item(sr);
+			if (!item) {
+				MSGE("%s: %s\n", __func__, strerror(ENOMEM));
+				break;
+			}
+
+			/* The lock was dropped; check again. */
+			continue;
+		}
+
+		sr->waiting = 1;
+		svc->receiving++;
+		pthread_mutex_unlock(&svc->lock);
+
+		err = 0;
+		if (qcomtee_request_recv(item->req))
+			err = errno;
+		else if (!qcomtee_request_is_release(item->req))
+			/* Not under the lock; it may drop an object. */
+			prio = qcomtee_request_enqueue(item->req);
+
+		pthread_mutex_lock(&svc->lock);
+		sr->waiting = 0;
+		svc->receiving--;
+		if (err) {
+			if (err == EINTR)
+				continue;
+
+			MSGE("%s: %s\n", __func__, strerror(err));
+			break;
+		}
+
+		/* Releases are quick; dispatch them right away. */
+		if (qcomtee_request_is_release(item->req)) {
+			svc->dispatching++;
+			pthread_mutex_unlock(&svc->lock);
+			qcomtee_request_process(item->req);
+			pthread_mutex_lock(&svc->lock);
+			svc->dispatching--;
+
+			continue;
+		}
+
+		item->next = NULL;
+		*svc->tail[prio] = item;
+		svc->tail[prio] = &item->next;
+		svc->queued++;
+		qcomtee_sched_queued(&svc->sched, prio);
+		sr->inflight++;
+		item = NULL;
+
+		/* More requests than dispatchers to take them; start one. */
+		if (svc->queued > svc->idle && svc->nthreads < svc->max_threads)
+			qcomtee_service_spawn_dispatcher(svc);
+		pthread_cond_signal(&svc->work);
+	}
+
+	if (item) {
+		item->next = sr->free;
+		sr->free = item;
+	}
+
+	sr->reader = 0;
+	svc->nreaders--;
+	pthread_cond_broadcast(&svc->cond);
+	pthread_mutex_unlock(&svc->lock);
+
+	return NULL;
+}
+
+/* Start a reader for an active root; called with the lock held. */
+static void qcomtee_service_activate(struct qcomtee_service_root *sr)
+{
+	struct qcomtee_supplicant_service *svc = sr->svc;
+
+	if (sr->reader || sr->removed || svc->stop)
+		return;
+
+	if (qcomtee_service_spawn(svc, &sr->thread, qcomtee_service_reader,
+				  sr)) {
+		MSGE("%s: unable to start a reader.\n", __func__);
+		return;
+	}
+
+	sr->reader = 1;
+	svc->nreaders++;
+	svc->started++;
+}
+
+/* See qcomtee_object_root_watch; called with the namespace lock held. */
+static void qcomtee_service_watch(void *arg, int active)
+{
+	struct qcomtee_service_root *sr = arg;
+	struct qcomtee_supplicant_service *svc = sr->svc;
+
+	pthread_mutex_lock(&svc->lock);
+	sr->active = active;
+	if (active)
+		qcomtee_service_activate(sr);
+	else if (sr->waiting) {
+		/* Idle; the reader exits. A dispatcher retries the signal
+		 * in case it arrives before the reader enters the driver.
+		 */
+		pthread_kill(sr->thread, svc->signo);
+		pthread_cond_signal(&svc->work);
+	}
+	pthread_mutex_unlock(&svc->lock);
+}
+
+/* ''Service''. */
+
+struct qcomtee_supplicant_service *
+qcomtee_supplicant_service_start(int nthreads,
+				 const struct qcomtee_supplicant_opts *opts)
+{
+	struct qcomtee_supplicant_service *svc;
+	pthread_condattr_t cattr;
+	int i, ret = 0;
+
+	if (nthreads < 1 || nthreads > QCOMTEE_SUPPLICANT_THREADS_MAX)
+		return NULL;
+
+	svc = calloc(1, sizeof(*svc));
+	if (!svc)
+		return NULL;
+
+	svc->signo = (opts && opts->signo) ? opts->signo : SIGRTMIN;
+	if (qcomtee_signal_get(svc->signo)) {
+		free(svc);
+		return NULL;
+	}
+
+	svc->min_threads = nthreads;
+	svc->max_threads = nthreads;
+	if (opts && opts->max_threads > nthreads)
+		svc->max_threads = opts->max_threads;
+	if (svc->max_threads > QCOMTEE_SUPPLICANT_THREADS_MAX)
+		svc->max_threads = QCOMTEE_SUPPLICANT_THREADS_MAX;
+	svc->linger_ns = ((opts && opts->linger_ms > 0) ?
+				  opts->linger_ms :
+				  QCOMTEE_SUPPLICANT_LINGER_MS) *
+			 1000000ULL;
+	svc->stack_size = opts ? opts->stack_size : 0;
+	for (i = 0; i < QCOMTEE_OBJECT_PRIORITY_CLASSES; i++)
+		svc->tail[i] = &svc->head[i];
+	qcomtee_sched_init(&svc->sched);
+
+	pthread_mutex_init(&svc->lock, NULL);
+	pthread_cond_init(&svc->cond, NULL);
+	pthread_condattr_init(&cattr);
+	pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+	pthread_cond_init(&svc->work, &cattr);
+	pthread_condattr_destroy(&cattr);
+
+	pthread_mutex_lock(&svc->lock);
+	for (i = 0; i < nthreads && !ret; i++)
+		ret = qcomtee_service_spawn_dispatcher(svc);
+	pthread_mutex_unlock(&svc->lock);
+
+	if (ret) {
+		qcomtee_supplicant_service_stop(svc);
+		return NULL;
+	}
+
+	return svc;
+}
+
+int qcomtee_supplicant_service_add(struct qcomtee_supplicant_service *svc,
+				   struct qcomtee_object *root)
+{
+	struct qcomtee_service_root *sr;
+
+	if (root == QCOMTEE_OBJECT_NULL ||
+	    root->object_type != QCOMTEE_OBJECT_TYPE_ROOT)
+		return -1;
+
+	sr = calloc(1, sizeof(*sr));
+	if (!sr)
+		return -1;
+
+	sr->svc = svc;
+	sr->root = root;
+	qcomtee_object_refs_inc(root);
+
+	pthread_mutex_lock(&svc->lock);
+	sr->next = svc->roots;
+	svc->roots = sr;
+	pthread_mutex_unlock(&svc->lock);
+
+	/* Starts a reader if it is already active. */
+	qcomtee_object_root_watch(root, qcomtee_service_watch, sr);
+
+	return 0;
+}
+
+/* Answer the queued requests of sr without dispatching; lock held. */
+static void qcomtee_service_abort(struct qcomtee_supplicant_service *svc,
+				  struct qcomtee_service_root *sr)
+{
+	struct qcomtee_service_item **p, *item;
+	int c;
+
+	for (c = 0; c < QCOMTEE_OBJECT_PRIORITY_CLASSES; c++) {
+		p = &svc->head[c];
+		while ((item = *p)) {
+			if (item->sr != sr) {
+				p = &item->next;
+				continue;
+			}
+
+			*p = item->next;
+			if (!*p)
+				svc->tail[c] = p;
+			svc->queued--;
+			qcomtee_sched_taken(&svc->sched, c,
+					    qcomtee_request_dequeue(item->req));
+
+			/* Only TEE_IOC_SUPPL_SEND; no callback runs. */
+			qcomtee_request_abort(item->req);
+			item->next = sr->free;
+			sr->free = item;
+			sr->inflight--;
+		}
+	}
+}
+
+/* Wait for the reader and requests of sr and free it; lock held. */
+static void qcomtee_service_remove(struct qcomtee_supplicant_service *svc,
+				   struct qcomtee_service_root *sr)
+{
+	struct timespec ts = { 0, SERVICE_KICK_NS };
+	struct qcomtee_service_root **p;
+	struct qcomtee_service_item *item;
+
+	while (sr->reader || sr->inflight) {
+		/* It may miss a signal just before entering the driver. */
+		if (sr->waiting)
+			pthread_kill(sr->thread, svc->signo);
+
+		/* Wait only for the requests being dispatched. */
+		qcomtee_service_abort(svc, sr);
+		if (!sr->reader && !sr->inflight)
+			break;
+
+		pthread_mutex_unlock(&svc->lock);
+		nanosleep(&ts, NULL);
+		pthread_mutex_lock(&svc->lock);
+	}
+
+	for (p = &svc->roots; *p != sr; p = &(*p)->next)
+		;
+	*p = sr->next;
+	pthread_cond_broadcast(&svc->cond);
+
+	while ((item = sr->free)) {
+		sr->free = item->next;
+		qcomtee_request_free(item->req);
+		free(item);
+	}
+}
+
+void qcomtee_supplicant_service_remove(struct qcomtee_supplicant_service *svc,
+				       struct qcomtee_object *root)
+{
+	struct qcomtee_service_root *sr;
+
+	pthread_mutex_lock(&svc->lock);
+	for (sr = svc->roots; sr; sr = sr->next)
+		if (sr->root == root && !sr->removed)
+			break;
+	/* Claim it; the reader exits and other removers skip it. */
+	if (sr)
+		sr->removed = 1;
+	pthread_mutex_unlock(&svc->lock);
+
+	if (!sr)
+		return;
+
+	/* No more calls to qcomtee_service_watch. */
+	qcomtee_object_root_watch(root, NULL, NULL);
+
+	pthread_mutex_lock(&svc->lock);
+	qcomtee_service_remove(svc, sr);
+	pthread_mutex_unlock(&svc->lock);
+
+	free(sr);
+	qcomtee_object_refs_dec(root);
+}
+
+void qcomtee_supplicant_service_get_stats(
+	struct qcomtee_supplicant_service *svc,
+	struct qcomtee_supplicant_stats *stats)
+{
+	pthread_mutex_lock(&svc->lock);
+	stats->threads = svc->nthreads + svc->nreaders;
+	stats->receiving = svc->receiving;
+	stats->dispatching = svc->dispatching;
+	stats->started = svc->started;
+	stats->retired = svc->retired;
+	pthread_mutex_unlock(&svc->lock);
+
+	qcomtee_sched_get_stats(&svc->sched, stats);
+}
+
+void qcomtee_supplicant_service_stop(struct qcomtee_supplicant_service *svc)
+{
+	struct qcomtee_service_root *sr;
+	struct qcomtee_object *root;
+
+	while (1) {
+		pthread_mutex_lock(&svc->lock);
+		for (sr = svc->roots; sr; sr = sr->next)
+			if (!sr->removed)
+				break;
+		root = sr ? sr->root : QCOMTEE_OBJECT_NULL;
+		pthread_mutex_unlock(&svc->lock);
+
+		if (root == QCOMTEE_OBJECT_NULL)
+			break;
+
+		qcomtee_supplicant_service_remove(svc, root);
+	}
+
+	pthread_mutex_lock(&svc->lock);
+	/* Wait for roots being removed by other threads. */
+	while (svc->roots)
+		pthread_cond_wait(&svc->cond, &svc->lock);
+
+	svc->stop = 1;
+	pthread_cond_broadcast(&svc->work);
+	while (svc->nthreads)
+		pthread_cond_wait(&svc->cond, &svc->lock);
+	pthread_mutex_unlock(&svc->lock);
+
+	pthread_cond_destroy(&svc->work);
+	pthread_cond_destroy(&svc->cond);
+	pthread_mutex_destroy(&svc->lock);
+	qcomtee_signal_put(svc->signo);
+	free(svc);
+}
@@ -0,0 +1,90 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <qcomtee_signal_private.h>
+
+/**
+ * @brief A signal the library has a handler installed for.
+ */
+struct qcomtee_signal {
+	int signo;
+	int users; /**< Number of qcomtee_signal_get not put yet. */
+	struct sigaction old; /**< The handler before the first user. */
+	struct qcomtee_signal *next;
+};
+
+/* Signals in use; few, so a list will do. */
+static struct qcomtee_signal *signals;
+static pthread_mutex_t signals_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Only to interrupt the driver. */
+static void qcomtee_signal_handler(int signo)
+{
+	(void)signo;
+}
+
+int qcomtee_signal_get(int signo)
+{
+	struct sigaction sa = { 0 };
+	struct qcomtee_signal *s;
+	int ret = 0;
+
+	pthread_mutex_lock(&signals_lock);
+	for (s = signals; s; s = s->next) {
+		if (s->signo == signo)
+			break;
+	}
+
+	if (s) {
+		s->users++;
+		goto out;
+	}
+
+	s = malloc(sizeof(*s));
+	if (!s) {
+		errno = ENOMEM;
+		ret = -1;
+		goto out;
+	}
+
+	/* No SA_RESTART, so the driver returns EINTR. */
+	sa.sa_handler = qcomtee_signal_handler;
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(signo, &sa, &s->old)) {
+		free(s);
+		ret = -1;
+		goto out;
+	}
+
+	s->signo = signo;
+	s->users = 1;
+	s->next = signals;
+	signals = s;
+
+out:
+	pthread_mutex_unlock(&signals_lock);
+
+	return ret;
+}
+
+void qcomtee_signal_put(int signo)
+{
+	struct qcomtee_signal **p, *s;
+
+	pthread_mutex_lock(&signals_lock);
+	for (p = &signals; (s = *p); p = &s->next) {
+		if (s->signo == signo)
+			break;
+	}
+
+	if (s && --s->users == 0) {
+		sigaction(signo, &s->old, NULL);
+		*p = s->next;
+		free(s);
+	}
+	pthread_mutex_unlock(&signals_lock);
+}
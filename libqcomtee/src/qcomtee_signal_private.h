@@ -0,0 +1,31 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef _QCOMTEE_SIGNAL_PRIVATE_H
+#define _QCOMTEE_SIGNAL_PRIVATE_H
+
+/**
+ * @brief Install the handler that interrupts TEE_IOC_SUPPL_RECV.
+ *
+ * The first user of a signal installs a handler that does nothing, without
+ * SA_RESTART, so that a thread waiting in the driver returns EINTR. The
+ * application's handler is saved and restored by the last
+ * @ref qcomtee_signal_put; supplicants, services, and pollable queues share
+ * the signal meanwhile.
+ *
+ * @param signo The signal.
+ * @return On success, 0; Otherwise, returns -1 and sets errno.
+ */
+int qcomtee_signal_get(int signo);
+
+/**
+ * @brief Drop a use of a signal taken with @ref qcomtee_signal_get.
+ *
+ * The last user restores the handler the signal had before the first one.
+ * No thread of the caller should be waiting for the signal anymore.
+ *
+ * @param signo The signal.
+ */
+void qcomtee_signal_put(int signo);
+
+#endif // _QCOMTEE_SIGNAL_PRIVATE_H
@@ -0,0 +1,798 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+#include <qcomtee_object_private.h>
+#include <qcomtee_ring_private.h>
+#include <qcomtee_sched_private.h>
+#include <qcomtee_signal_private.h>
+#include <qcomtee_supplicant.h>
+
+/**
+ * @def SUPPLICANT_KICK_NS
+ * @brief Interval for signalling a thread until it leaves the driver.
+ *
+ * A thread that checks for stop just before entering TEE_IOC_SUPPL_RECV may
+ * miss the first signal, so it is signalled again.
+ */
+#define SUPPLICANT_KICK_NS 1000000
+
+/**
+ * @def SUPPLICANT_RING_SIZE
+ * @brief Requests received by the readers and not yet dispatched.
+ *
+ * It bounds the requests in all the ready rings together. If they are full,
+ * a reader dispatches the request itself.
+ */
+#define SUPPLICANT_RING_SIZE 64
+
+/* States of a thread slot. */
+#define SLOT_FREE 0
+#define SLOT_RUNNING 1
+#define SLOT_EXITED 2 /* Exited; not joined yet. */
+
+/* Roles of a thread. */
+#define ROLE_WORKER 0 /* Receives and dispatches. */
+#define ROLE_READER 1 /* Receives. */
+#define ROLE_DISPATCHER 2 /* Dispatches what readers receive. */
+
+struct qcomtee_supplicant_thread {
+	pthread_t thread;
+	struct qcomtee_supplicant *sup;
+	int role;
+	int state; /**< SLOT_FREE, SLOT_RUNNING, or SLOT_EXITED. */
+	int waiting; /**< Waiting for a request, or about to. */
+	int retire; /**< Exit when woken while waiting. */
+	int free_sup; /**< Stopped from this thread; free sup on exit. */
+	uint64_t since; /**< When the thread started waiting. */
+};
+
+/**
+ * @brief Supplicant.
+ *
+ * Without readers, each worker receives and dispatches one request at a
+ * time. The last worker to leave TEE_IOC_SUPPL_RECV starts a new one before
+ * it dispatches, and a housekeeping thread retires workers above
+ * min_threads that have been waiting for linger_ns.
+ *
+ * With readers, readers push received requests to the ready ring of the
+ * target object's priority class and dispatchers pop them in the order
+ * given by sched; items counts the requests in the rings. A request goes
+ * back to the free ring once dispatched. A reader starts a dispatcher
+ * if there are more requests in the ring than idle dispatchers, and a
+ * dispatcher above min_threads exits after waiting for linger_ns.
+ *
+ * Threads are woken from TEE_IOC_SUPPL_RECV with a signal so that it fails
+ * with EINTR. A thread is signalled only while waiting is set; waiting is
+ * cleared under the lock once a request is received, so a thread is never
+ * signalled while dispatching a request.
+ *
+ * On stop, requests still in the ready rings are answered with
+ * QCOMTEE_ERROR_ABORT rather than dispatched, so stopping waits only for
+ * the requests being dispatched. The supplicant may be stopped from one of
+ * its threads, e.g. in the root object's release callback when QTEE
+ * releases the last callback object; that thread frees it on its way out.
+ */
+struct qcomtee_supplicant {
+	struct qcomtee_object *root;
+	int signo;
+	int min_threads;
+	int max_threads;
+	uint64_t linger_ns;
+	size_t stack_size;
+
+	pthread_mutex_t lock; /**< Lock to protect the fields below. */
+	pthread_cond_t cond; /**< Signalled when a thread exits. */
+	int stop;
+	int nthreads; /**< Number of workers or dispatchers. */
+	int nreaders; /**< Number of readers. */
+	unsigned long started;
+	unsigned long retired;
+	pthread_t housekeeper;
+	int has_housekeeper;
+	struct qcomtee_supplicant_thread threads[QCOMTEE_SUPPLICANT_THREADS_MAX];
+
+	atomic_int receiving; /**< Threads waiting for a request. */
+	atomic_int dispatching; /**< Threads processing a request. */
+
+	/* Readers and dispatchers. */
+	/* Requests to dispatch, per priority class. */
+	struct qcomtee_ring ready[QCOMTEE_OBJECT_PRIORITY_CLASSES];
+	struct qcomtee_sched sched;
+	struct qcomtee_ring free; /**< Requests to receive into. */
+	sem_t items; /**< Posted for each request in ready, and on stop. */
+	atomic_int queued; /**< Requests in ready. */
+	atomic_int idle; /**< Dispatchers waiting for a request. */
+	atomic_int dispatch_stop;
+	struct qcomtee_request **requests;
+	int nrequests;
+};
+
+static uint64_t qcomtee_supplicant_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *qcomtee_supplicant_worker(void *arg);
+static void *qcomtee_supplicant_reader(void *arg);
+static void *qcomtee_supplicant_dispatcher(void *arg);
+static void qcomtee_supplicant_free(struct qcomtee_supplicant *sup);
+
+/* Start a thread in a free slot; called with the lock held. */
+static int qcomtee_supplicant_spawn(struct qcomtee_supplicant *sup, int role)
+{
+	static void *(*const start_routine[])(void *) = {
+		[ROLE_WORKER] = qcomtee_supplicant_worker,
+		[ROLE_READER] = qcomtee_supplicant_reader,
+		[ROLE_DISPATCHER] = qcomtee_supplicant_dispatcher,
+	};
+	struct qcomtee_supplicant_thread *t = NULL;
+	sigset_t set, oldset;
+	pthread_attr_t attr;
+	int i, ret;
+
+	for (i = 0; i < QCOMTEE_SUPPLICANT_THREADS_MAX; i++) {
+		if (sup->threads[i].state == SLOT_FREE) {
+			t = &sup->threads[i];
+			break;
+		}
+	}
+
+	if (!t || pthread_attr_init(&attr))
+		return -1;
+	if (sup->stack_size)
+		pthread_attr_setstacksize(&attr, sup->stack_size);
+
+	t->sup = sup;
+	t->role = role;
+	t->state = SLOT_RUNNING;
+	t->waiting = (role != ROLE_DISPATCHER);
+	t->retire = 0;
+	t->free_sup = 0;
+	t->since = qcomtee_supplicant_now();
+
+	/* Leave other signals to the application. */
+	sigfillset(&set);
+	pthread_sigmask(SIG_SETMASK, &set, &oldset);
+	ret = pthread_create(&t->thread, &attr, start_routine[role], t);
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+	pthread_attr_destroy(&attr);
+
+	if (ret) {
+		t->state = SLOT_FREE;
+		return -1;
+	}
+
+	if (role == ROLE_READER) {
+		sup->nreaders++;
+	} else {
+		sup->nthreads++;
+		sup->started++;
+	}
+
+	/* It counts as receiving from now, so no one starts another. */
+	if (t->waiting)
+		atomic_fetch_add(&sup->receiving, 1);
+	else
+		atomic_fetch_add(&sup->idle, 1);
+
+	return 0;
+}
+
+/* Mark a thread as exited; called with the lock held, which it releases. */
+static void qcomtee_supplicant_exit(struct qcomtee_supplicant_thread *t)
+{
+	struct qcomtee_supplicant *sup = t->sup;
+
+	if (t->role == ROLE_READER)
+		sup->nreaders--;
+	else
+		sup->nthreads--;
+
+	if (t->retire)
+		sup->retired++;
+
+	t->state = SLOT_EXITED;
+	pthread_cond_broadcast(&sup->cond);
+	pthread_mutex_unlock(&sup->lock);
+
+	/* The others are gone; no one joins this thread. */
+	if (t->free_sup) {
+		pthread_detach(pthread_self());
+		qcomtee_supplicant_free(sup);
+	}
+}
+
+/* Threads start with every signal blocked. */
+static void qcomtee_supplicant_unblock(struct qcomtee_supplicant *sup)
+{
+	sigset_t set;
+
+	sigemptyset(&set);
+	sigaddset(&set, sup->signo);
+	pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+}
+
+/* ''Workers''. */
+
+static void qcomtee_supplicant_received(void *data)
+{
+	struct qcomtee_supplicant_thread *t = data;
+	struct qcomtee_supplicant *sup = t->sup;
+
+	pthread_mutex_lock(&sup->lock);
+	t->waiting = 0;
+	atomic_fetch_sub(&sup->receiving, 1);
+	atomic_fetch_add(&sup->dispatching, 1);
+	/* Keep someone in the driver for nested requests. */
+	if (!atomic_load(&sup->receiving) && !sup->stop &&
+	    sup->nthreads < sup->max_threads)
+		qcomtee_supplicant_spawn(sup, ROLE_WORKER);
+	pthread_mutex_unlock(&sup->lock);
+}
+
+static void *qcomtee_supplicant_worker(void *arg)
+{
+	struct qcomtee_supplicant_thread *t = arg;
+	struct qcomtee_supplicant *sup = t->sup;
+	int err;
+
+	qcomtee_supplicant_unblock(sup);
+
+	pthread_mutex_lock(&sup->lock);
+	while (!sup->stop && !t->retire) {
+		pthread_mutex_unlock(&sup->lock);
+
+		err = 0;
+		if (qcomtee_object_process_one_notify(
+			    sup->root, qcomtee_supplicant_received, t))
+			err = errno;
+		if (err && err != EINTR)
+			MSGE("%s: %s\n", __func__, strerror(err));
+
+		pthread_mutex_lock(&sup->lock);
+		if (!t->waiting) {
+			/* Done with a request; wait for the next one. */
+			t->waiting = 1;
+			t->since = qcomtee_supplicant_now();
+			atomic_fetch_sub(&sup->dispatching, 1);
+			atomic_fetch_add(&sup->receiving, 1);
+		} else if (err && err != EINTR) {
+			break;
+		}
+	}
+
+	atomic_fetch_sub(&sup->receiving, 1);
+	qcomtee_supplicant_exit(t);
+
+	return NULL;
+}
+
+/* ''Readers and dispatchers''. */
+
+/* Take a request from the free ring; there is always one. */
+static struct qcomtee_request *
+qcomtee_supplicant_get_request(struct qcomtee_supplicant *sup)
+{
+	struct qcomtee_request *req;
+
+	/* Only empty while a dispatcher is putting one back. */
+	while (!(req = qcomtee_ring_pop(&sup->free)))
+		sched_yield();
+
+	return req;
+}
+
+/* Hand a request over to the dispatchers. */
+static int qcomtee_supplicant_queue(struct qcomtee_supplicant *sup,
+				    struct qcomtee_request *req)
+{
+	int prio, n;
+
+	prio = qcomtee_request_enqueue(req);
+	n = atomic_fetch_add(&sup->queued, 1) + 1;
+	if (n > SUPPLICANT_RING_SIZE ||
+	    qcomtee_ring_push(&sup->ready[prio], req)) {
+		atomic_fetch_sub(&sup->queued, 1);
+		return -1;
+	}
+
+	/* A dispatcher may take it first; it only delays passing it over. */
+	qcomtee_sched_queued(&sup->sched, prio);
+
+	/* More requests than dispatchers to take them; start one. */
+	if (n > atomic_load(&sup->idle)) {
+		pthread_mutex_lock(&sup->lock);
+		if (!sup->stop && sup->nthreads < sup->max_threads)
+			qcomtee_supplicant_spawn(sup, ROLE_DISPATCHER);
+		pthread_mutex_unlock(&sup->lock);
+	}
+
+	sem_post(&sup->items);
+
+	return 0;
+}
+
+/* Take the next request to dispatch, if any. */
+static struct qcomtee_request *
+qcomtee_supplicant_pop(struct qcomtee_supplicant *sup)
+{
+	int order[QCOMTEE_OBJECT_PRIORITY_CLASSES];
+	struct qcomtee_request *req;
+	int i;
+
+	qcomtee_sched_order(&sup->sched, order);
+	for (i = 0; i < QCOMTEE_OBJECT_PRIORITY_CLASSES; i++) {
+		req = qcomtee_ring_pop(&sup->ready[order[i]]);
+		if (req) {
+			qcomtee_sched_taken(&sup->sched, order[i],
+					    qcomtee_request_dequeue(req));
+			return req;
+		}
+	}
+
+	return NULL;
+}
+
+static void *qcomtee_supplicant_reader(void *arg)
+{
+	struct qcomtee_supplicant_thread *t = arg;
+	struct qcomtee_supplicant *sup = t->sup;
+	struct qcomtee_request *req;
+	int err;
+
+	qcomtee_supplicant_unblock(sup);
+
+	req = qcomtee_supplicant_get_request(sup);
+
+	pthread_mutex_lock(&sup->lock);
+	while (!sup->stop) {
+		pthread_mutex_unlock(&sup->lock);
+
+		err = 0;
+		if (qcomtee_request_recv(req))
+			err = errno;
+
+		pthread_mutex_lock(&sup->lock);
+		if (err) {
+			if (err == EINTR)
+				continue;
+
+			MSGE("%s: %s\n", __func__, strerror(err));
+			break;
+		}
+
+		t->waiting = 0;
+		atomic_fetch_sub(&sup->receiving, 1);
+		pthread_mutex_unlock(&sup->lock);
+
+		/* Releases are quick; dispatch them right away. */
+		if (qcomtee_request_is_release(req) ||
+		    qcomtee_supplicant_queue(sup, req)) {
+			atomic_fetch_add(&sup->dispatching, 1);
+			qcomtee_request_process(req);
+			atomic_fetch_sub(&sup->dispatching, 1);
+		} else {
+			req = qcomtee_supplicant_get_request(sup);
+		}
+
+		pthread_mutex_lock(&sup->lock);
+		t->waiting = 1;
+		atomic_fetch_add(&sup->receiving, 1);
+	}
+
+	qcomtee_ring_push(&sup->free, req);
+
+	atomic_fetch_sub(&sup->receiving, 1);
+	qcomtee_supplicant_exit(t);
+
+	return NULL;
+}
+
+static void *qcomtee_supplicant_dispatcher(void *arg)
+{
+	struct qcomtee_supplicant_thread *t = arg;
+	struct qcomtee_supplicant *sup = t->sup;
+	struct qcomtee_request *req;
+	struct timespec ts;
+	int err;
+
+	/* Counted as idle by qcomtee_supplicant_spawn. */
+	while (1) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += sup->linger_ns / 1000000000ULL;
+		ts.tv_nsec += sup->linger_ns % 1000000000ULL;
+		if (ts.tv_nsec >= 1000000000L) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+
+		err = 0;
+		while (sem_timedwait(&sup->items, &ts)) {
+			err = errno;
+			if (err != EINTR)
+				break;
+		}
+
+		if (err == ETIMEDOUT) {
+			pthread_mutex_lock(&sup->lock);
+			if (sup->nthreads > sup->min_threads) {
+				t->retire = 1;
+				break;
+			}
+			pthread_mutex_unlock(&sup->lock);
+
+			continue;
+		}
+
+		atomic_fetch_sub(&sup->idle, 1);
+
+		/* A reader may still be writing the cell; or it is stop. */
+		while (!(req = qcomtee_supplicant_pop(sup))) {
+			if (atomic_load(&sup->dispatch_stop))
+				break;
+
+			sched_yield();
+		}
+
+		if (!req) {
+			pthread_mutex_lock(&sup->lock);
+			break;
+		}
+
+		atomic_fetch_sub(&sup->queued, 1);
+		if (atomic_load(&sup->dispatch_stop)) {
+			/* Stopping; answer it without dispatching. */
+			qcomtee_request_abort(req);
+		} else {
+			atomic_fetch_add(&sup->dispatching, 1);
+			qcomtee_request_process(req);
+			atomic_fetch_sub(&sup->dispatching, 1);
+		}
+		qcomtee_ring_push(&sup->free, req);
+
+		atomic_fetch_add(&sup->idle, 1);
+	}
+
+	/* Exits with the lock held; idle is already decremented on stop. */
+	if (t->retire)
+		atomic_fetch_sub(&sup->idle, 1);
+	qcomtee_supplicant_exit(t);
+
+	return NULL;
+}
+
+/* ''Housekeeping''. */
+
+/* Join exited threads; called with the lock held. */
+static void qcomtee_supplicant_reap(struct qcomtee_supplicant *sup)
+{
+	int i;
+
+	for (i = 0; i < QCOMTEE_SUPPLICANT_THREADS_MAX; i++) {
+		if (sup->threads[i].state == SLOT_EXITED) {
+			/* It only has to return after releasing the lock. */
+			pthread_join(sup->threads[i].thread, NULL);
+			sup->threads[i].state = SLOT_FREE;
+		}
+	}
+}
+
+/* Retire workers that waited too long; called with the lock held. */
+static void qcomtee_supplicant_retire(struct qcomtee_supplicant *sup)
+{
+	struct qcomtee_supplicant_thread *t;
+	int i, retiring = 0;
+	uint64_t now;
+
+	now = qcomtee_supplicant_now();
+	for (i = 0; i < QCOMTEE_SUPPLICANT_THREADS_MAX; i++) {
+		t = &sup->threads[i];
+		if (t->state != SLOT_RUNNING || t->role != ROLE_WORKER ||
+		    !t->waiting)
+			continue;
+
+		if (t->retire) {
+			/* It missed the signal; kick it again. */
+			pthread_kill(t->thread, sup->signo);
+			retiring++;
+		} else if (now - t->since >= sup->linger_ns &&
+			   sup->nthreads - retiring > sup->min_threads &&
+			   atomic_load(&sup->receiving) - retiring > 1) {
+			t->retire = 1;
+			pthread_kill(t->thread, sup->signo);
+			retiring++;
+		}
+	}
+}
+
+static void *qcomtee_supplicant_housekeeper(void *arg)
+{
+	struct qcomtee_supplicant *sup = arg;
+	struct timespec ts;
+	uint64_t period;
+
+	/* Workers linger between linger_ns and 1.5 * linger_ns. */
+	period = sup->linger_ns / 2;
+
+	pthread_mutex_lock(&sup->lock);
+	while (!sup->stop) {
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		ts.tv_sec += period / 1000000000ULL;
+		ts.tv_nsec += period % 1000000000ULL;
+		if (ts.tv_nsec >= 1000000000L) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+
+		pthread_cond_timedwait(&sup->cond, &sup->lock, &ts);
+		if (sup->stop)
+			break;
+
+		qcomtee_supplicant_reap(sup);
+		qcomtee_supplicant_retire(sup);
+	}
+	pthread_mutex_unlock(&sup->lock);
+
+	return NULL;
+}
+
+/* The slot of the calling thread, if it is one of ours; lock held. */
+static struct qcomtee_supplicant_thread *
+qcomtee_supplicant_self(struct qcomtee_supplicant *sup)
+{
+	int i;
+
+	for (i = 0; i < QCOMTEE_SUPPLICANT_THREADS_MAX; i++) {
+		if (sup->threads[i].state == SLOT_RUNNING &&
+		    pthread_equal(sup->threads[i].thread, pthread_self()))
+			return &sup->threads[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Stop and join every thread, except the calling thread if it is one of
+ * ours; it is returned so that it exits once back in its loop.
+ */
+static struct qcomtee_supplicant_thread *
+qcomtee_supplicant_join(struct qcomtee_supplicant *sup)
+{
+	struct timespec ts = { 0, SUPPLICANT_KICK_NS };
+	struct qcomtee_supplicant_thread *t, *self;
+	int i, receivers;
+
+	pthread_mutex_lock(&sup->lock);
+	sup->stop = 1;
+	self = qcomtee_supplicant_self(sup);
+	pthread_cond_broadcast(&sup->cond);
+	pthread_mutex_unlock(&sup->lock);
+
+	if (sup->has_housekeeper)
+		pthread_join(sup->housekeeper, NULL);
+
+	/* A thread either sees stop or is seen waiting, and signalled. */
+	pthread_mutex_lock(&sup->lock);
+	do {
+		receivers = 0;
+		for (i = 0; i < QCOMTEE_SUPPLICANT_THREADS_MAX; i++) {
+			t = &sup->threads[i];
+			if (t->state != SLOT_RUNNING ||
+			    t->role == ROLE_DISPATCHER || t == self)
+				continue;
+
+			receivers++;
+			if (t->waiting)
+				pthread_kill(t->thread, sup->signo);
+		}
+
+		if (receivers) {
+			pthread_mutex_unlock(&sup->lock);
+			nanosleep(&ts, NULL);
+			pthread_mutex_lock(&sup->lock);
+		}
+	} while (receivers);
+
+	/* Readers are gone; dispatchers drain the rings and exit. */
+	if (sup->requests) {
+		atomic_store(&sup->dispatch_stop, 1);
+		for (i = 0; i < sup->nthreads; i++)
+			sem_post(&sup->items);
+
+		while (sup->nthreads > (self && self->role == ROLE_DISPATCHER))
+			pthread_cond_wait(&sup->cond, &sup->lock);
+	}
+
+	qcomtee_supplicant_reap(sup);
+	pthread_mutex_unlock(&sup->lock);
+
+	return self;
+}
+
+static void qcomtee_supplicant_free(struct qcomtee_supplicant *sup)
+{
+	int i;
+
+	if (sup->requests) {
+		for (i = 0; i < sup->nrequests; i++)
+			qcomtee_request_free(sup->requests[i]);
+		free(sup->requests);
+
+		sem_destroy(&sup->items);
+		qcomtee_ring_destroy(&sup->free);
+		for (i = 0; i < QCOMTEE_OBJECT_PRIORITY_CLASSES; i++)
+			qcomtee_ring_destroy(&sup->ready[i]);
+	}
+
+	pthread_cond_destroy(&sup->cond);
+	pthread_mutex_destroy(&sup->lock);
+	qcomtee_signal_put(sup->signo);
+	free(sup);
+}
+
+/* Requests for the readers; one for each reader, dispatcher, and cell. */
+static int qcomtee_supplicant_init_requests(struct qcomtee_supplicant *sup,
+					    int readers)
+{
+	int c, i, n;
+	size_t size;
+
+	n = SUPPLICANT_RING_SIZE + readers + sup->max_threads;
+	for (size = 1; size < (size_t)n; size *= 2)
+		;
+
+	sup->requests = calloc(n, sizeof(*sup->requests));
+	if (!sup->requests)
+		return -1;
+
+	for (c = 0; c < QCOMTEE_OBJECT_PRIORITY_CLASSES; c++)
+		if (qcomtee_ring_init(&sup->ready[c], SUPPLICANT_RING_SIZE))
+			goto failed_ready;
+	if (qcomtee_ring_init(&sup->free, size))
+		goto failed_ready;
+	if (sem_init(&sup->items, 0, 0))
+		goto failed_sem;
+
+	for (i = 0; i < n; i++) {
+		sup->requests[i] = qcomtee_request_alloc(sup->root);
+		if (!sup->requests[i])
+			goto failed_alloc;
+
+		sup->nrequests++;
+		qcomtee_ring_push(&sup->free, sup->requests[i]);
+	}
+
+	return 0;
+
+failed_alloc:
+	for (i = 0; i < sup->nrequests; i++)
+		qcomtee_request_free(sup->requests[i]);
+	sem_destroy(&sup->items);
+failed_sem:
+	qcomtee_ring_destroy(&sup->free);
+failed_ready:
+	while (c--)
+		qcomtee_ring_destroy(&sup->ready[c]);
+	free(sup->requests);
+	sup->requests = NULL;
+
+	return -1;
+}
+
+struct qcomtee_supplicant *
+qcomtee_supplicant_start(struct qcomtee_object *root, int nthreads,
+			 const struct qcomtee_supplicant_opts *opts)
+{
+	struct qcomtee_supplicant *sup;
+	pthread_condattr_t cattr;
+	sigset_t set, oldset;
+	int i, readers, ret = 0;
+
+	readers = opts ? opts->readers : 0;
+	if (root == QCOMTEE_OBJECT_NULL ||
+	    root->object_type != QCOMTEE_OBJECT_TYPE_ROOT || nthreads < 1 ||
+	    readers < 0 ||
+	    nthreads + readers > QCOMTEE_SUPPLICANT_THREADS_MAX)
+		return NULL;
+
+	/* The rings have members on their own cache lines. */
+	if (posix_memalign((void **)&sup, 64, sizeof(*sup)))
+		return NULL;
+
+	memset(sup, 0, sizeof(*sup));
+
+	sup->root = root;
+	sup->signo = (opts && opts->signo) ? opts->signo : SIGRTMIN;
+	if (qcomtee_signal_get(sup->signo)) {
+		free(sup);
+		return NULL;
+	}
+
+	sup->min_threads = nthreads;
+	sup->max_threads = nthreads;
+	if (opts && opts->max_threads > nthreads)
+		sup->max_threads = opts->max_threads;
+	if (sup->max_threads + readers > QCOMTEE_SUPPLICANT_THREADS_MAX)
+		sup->max_threads = QCOMTEE_SUPPLICANT_THREADS_MAX - readers;
+	sup->linger_ns = ((opts && opts->linger_ms > 0) ?
+				  opts->linger_ms :
+				  QCOMTEE_SUPPLICANT_LINGER_MS) *
+			 1000000ULL;
+	sup->stack_size = opts ? opts->stack_size : 0;
+
+	pthread_mutex_init(&sup->lock, NULL);
+	pthread_condattr_init(&cattr);
+	pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+	pthread_cond_init(&sup->cond, &cattr);
+	pthread_condattr_destroy(&cattr);
+	qcomtee_sched_init(&sup->sched);
+
+	if (readers && qcomtee_supplicant_init_requests(sup, readers))
+		goto failed_out;
+
+	pthread_mutex_lock(&sup->lock);
+	for (i = 0; i < nthreads && !ret; i++)
+		ret = qcomtee_supplicant_spawn(
+			sup, readers ? ROLE_DISPATCHER : ROLE_WORKER);
+	for (i = 0; i < readers && !ret; i++)
+		ret = qcomtee_supplicant_spawn(sup, ROLE_READER);
+	pthread_mutex_unlock(&sup->lock);
+
+	/* A fixed supplicant has nothing to retire. */
+	if (!ret && sup->max_threads > sup->min_threads) {
+		sigfillset(&set);
+		pthread_sigmask(SIG_SETMASK, &set, &oldset);
+		ret = pthread_create(&sup->housekeeper, NULL,
+				     qcomtee_supplicant_housekeeper, sup);
+		pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+		sup->has_housekeeper = !ret;
+	}
+
+	if (ret) {
+		qcomtee_supplicant_join(sup);
+		goto failed_out;
+	}
+
+	return sup;
+
+failed_out:
+	qcomtee_supplicant_free(sup);
+
+	return NULL;
+}
+
+void qcomtee_supplicant_get_stats(struct qcomtee_supplicant *sup,
+				  struct qcomtee_supplicant_stats *stats)
+{
+	pthread_mutex_lock(&sup->lock);
+	stats->threads = sup->nthreads + sup->nreaders;
+	stats->receiving = atomic_load(&sup->receiving);
+	stats->dispatching = atomic_load(&sup->dispatching);
+	stats->started = sup->started;
+	stats->retired = sup->retired;
+	pthread_mutex_unlock(&sup->lock);
+
+	qcomtee_sched_get_stats(&sup->sched, stats);
+}
+
+void qcomtee_supplicant_stop(struct qcomtee_supplicant *sup)
+{
+	struct qcomtee_supplicant_thread *self;
+
+	self = qcomtee_supplicant_join(sup);
+	if (self)
+		self->free_sup = 1;
+	else
+		qcomtee_supplicant_free(sup);
+}
@@ -0,0 +1,54 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "tests_private.h"
+
+/* All benchmarks run against the mock QTEE; see mock_tee.c. */
+static const struct {
+	const char *name;
+	void (*run)(void);
+	const char *help;
+} benchmarks[] = {
+	{ "ns_lookup", test_bench_ns_lookup,
+	  "Callback object lookup with 1, 128 and 1023 live entries" },
+	{ "ns_contention", test_bench_ns_contention,
+	  "Concurrent callback requests while the namespace is updated" },
+	{ "ns_churn", test_bench_ns_churn,
+	  "Object export and release on a crowded namespace" },
+	{ "invoke", test_bench_invoke,
+	  "Direct invocation with 0, 4, 16 and 64 buffer parameters" },
+	{ "invoke_prepared", test_bench_invoke_prepared,
+	  "Same as invoke, using a prepared invocation" },
+	{ "invoke_batch", test_bench_invoke_batch,
+	  "Fan-out of 1 ms invocations, one by one and as a batch" },
+	{ "invoke_async", test_bench_invoke_async,
+	  "One thread with up to 64 asynchronous 1 ms invocations in flight" },
+	{ "supplicant", test_bench_supplicant,
+	  "Callback requests of 100 us with 1, 2, 4 and 8 supplicant threads" },
+	{ "supplicant_readers", test_bench_supplicant_readers,
+	  "Same as supplicant, with a reader and 1, 2, 4 and 8 dispatchers" },
+	{ "mem_first_touch", test_bench_mem_first_touch,
+	  "Allocation and first touch of memory objects with each flag" },
+};
+
+#define NUM_BENCHMARKS (sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+int test_run_benchmark(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < NUM_BENCHMARKS; i++) {
+		if (!strcmp(name, benchmarks[i].name)) {
+			MSG("Starting benchmark %s\n", name);
+			benchmarks[i].run();
+
+			return 0;
+		}
+	}
+
+	MSG("Unknown benchmark %s; available benchmarks are:\n", name);
+	for (i = 0; i < NUM_BENCHMARKS; i++)
+		MSG_INFO("%-15s %s\n", benchmarks[i].name, benchmarks[i].help);
+
+	return 1;
+}
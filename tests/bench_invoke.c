@@ -0,0 +1,204 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "tests_private.h"
+
+#define BENCH_INVOKE_ITERATIONS 1000000
+
+/* QTEE does not support more than 64 parameter. */
+#define BENCH_INVOKE_PARAMS_MAX 64
+
+/* Half inputs, half outputs; reset on every call as QTEE updates sizes. */
+static void bench_invoke_params(struct qcomtee_param *params, uint64_t *data,
+				int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		params[i].attr = (i & 1) ? QCOMTEE_UBUF_OUTPUT :
+					   QCOMTEE_UBUF_INPUT;
+		params[i].ubuf.addr = &data[i];
+		params[i].ubuf.size = sizeof(data[i]);
+	}
+}
+
+/* Direct invocations of the root object with only buffer parameters. */
+static void bench_invoke(int prepared)
+{
+	static const int nparams[] = { 0, 4, 16, 64 };
+	struct qcomtee_param params[BENCH_INVOKE_PARAMS_MAX];
+	uint64_t data[BENCH_INVOKE_PARAMS_MAX];
+	struct qcomtee_invoke_prepared *p = NULL;
+	struct qcomtee_object *root;
+	qcomtee_result_t result;
+	uint64_t start, elapsed;
+	size_t n;
+	int i, ret;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return;
+
+	for (n = 0; n < sizeof(nparams) / sizeof(nparams[0]); n++) {
+		if (prepared) {
+			bench_invoke_params(params, data, nparams[n]);
+			p = qcomtee_object_invoke_prepare(root, 0, params,
+							  nparams[n]);
+			if (!p) {
+				MSG_ERROR("Unable to prepare invocation\n");
+				break;
+			}
+		}
+
+		start = test_time_ns();
+		for (i = 0; i < BENCH_INVOKE_ITERATIONS; i++) {
+			bench_invoke_params(params, data, nparams[n]);
+			if (prepared)
+				ret = qcomtee_object_invoke_exec(p, params,
+								 &result);
+			else
+				ret = qcomtee_object_invoke(root, 0, params,
+							    nparams[n],
+							    &result);
+
+			if (ret || result != QCOMTEE_OK) {
+				MSG_ERROR("Invocation failed, result %d\n",
+					  result);
+				break;
+			}
+		}
+		elapsed = test_time_ns() - start;
+
+		MSG_INFO("%2d parameters: %8.1f ns/invoke\n", nparams[n],
+			 (double)elapsed / BENCH_INVOKE_ITERATIONS);
+
+		qcomtee_object_invoke_prepared_release(p);
+		p = NULL;
+	}
+
+	qcomtee_object_refs_dec(root);
+}
+
+void test_bench_invoke(void)
+{
+	bench_invoke(0);
+}
+
+void test_bench_invoke_prepared(void)
+{
+	bench_invoke(1);
+}
+
+#define BENCH_BATCH_MAX 64
+#define BENCH_BATCH_ROUNDS 10
+
+/* Invocations that each keep QTEE busy for 1 ms. */
+void test_bench_invoke_batch(void)
+{
+	static const int sizes[] = { 1, 4, 16, 64 };
+	struct qcomtee_invoke_desc descs[BENCH_BATCH_MAX];
+	struct qcomtee_object *root;
+	uint64_t start, one, batch;
+	size_t n;
+	int i, r;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return;
+
+	mock_tee.invoke_delay_ns = 1000000;
+
+	for (n = 0; n < sizeof(sizes) / sizeof(sizes[0]); n++) {
+		for (i = 0; i < sizes[n]; i++)
+			descs[i] = (struct qcomtee_invoke_desc){
+				.object = root
+			};
+
+		start = test_time_ns();
+		for (r = 0; r < BENCH_BATCH_ROUNDS; r++) {
+			for (i = 0; i < sizes[n]; i++)
+				descs[i].ret = qcomtee_object_invoke(
+					root, 0, NULL, 0, &descs[i].result);
+		}
+		one = test_time_ns() - start;
+
+		start = test_time_ns();
+		for (r = 0; r < BENCH_BATCH_ROUNDS; r++) {
+			if (qcomtee_object_invoke_batch(descs, sizes[n]))
+				MSG_ERROR("Batch failed\n");
+		}
+		batch = test_time_ns() - start;
+
+		MSG_INFO("%2d calls: %8.2f ms one by one, %8.2f ms batched\n",
+			 sizes[n], one / 1e6 / BENCH_BATCH_ROUNDS,
+			 batch / 1e6 / BENCH_BATCH_ROUNDS);
+	}
+
+	qcomtee_object_refs_dec(root);
+}
+
+/* One thread keeps up to 64 invocations of 1 ms in flight. */
+void test_bench_invoke_async(void)
+{
+	static const int sizes[] = { 1, 4, 16, 64 };
+	struct qcomtee_invoke_async asyncs[BENCH_BATCH_MAX];
+	struct qcomtee_object *root;
+	uint64_t start, elapsed, count;
+	int efd, done;
+	size_t n;
+	int i, r;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return;
+
+	efd = eventfd(0, EFD_CLOEXEC);
+	if (efd < 0) {
+		MSG_ERROR("%s\n", strerror(errno));
+		goto dec_root_object;
+	}
+
+	mock_tee.invoke_delay_ns = 1000000;
+
+	for (n = 0; n < sizeof(sizes) / sizeof(sizes[0]); n++) {
+		start = test_time_ns();
+		for (r = 0; r < BENCH_BATCH_ROUNDS; r++) {
+			for (i = 0; i < sizes[n]; i++) {
+				asyncs[i] = QCOMTEE_INVOKE_ASYNC_INIT(root, 0,
+								      NULL, 0);
+				asyncs[i].fd = efd;
+				if (qcomtee_object_invoke_async(&asyncs[i])) {
+					MSG_ERROR("Unable to queue\n");
+					goto close_efd;
+				}
+			}
+
+			/* The eventfd counter adds up completions. */
+			for (done = 0; done < sizes[n]; done += count) {
+				if (read(efd, &count, sizeof(count)) !=
+				    sizeof(count)) {
+					MSG_ERROR("%s\n", strerror(errno));
+					goto close_efd;
+				}
+			}
+
+			for (i = 0; i < sizes[n]; i++) {
+				if (asyncs[i].ret ||
+				    asyncs[i].result != QCOMTEE_OK)
+					MSG_ERROR("Invocation failed\n");
+			}
+		}
+		elapsed = test_time_ns() - start;
+
+		MSG_INFO("%2d in flight: %8.2f ms/round\n", sizes[n],
+			 elapsed / 1e6 / BENCH_BATCH_ROUNDS);
+	}
+
+close_efd:
+	close(efd);
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <unistd.h>
+
+#include "tests_private.h"
+
+#define BENCH_MEM_ITERATIONS 20
+
+/* Write a byte to every page, as the first use of a new buffer would. */
+static void bench_mem_touch(char *addr, size_t size, long page_size)
+{
+	size_t off;
+
+	for (off = 0; off < size; off += page_size)
+		((volatile char *)addr)[off] = 1;
+}
+
+/* Average time to allocate an object and to touch it for the first time. */
+static int bench_mem_first_touch(struct qcomtee_object *root, size_t size,
+				 unsigned int flags, uint64_t *alloc_ns,
+				 uint64_t *touch_ns)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	struct qcomtee_object *mem;
+	uint64_t start;
+	int i;
+
+	*alloc_ns = *touch_ns = 0;
+	for (i = 0; i < BENCH_MEM_ITERATIONS; i++) {
+		start = test_time_ns();
+		if (qcomtee_memory_object_alloc_flags(size, flags, root, &mem))
+			return -1;
+		*alloc_ns += test_time_ns() - start;
+
+		start = test_time_ns();
+		bench_mem_touch(qcomtee_memory_object_addr(mem), size,
+				page_size);
+		*touch_ns += test_time_ns() - start;
+
+		qcomtee_memory_object_release(mem);
+	}
+
+	*alloc_ns /= BENCH_MEM_ITERATIONS;
+	*touch_ns /= BENCH_MEM_ITERATIONS;
+
+	return 0;
+}
+
+void test_bench_mem_first_touch(void)
+{
+	static const size_t sizes[] = { 1 << 20, 16 << 20 };
+	static const struct {
+		const char *name;
+		unsigned int flags;
+	} modes[] = {
+		{ "default", 0 },
+		{ "populate", QCOMTEE_MEMORY_POPULATE },
+		{ "hugepage", QCOMTEE_MEMORY_HUGEPAGE },
+		{ "hugepage+populate",
+		  QCOMTEE_MEMORY_HUGEPAGE | QCOMTEE_MEMORY_POPULATE },
+	};
+	struct qcomtee_object *root;
+	uint64_t alloc_ns, touch_ns;
+	size_t s, m;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return;
+
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+			if (bench_mem_first_touch(root, sizes[s],
+						  modes[m].flags, &alloc_ns,
+						  &touch_ns)) {
+				MSG_ERROR("Unable to allocate memory object\n");
+				goto dec_root_object;
+			}
+
+			MSG_INFO("%2zu MiB %-17s: alloc %8.1f us, touch %8.1f us\n",
+				 sizes[s] >> 20, modes[m].name, alloc_ns / 1e3,
+				 touch_ns / 1e3);
+		}
+	}
+
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+}
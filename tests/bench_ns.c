@@ -0,0 +1,305 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <pthread.h>
+
+#include "tests_private.h"
+
+#define BENCH_NS_ITERATIONS 200000
+
+/* QTEE does not support more than 64 parameter. */
+#define BENCH_NS_EXPORT_MAX 64
+
+static qcomtee_result_t bench_ns_dispatch(struct qcomtee_object *object,
+					  qcomtee_op_t op,
+					  struct qcomtee_param *params, int num)
+{
+	(void)object;
+	(void)op;
+	(void)params;
+	(void)num;
+
+	return QCOMTEE_OK;
+}
+
+/* Objects are allocated in bulk and freed by the benchmark. */
+static struct qcomtee_object_ops bench_ns_ops = {
+	.dispatch = bench_ns_dispatch,
+};
+
+/* Request generator for the mock QTEE; arg is the request to repeat. */
+static int bench_ns_recv(struct mock_tee_request *req, void *arg)
+{
+	*req = *(struct mock_tee_request *)arg;
+
+	return 0;
+}
+
+/* Export objects to QTEE; on success, QTEE owns them. */
+static int bench_ns_export(struct qcomtee_object *root,
+			   struct qcomtee_object *objects, int n)
+{
+	struct qcomtee_param params[BENCH_NS_EXPORT_MAX];
+	qcomtee_result_t result;
+	int i, j, k;
+
+	for (i = 0; i < n; i += k) {
+		k = n - i < BENCH_NS_EXPORT_MAX ? n - i : BENCH_NS_EXPORT_MAX;
+		for (j = 0; j < k; j++) {
+			qcomtee_object_cb_init(&objects[i + j], &bench_ns_ops,
+					       root);
+			params[j].attr = QCOMTEE_OBJREF_INPUT;
+			params[j].object = &objects[i + j];
+		}
+
+		if (qcomtee_object_invoke(root, 0, params, k, &result) ||
+		    (result != QCOMTEE_OK)) {
+			MSG_ERROR("Unable to export objects, result %d\n",
+				  result);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* QTEE releases the objects it owns. */
+static void bench_ns_release(struct qcomtee_object *root,
+			     struct qcomtee_object *objects, int n)
+{
+	struct mock_tee_request req = { .op = QCOMTEE_OBJREF_OP_RELEASE };
+	int i;
+
+	mock_tee.recv = bench_ns_recv;
+	mock_tee.arg = &req;
+	for (i = 0; i < n; i++) {
+		req.object_id = objects[i].tee_object_id;
+		qcomtee_object_process_one(root);
+	}
+}
+
+/* Each request from QTEE looks up the most recently exported object. */
+void test_bench_ns_lookup(void)
+{
+	static const int live[] = { 1, 128, 1023 };
+	struct qcomtee_object *root, *objects;
+	struct mock_tee_request req;
+	uint64_t start, elapsed;
+	size_t l;
+	int i;
+
+	for (l = 0; l < sizeof(live) / sizeof(live[0]); l++) {
+		root = mock_get_root();
+		if (root == QCOMTEE_OBJECT_NULL)
+			return;
+
+		objects = calloc(live[l], sizeof(*objects));
+		if (!objects) {
+			MSG_ERROR("%s\n", strerror(errno));
+			goto dec_root_object;
+		}
+
+		if (bench_ns_export(root, objects, live[l]))
+			goto free_objects;
+
+		req = (struct mock_tee_request){
+			.object_id = objects[live[l] - 1].tee_object_id,
+		};
+		mock_tee.recv = bench_ns_recv;
+		mock_tee.arg = &req;
+
+		start = test_time_ns();
+		for (i = 0; i < BENCH_NS_ITERATIONS; i++)
+			qcomtee_object_process_one(root);
+		elapsed = test_time_ns() - start;
+
+		if (atomic_load(&mock_tee.errors))
+			MSG_ERROR("%lu requests failed\n",
+				  atomic_load(&mock_tee.errors));
+
+		MSG_INFO("%4d live entries: %8.1f ns/request\n", live[l],
+			 (double)elapsed / BENCH_NS_ITERATIONS);
+
+		bench_ns_release(root, objects, live[l]);
+free_objects:
+		free(objects);
+dec_root_object:
+		qcomtee_object_refs_dec(root);
+	}
+}
+
+#define BENCH_NS_LIVE 256
+#define BENCH_NS_THREADS_MAX 8
+
+/* Request repeated by bench_ns_recv_local for the calling thread. */
+static _Thread_local struct mock_tee_request bench_ns_req;
+
+static int bench_ns_recv_local(struct mock_tee_request *req, void *arg)
+{
+	(void)arg;
+	*req = bench_ns_req;
+
+	return 0;
+}
+
+struct bench_ns_thread {
+	pthread_t thread;
+	struct qcomtee_object *root;
+	struct qcomtee_object *objects;
+	int id;
+	atomic_int *stop;
+	unsigned long ops;
+};
+
+/* Reader: QTEE keeps calling the exported objects. */
+static void *bench_ns_reader(void *arg)
+{
+	struct bench_ns_thread *t = arg;
+	int i;
+
+	bench_ns_req.op = 0;
+	for (i = 0; i < BENCH_NS_ITERATIONS; i++) {
+		bench_ns_req.object_id =
+			t->objects[(t->id * 7 + i) % BENCH_NS_LIVE].tee_object_id;
+		qcomtee_object_process_one(t->root);
+	}
+
+	t->ops = i;
+
+	return NULL;
+}
+
+/* Writer: export a fresh object and have QTEE release it. */
+static void *bench_ns_writer(void *arg)
+{
+	struct bench_ns_thread *t = arg;
+	struct qcomtee_object object;
+
+	while (!atomic_load(t->stop)) {
+		if (bench_ns_export(t->root, &object, 1))
+			break;
+
+		bench_ns_req.object_id = object.tee_object_id;
+		bench_ns_req.op = QCOMTEE_OBJREF_OP_RELEASE;
+		qcomtee_object_process_one(t->root);
+		t->ops++;
+	}
+
+	return NULL;
+}
+
+/* Readers share one root with a writer churning the namespace. */
+void test_bench_ns_contention(void)
+{
+	struct bench_ns_thread threads[BENCH_NS_THREADS_MAX], writer;
+	struct qcomtee_object *root, *objects;
+	uint64_t start, elapsed;
+	unsigned long ops;
+	atomic_int stop;
+	int n, i;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return;
+
+	objects = calloc(BENCH_NS_LIVE, sizeof(*objects));
+	if (!objects) {
+		MSG_ERROR("%s\n", strerror(errno));
+		goto dec_root_object;
+	}
+
+	if (bench_ns_export(root, objects, BENCH_NS_LIVE))
+		goto free_objects;
+
+	mock_tee.recv = bench_ns_recv_local;
+
+	for (n = 1; n <= BENCH_NS_THREADS_MAX; n *= 2) {
+		atomic_init(&stop, 0);
+		writer = (struct bench_ns_thread){ .root = root, .stop = &stop };
+		if (pthread_create(&writer.thread, NULL, bench_ns_writer,
+				   &writer)) {
+			MSG_ERROR("Unable to start writer thread\n");
+			break;
+		}
+
+		start = test_time_ns();
+		for (i = 0; i < n; i++) {
+			threads[i] = (struct bench_ns_thread){
+				.root = root, .objects = objects, .id = i
+			};
+			if (pthread_create(&threads[i].thread, NULL,
+					   bench_ns_reader, &threads[i]))
+				break;
+		}
+
+		for (ops = 0, n = i, i = 0; i < n; i++) {
+			pthread_join(threads[i].thread, NULL);
+			ops += threads[i].ops;
+		}
+		elapsed = test_time_ns() - start;
+
+		atomic_store(&stop, 1);
+		pthread_join(writer.thread, NULL);
+
+		MSG_INFO("%d readers: %10.0f requests/s, %lu writer updates\n",
+			 n, ops * 1e9 / elapsed, writer.ops);
+	}
+
+	if (atomic_load(&mock_tee.errors))
+		MSG_ERROR("%lu requests failed\n",
+			  atomic_load(&mock_tee.errors));
+
+	bench_ns_release(root, objects, BENCH_NS_LIVE);
+free_objects:
+	free(objects);
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+}
+
+/* QTEE keeps receiving and releasing one object on a crowded namespace. */
+void test_bench_ns_churn(void)
+{
+	/* Live entries in a 1024 entry table. */
+	static const int live[] = { 512, 960, 1022 };
+	struct qcomtee_object *root, *objects, object;
+	uint64_t start, elapsed;
+	size_t l;
+	int i;
+
+	for (l = 0; l < sizeof(live) / sizeof(live[0]); l++) {
+		root = mock_get_root();
+		if (root == QCOMTEE_OBJECT_NULL)
+			return;
+
+		objects = calloc(live[l], sizeof(*objects));
+		if (!objects) {
+			MSG_ERROR("%s\n", strerror(errno));
+			goto dec_root_object;
+		}
+
+		if (bench_ns_export(root, objects, live[l]))
+			goto free_objects;
+
+		mock_tee.recv = bench_ns_recv_local;
+		bench_ns_req.op = QCOMTEE_OBJREF_OP_RELEASE;
+
+		start = test_time_ns();
+		for (i = 0; i < BENCH_NS_ITERATIONS; i++) {
+			if (bench_ns_export(root, &object, 1))
+				break;
+
+			bench_ns_req.object_id = object.tee_object_id;
+			qcomtee_object_process_one(root);
+		}
+		elapsed = test_time_ns() - start;
+
+		MSG_INFO("%4d live entries: %8.1f ns/insert+delete\n", live[l],
+			 (double)elapsed / BENCH_NS_ITERATIONS);
+
+		bench_ns_release(root, objects, live[l]);
+free_objects:
+		free(objects);
+dec_root_object:
+		qcomtee_object_refs_dec(root);
+	}
+}
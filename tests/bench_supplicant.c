@@ -0,0 +1,74 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <sched.h>
+#include <qcomtee_supplicant.h>
+
+#include "tests_private.h"
+
+#define BENCH_SUPPLICANT_REQUESTS 2000
+#define BENCH_SUPPLICANT_WORK_NS 100000 /* 100 us. */
+#define BENCH_SUPPLICANT_THREADS_MAX 8
+
+/* QTEE keeps calling an object that blocks for a while in each request. */
+static void bench_supplicant(int readers)
+{
+	struct qcomtee_supplicant_opts opts = { .readers = readers };
+	struct mock_tee_stream stream;
+	struct qcomtee_supplicant *sup;
+	struct mock_cb_object cb;
+	struct qcomtee_object *root;
+	uint64_t start, elapsed;
+	int n;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return;
+
+	if (mock_cb_export(root, &cb, BENCH_SUPPLICANT_WORK_NS, 0))
+		goto dec_root_object;
+
+	for (n = 1; n <= BENCH_SUPPLICANT_THREADS_MAX; n *= 2) {
+		stream.req = (struct mock_tee_request){
+			.object_id = cb.object.tee_object_id,
+		};
+		atomic_init(&stream.count, BENCH_SUPPLICANT_REQUESTS);
+		atomic_store(&mock_tee.sends, 0);
+		mock_tee.recv = mock_tee_stream_recv;
+		mock_tee.arg = &stream;
+
+		start = test_time_ns();
+		sup = qcomtee_supplicant_start(root, n, &opts);
+		if (!sup) {
+			MSG_ERROR("Unable to start supplicant\n");
+			break;
+		}
+
+		while (atomic_load(&mock_tee.sends) < BENCH_SUPPLICANT_REQUESTS)
+			sched_yield();
+		elapsed = test_time_ns() - start;
+
+		qcomtee_supplicant_stop(sup);
+
+		MSG_INFO("%d threads: %8.0f requests/s\n", n,
+			 BENCH_SUPPLICANT_REQUESTS * 1e9 / elapsed);
+	}
+
+	if (atomic_load(&mock_tee.errors))
+		MSG_ERROR("%lu requests failed\n",
+			  atomic_load(&mock_tee.errors));
+
+	mock_cb_release(root, &cb);
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+}
+
+void test_bench_supplicant(void)
+{
+	bench_supplicant(0);
+}
+
+void test_bench_supplicant_readers(void)
+{
+	bench_supplicant(1);
+}
@@ -1,15 +1,19 @@
 // Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
 // SPDX-License-Identifier: BSD-3-Clause
 
-#include <pthread.h>
 #include <stdarg.h>
 #include <sys/ioctl.h>
 
+#include <qcomtee_supplicant.h>
+
 #include "tests_private.h"
+#include "IClientEnv.h"
+
+/* Number of threads serving callback requests from QTEE. */
+#define TEST_SUPPLICANT_THREADS 4
 
 struct supplicant {
-	pthread_t thread;
-	struct qcomtee_object *root;
+	struct qcomtee_supplicant *sup;
 };
 
 /* op is TEE_IOC_SUPPL_RECV or TEE_IOC_SUPPL_SEND. */
@@ -26,47 +30,24 @@ static int tee_call(int fd, int op, ...)
 	void *arg = va_arg(ap, void *);
 	va_end(ap);
 
-	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 	ret = ioctl(fd, op, arg);
-	pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
-	if (ret < 0)
+	/* EINTR is how the supplicant is stopped. */
+	if (ret < 0 && errno != EINTR)
 		MSG_ERROR("%s\n", strerror(errno));
 
 	return ret;
 }
 
-/* arg is the instance of supplicant. */
-static void *test_supplicant_worker(void *arg)
-{
-	struct supplicant *sup = (struct supplicant *)arg;
-
-	while (1) {
-		pthread_testcancel();
-		if (qcomtee_object_process_one(sup->root))
-			break;
-	}
-
-	MSG_INFO("Supplicant thread exited\n");
-
-	return NULL;
-}
-
 /* arg is the instance of supplicant. */
 static void test_supplicant_release(void *arg)
 {
 	struct supplicant *sup = (struct supplicant *)arg;
 
-	/* Here, we are sure there is no QTEE or callback object.
-	 * We issue the pthread_cancel and wait for the thread to get cancelled
-	 * at pthread_testcancel or in tee_call.
-	 */
+	/* Here, we are sure there is no QTEE or callback object. */
+	if (sup->sup)
+		qcomtee_supplicant_stop(sup->sup);
 
-	if (sup->thread) {
-		pthread_cancel(sup->thread);
-		pthread_join(sup->thread, NULL);
-	}
-
-	MSG_INFO("Supplicant thread killed.\n");
+	MSG_INFO("Supplicant stopped.\n");
 
 	free(sup);
 }
@@ -75,7 +56,6 @@ struct qcomtee_object *test_get_root(void)
 {
 	struct qcomtee_object *root;
 	struct supplicant *sup;
-	pthread_t thread;
 
 	sup = calloc(1, sizeof(*sup));
 	if (!sup) {
@@ -88,30 +68,27 @@ struct qcomtee_object *test_get_root(void)
 					test_supplicant_release, sup);
 	if (root == QCOMTEE_OBJECT_NULL) {
 		MSG_ERROR("Unable to initialize the root object\n");
-		goto failed_out;
-	}
+		free(sup);
 
-	sup->root = root;
-	/* Start a supplicant thread. */
-	if (pthread_create(&thread, NULL, test_supplicant_worker, sup)) {
-		MSG_ERROR("Unable to start supplicant thread\n");
-		goto failed_out;
+		return QCOMTEE_OBJECT_NULL;
 	}
 
-	sup->thread = thread;
-	return root;
+	/* Start the supplicant threads. */
+	sup->sup = qcomtee_supplicant_start(root, TEST_SUPPLICANT_THREADS, NULL);
+	if (!sup->sup) {
+		MSG_ERROR("Unable to start supplicant\n");
+		/* Releases sup. */
+		qcomtee_object_refs_dec(root);
 
-failed_out:
-	qcomtee_object_refs_dec(root);
-	free(sup);
+		return QCOMTEE_OBJECT_NULL;
+	}
 
-	return QCOMTEE_OBJECT_NULL;
+	return root;
 }
 
 struct qcomtee_object *test_get_client_env_object(struct qcomtee_object *root)
 {
-	struct qcomtee_object *creds_object;
-	struct qcomtee_param params[2];
+	struct qcomtee_object *creds_object, *client_env_object;
 	qcomtee_result_t result;
 
 	if (qcomtee_object_credentials_init(root, &creds_object)) {
@@ -119,12 +96,8 @@ struct qcomtee_object *test_get_client_env_object(struct qcomtee_object *root)
 		return QCOMTEE_OBJECT_NULL;
 	}
 
-	/* INIT parameters and invoke object: */
-	params[0].attr = QCOMTEE_OBJREF_INPUT;
-	params[0].object = creds_object;
-	params[1].attr = QCOMTEE_OBJREF_OUTPUT;
-	/* 2 is IClientEnv_OP_registerAsClient. */
-	if (qcomtee_object_invoke(root, 2, params, 2, &result)) {
+	if (IClientEnv_registerAsClient(root, creds_object, &client_env_object,
+					&result)) {
 		/* Releases creds_object. */
 		qcomtee_object_refs_dec(creds_object);
 		goto failed_out;
@@ -133,7 +106,7 @@ struct qcomtee_object *test_get_client_env_object(struct qcomtee_object *root)
 	/* qcomtee_object_invoke was successful; QTEE releases creds_object. */
 
 	if (!result)
-		return params[1].object;
+		return client_env_object;
 
 failed_out:
 	MSG_ERROR("Unable to obtain the env object, result %d\n", result);
@@ -143,15 +116,10 @@ failed_out:
 struct qcomtee_object *
 test_get_service_object(struct qcomtee_object *client_env_object, uint32_t uid)
 {
-	struct qcomtee_param params[2];
+	struct qcomtee_object *object;
 	qcomtee_result_t result;
 
-	/* INIT parameters and invoke object: */
-	params[0].attr = QCOMTEE_UBUF_INPUT;
-	params[0].ubuf = UBUF_INIT(&uid);
-	params[1].attr = QCOMTEE_OBJREF_OUTPUT;
-	/* 0 is IClientEnv_OP_open. */
-	if (qcomtee_object_invoke(client_env_object, 0, params, 2, &result) ||
+	if (IClientEnv_open(client_env_object, uid, &object, &result) ||
 	    (result != QCOMTEE_OK)) {
 		MSG_ERROR("Unable to obtain object (UID = %u), result %d\n",
 			  uid, result);
@@ -159,7 +127,7 @@ test_get_service_object(struct qcomtee_object *client_env_object, uint32_t uid)
 	}
 
 	MSG_INFO("Obtained object (UID = %u)\n", uid);
-	return params[1].object;
+	return object;
 }
 
 /* File stuff. */
@@ -11,13 +11,17 @@ static void usage(char *name)
 	       "\t-d - Run the TZ diagnostics test that prints basic info on TZ heaps.\n"
 	       "\t-l - Load the test TA and send command.\n"
 	       "\t\t%s -l <path to TA binary> <buffer vs. memory object> <command>\n"
+	       "\t-m - Run a test against the mock QTEE.\n"
+	       "\t\t%s -m <test>\n"
+	       "\t-b - Run a benchmark against the mock QTEE.\n"
+	       "\t\t%s -b <benchmark>\n"
 	       "\t-h - Print this help message and exit\n\n",
-	       name);
+	       name, name, name);
 }
 
 int main(int argc, char *argv[])
 {
-	switch (getopt(argc, argv, "dlh")) {
+	switch (getopt(argc, argv, "dlmbh")) {
 	case 'd':
 		test_print_diagnostics_info();
 		break;
@@ -27,6 +31,16 @@ int main(int argc, char *argv[])
 
 		test_load_sample_ta(argv[2], atoi(argv[3]), atoi(argv[4]));
 		break;
+	case 'm':
+		if (argc != 3)
+			goto help;
+
+		return test_run_mock_test(argv[2]);
+	case 'b':
+		if (argc != 3)
+			goto help;
+
+		return test_run_benchmark(argv[2]);
 help:
 	case 'h':
 	default:
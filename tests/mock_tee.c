@@ -0,0 +1,351 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/tee.h>
+
+#include "tests_private.h"
+
+/* A fake QTEE good enough to drive the library without a driver. */
+struct mock_tee mock_tee;
+
+/* Next ID assigned to the QTEE objects returned by the mock. */
+static atomic_ullong mock_tee_object_id = 1;
+
+/* Next ID assigned to the shm returned by TEE_IOC_SHM_ALLOC and REGISTER. */
+static atomic_ullong mock_tee_shm_id = 1;
+
+static int mock_tee_object_invoke(struct tee_ioctl_buf_data *buf_data)
+{
+	struct tee_ioctl_object_invoke_arg *arg;
+	struct tee_ioctl_param *tee_params;
+	unsigned int i;
+
+	arg = (struct tee_ioctl_object_invoke_arg *)(uintptr_t)buf_data->buf_ptr;
+	tee_params = (struct tee_ioctl_param *)(arg + 1);
+
+	atomic_fetch_add(&mock_tee.invokes, 1);
+
+	if (mock_tee.invoke_delay_ns) {
+		struct timespec ts = {
+			.tv_sec = mock_tee.invoke_delay_ns / 1000000000ULL,
+			.tv_nsec = mock_tee.invoke_delay_ns % 1000000000ULL,
+		};
+
+		nanosleep(&ts, NULL);
+	}
+
+	/* QTEE rejects the request; it takes nothing and returns nothing. */
+	if (mock_tee.fail_op && arg->op == mock_tee.fail_op) {
+		arg->ret = QCOMTEE_ERROR_INVALID;
+		return 0;
+	}
+
+	arg->ret = QCOMTEE_OK;
+	for (i = 0; i < arg->num_params; i++) {
+		/* Fill output buffers so the callers can check the copy. */
+		if (tee_params[i].attr == TEE_IOCTL_PARAM_ATTR_TYPE_UBUF_OUTPUT)
+			memset((void *)(uintptr_t)tee_params[i].a,
+			       MOCK_UBUF_PATTERN, tee_params[i].b);
+
+		/* Every output object is a brand new QTEE object. */
+		if (tee_params[i].attr == TEE_IOCTL_PARAM_ATTR_TYPE_OBJREF_OUTPUT) {
+			tee_params[i].a = atomic_fetch_add(&mock_tee_object_id, 1);
+			tee_params[i].b = QCOMTEE_OBJREF_TEE;
+		}
+	}
+
+	return 0;
+}
+
+/* A request that did not fit; it is delivered again on the next receive. */
+static _Thread_local struct mock_tee_request mock_tee_pending;
+static _Thread_local int mock_tee_has_pending;
+
+static int mock_tee_suppl_recv(struct tee_ioctl_buf_data *buf_data)
+{
+	struct tee_iocl_supp_recv_arg *arg;
+	struct tee_ioctl_param *tee_params;
+	struct mock_tee_request req;
+	size_t size;
+	char *ubuf;
+	int i;
+
+	arg = (struct tee_iocl_supp_recv_arg *)(uintptr_t)buf_data->buf_ptr;
+	tee_params = (struct tee_ioctl_param *)(arg + 1);
+
+	if (mock_tee_has_pending) {
+		req = mock_tee_pending;
+		mock_tee_has_pending = 0;
+	} else {
+		/* No request generator; nothing will ever arrive. */
+		if (!mock_tee.recv) {
+			errno = EINVAL;
+			return -1;
+		}
+
+		/* The generator sets errno, e.g. EINTR if it was interrupted. */
+		if (mock_tee.recv(&req, mock_tee.arg))
+			return -1;
+	}
+
+	/* Like the driver, reject a request that does not fit; keep it. */
+	size = req.num_ubufs * req.ubuf_size;
+	if (arg->num_params < (unsigned int)req.num_ubufs + 1 ||
+	    tee_params[0].b < size) {
+		mock_tee_pending = req;
+		mock_tee_has_pending = 1;
+		errno = EMSGSIZE;
+		return -1;
+	}
+
+	/* Input buffers are copied to the buffer in the meta parameter. */
+	ubuf = (char *)(uintptr_t)tee_params[0].a;
+	for (i = 1; i <= req.num_ubufs; i++) {
+		memset(ubuf, MOCK_UBUF_PATTERN, req.ubuf_size);
+		tee_params[i].attr = TEE_IOCTL_PARAM_ATTR_TYPE_UBUF_INPUT;
+		tee_params[i].a = (uintptr_t)ubuf;
+		tee_params[i].b = req.ubuf_size;
+		ubuf += req.ubuf_size;
+	}
+
+	arg->func = req.op;
+	arg->num_params = req.num_ubufs + 1;
+	tee_params[0].a = req.object_id;
+	tee_params[0].b = atomic_fetch_add(&mock_tee.recvs, 1);
+	tee_params[0].c = 0;
+
+	return 0;
+}
+
+static int mock_tee_suppl_send(struct tee_ioctl_buf_data *buf_data)
+{
+	struct tee_iocl_supp_send_arg *arg;
+
+	arg = (struct tee_iocl_supp_send_arg *)(uintptr_t)buf_data->buf_ptr;
+	if (arg->ret != QCOMTEE_OK)
+		atomic_fetch_add(&mock_tee.errors, 1);
+
+	atomic_fetch_add(&mock_tee.sends, 1);
+
+	return 0;
+}
+
+/* An unlinked file stands in for the driver's shm. */
+static int mock_tee_shm_fd(size_t size)
+{
+	FILE *file;
+	int fd;
+
+	file = tmpfile();
+	if (!file)
+		return -1;
+
+	fd = dup(fileno(file));
+	fclose(file);
+	if (fd < 0)
+		return -1;
+
+	if (ftruncate(fd, size)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int mock_tee_shm_alloc(struct tee_ioctl_shm_alloc_data *data)
+{
+	int fd;
+
+	fd = mock_tee_shm_fd(data->size);
+	if (fd < 0)
+		return -1;
+
+	data->id = atomic_fetch_add(&mock_tee_shm_id, 1);
+	atomic_fetch_add(&mock_tee.shm_allocs, 1);
+
+	return fd;
+}
+
+/* Nothing to pin; the fd only keeps the registration. */
+static int mock_tee_shm_register(struct tee_ioctl_shm_register_data *data)
+{
+	int fd;
+
+	if (mock_tee.no_register) {
+		errno = ENOTTY;
+		return -1;
+	}
+
+	fd = mock_tee_shm_fd(0);
+	if (fd < 0)
+		return -1;
+
+	data->id = atomic_fetch_add(&mock_tee_shm_id, 1);
+	atomic_fetch_add(&mock_tee.shm_registers, 1);
+
+	return fd;
+}
+
+#ifdef __GLIBC__
+static int mock_tee_call(int fd, unsigned long op, ...)
+#else
+static int mock_tee_call(int fd, int op, ...)
+#endif
+{
+	va_list ap;
+	void *arg;
+
+	(void)fd;
+
+	va_start(ap, op);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+
+	switch (op) {
+	case TEE_IOC_OBJECT_INVOKE:
+		return mock_tee_object_invoke(arg);
+	case TEE_IOC_SUPPL_RECV:
+		return mock_tee_suppl_recv(arg);
+	case TEE_IOC_SUPPL_SEND:
+		return mock_tee_suppl_send(arg);
+	case TEE_IOC_SHM_ALLOC:
+		return mock_tee_shm_alloc(arg);
+	case TEE_IOC_SHM_REGISTER:
+		return mock_tee_shm_register(arg);
+	case TEE_IOC_CANCEL:
+		/* Nothing to cancel; the invocation runs to the end. */
+		atomic_fetch_add(&mock_tee.cancels, 1);
+		return 0;
+	default:
+		errno = ENOTTY;
+		return -1;
+	}
+}
+
+int mock_tee_stream_recv(struct mock_tee_request *req, void *arg)
+{
+	struct mock_tee_stream *stream = arg;
+	struct timespec ts = { 1, 0 };
+
+	if (atomic_fetch_sub(&stream->count, 1) > 0) {
+		*req = stream->req;
+		return 0;
+	}
+
+	/* Nothing left; wait like the driver until a signal arrives. */
+	while (!nanosleep(&ts, NULL))
+		;
+
+	return -1;
+}
+
+static qcomtee_result_t mock_cb_dispatch(struct qcomtee_object *object,
+					 qcomtee_op_t op,
+					 struct qcomtee_param *params, int num)
+{
+	struct mock_cb_object *cb =
+		container_of(object, struct mock_cb_object, object);
+	struct timespec ts = {
+		.tv_sec = cb->work_ns / 1000000000ULL,
+		.tv_nsec = cb->work_ns % 1000000000ULL,
+	};
+	int active, max;
+
+	(void)op;
+	(void)params;
+	(void)num;
+
+	active = atomic_fetch_add(&cb->active, 1) + 1;
+	max = atomic_load(&cb->active_max);
+	while (active > max &&
+	       !atomic_compare_exchange_weak(&cb->active_max, &max, active))
+		;
+
+	if (cb->work_ns)
+		nanosleep(&ts, NULL);
+
+	atomic_fetch_sub(&cb->active, 1);
+
+	return QCOMTEE_OK;
+}
+
+static struct qcomtee_object_ops mock_cb_ops = {
+	.dispatch = mock_cb_dispatch,
+};
+
+static struct qcomtee_object_ops mock_cb_reentrant_ops = {
+	.dispatch = mock_cb_dispatch,
+	.flags = QCOMTEE_OBJECT_OPS_REENTRANT,
+};
+
+int mock_cb_export(struct qcomtee_object *root, struct mock_cb_object *cb,
+		   uint64_t work_ns, unsigned int flags)
+{
+	struct qcomtee_param params[1];
+	qcomtee_result_t result;
+
+	cb->work_ns = work_ns;
+	atomic_init(&cb->active, 0);
+	atomic_init(&cb->active_max, 0);
+	qcomtee_object_cb_init(&cb->object,
+			       (flags & QCOMTEE_OBJECT_OPS_REENTRANT) ?
+				       &mock_cb_reentrant_ops :
+				       &mock_cb_ops,
+			       root);
+
+	params[0].attr = QCOMTEE_OBJREF_INPUT;
+	params[0].object = &cb->object;
+	if (qcomtee_object_invoke(root, 0, params, 1, &result) ||
+	    result != QCOMTEE_OK) {
+		MSG_ERROR("Unable to export object, result %d\n", result);
+		return -1;
+	}
+
+	return 0;
+}
+
+void mock_cb_release(struct qcomtee_object *root, struct mock_cb_object *cb)
+{
+	struct mock_tee_stream stream = {
+		{ cb->object.tee_object_id, QCOMTEE_OBJREF_OP_RELEASE, 0, 0 }, 1
+	};
+
+	mock_tee.recv = mock_tee_stream_recv;
+	mock_tee.arg = &stream;
+	qcomtee_object_process_one(root);
+}
+
+struct qcomtee_object *mock_get_root_release(void (*release)(void *),
+					     void *arg)
+{
+	struct qcomtee_object *root;
+
+	memset(&mock_tee, 0, sizeof(mock_tee));
+
+	/* The mock never touches the driver; any file that opens would do. */
+	root = qcomtee_object_root_init(MOCK_DEV_TEE, mock_tee_call, release,
+					arg);
+	if (root == QCOMTEE_OBJECT_NULL)
+		MSG_ERROR("Unable to initialize the mock root object\n");
+
+	return root;
+}
+
+struct qcomtee_object *mock_get_root(void)
+{
+	return mock_get_root_release(NULL, NULL);
+}
+
+uint64_t test_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
@@ -0,0 +1,2598 @@
+// Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <qcomtee_supplicant.h>
+
+#include "tests_private.h"
+#include "IIO.h"
+
+#define MOCK_SLOW_NS 200000000ULL /* 200 ms. */
+#define MOCK_TIMEOUT_MS 20
+#define MOCK_FAIL_OP 7 /* Set as mock_tee.fail_op. */
+
+/* The application's own handler, for the library to leave in place. */
+static void mock_app_signal(int signo)
+{
+	(void)signo;
+}
+
+static void mock_app_signal_set(int signo)
+{
+	struct sigaction sa = { 0 };
+
+	sa.sa_handler = mock_app_signal;
+	sigemptyset(&sa.sa_mask);
+	sigaction(signo, &sa, NULL);
+}
+
+/* Check whether signo has the application's handler. */
+static int mock_app_signal_is_set(int signo)
+{
+	struct sigaction sa;
+
+	return !sigaction(signo, NULL, &sa) && sa.sa_handler == mock_app_signal;
+}
+
+/* Wait for QTEE to finish what the library has given up on. */
+static void mock_wait_slow(void)
+{
+	uint64_t start = test_time_ns();
+
+	while (test_time_ns() - start < 2 * MOCK_SLOW_NS)
+		sched_yield();
+}
+
+static void mock_root_released(void *arg)
+{
+	atomic_store((atomic_int *)arg, 1);
+}
+
+/* The caller drops what it passed at the deadline; QTEE still uses it. */
+static int mock_timeout_leave(void)
+{
+	struct qcomtee_object *root, *mem;
+	struct qcomtee_param params[1];
+	qcomtee_result_t result;
+	atomic_int released;
+	int ret = -1;
+
+	atomic_init(&released, 0);
+	root = mock_get_root_release(mock_root_released, &released);
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	if (qcomtee_memory_object_alloc(4096, root, &mem)) {
+		qcomtee_object_refs_dec(root);
+		return -1;
+	}
+
+	mock_tee.invoke_delay_ns = MOCK_SLOW_NS;
+	params[0].attr = QCOMTEE_OBJREF_INPUT;
+	params[0].object = mem;
+	if (qcomtee_object_invoke_timeout(root, 0, params, 1, &result,
+					  MOCK_TIMEOUT_MS) ||
+	    result != (qcomtee_result_t)QCOMTEE_ERROR_TIMEOUT)
+		MSG_ERROR("Expected QCOMTEE_ERROR_TIMEOUT, result %d\n",
+			  result);
+	else
+		ret = 0;
+
+	qcomtee_memory_object_release(mem);
+	qcomtee_object_refs_dec(root);
+
+	if (!ret && atomic_load(&released)) {
+		MSG_ERROR("Root released while QTEE still uses it\n");
+		ret = -1;
+	}
+
+	mock_wait_slow();
+	if (!ret && !atomic_load(&released)) {
+		MSG_ERROR("Root not released after the invocation\n");
+		ret = -1;
+	}
+
+	return ret;
+}
+
+/* A slow invocation returns at the deadline and leaves the buffer alone. */
+static int test_invoke_timeout(void)
+{
+	struct qcomtee_object *root;
+	struct qcomtee_param params[1];
+	qcomtee_result_t result;
+	uint64_t data, start, elapsed;
+	int ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	mock_tee.invoke_delay_ns = MOCK_SLOW_NS;
+
+	data = 0;
+	params[0].attr = QCOMTEE_UBUF_OUTPUT;
+	params[0].ubuf = UBUF_INIT(&data);
+
+	start = test_time_ns();
+	if (qcomtee_object_invoke_timeout(root, 0, params, 1, &result,
+					  MOCK_TIMEOUT_MS)) {
+		MSG_ERROR("Invocation failed\n");
+		goto dec_root_object;
+	}
+	elapsed = test_time_ns() - start;
+
+	if (result != (qcomtee_result_t)QCOMTEE_ERROR_TIMEOUT) {
+		MSG_ERROR("Expected QCOMTEE_ERROR_TIMEOUT, result %d\n",
+			  result);
+		goto dec_root_object;
+	}
+
+	if (elapsed >= MOCK_SLOW_NS / 2) {
+		MSG_ERROR("Returned after %lu ns\n", elapsed);
+		goto dec_root_object;
+	}
+
+	/* There is no cancellation ID to give QTEE. */
+	if (atomic_load(&mock_tee.cancels)) {
+		MSG_ERROR("TEE_IOC_CANCEL issued\n");
+		goto dec_root_object;
+	}
+
+	mock_wait_slow();
+	if (data != 0) {
+		MSG_ERROR("Buffer updated after the deadline\n");
+		goto dec_root_object;
+	}
+
+	/* Now one that completes in time. */
+	mock_tee.invoke_delay_ns = 0;
+	if (qcomtee_object_invoke_timeout(root, 0, params, 1, &result,
+					  1000) ||
+	    result != QCOMTEE_OK) {
+		MSG_ERROR("Invocation failed, result %d\n", result);
+		goto dec_root_object;
+	}
+
+	if (params[0].ubuf.size != sizeof(data) ||
+	    data != 0x0101010101010101ULL * MOCK_UBUF_PATTERN) {
+		MSG_ERROR("Output buffer not copied back\n");
+		goto dec_root_object;
+	}
+
+	if (mock_timeout_leave())
+		goto dec_root_object;
+
+	ret = 0;
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+/* Timed out invocations left in QTEE are bounded; the rest are refused. */
+static int test_invoke_timeout_busy(void)
+{
+	struct qcomtee_object *root;
+	qcomtee_result_t result;
+	int i, ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	/* All of them are still in QTEE by the end of the loop. */
+	mock_tee.invoke_delay_ns = MOCK_SLOW_NS;
+	for (i = 0; i < QCOMTEE_INVOKE_TIMEOUT_PENDING_MAX; i++) {
+		if (qcomtee_object_invoke_timeout(root, 0, NULL, 0, &result,
+						  1) ||
+		    result != (qcomtee_result_t)QCOMTEE_ERROR_TIMEOUT) {
+			MSG_ERROR("Invocation %d: result %d\n", i, result);
+			goto wait_slow;
+		}
+	}
+
+	if (qcomtee_object_invoke_timeout(root, 0, NULL, 0, &result,
+					  MOCK_TIMEOUT_MS) ||
+	    result != (qcomtee_result_t)QCOMTEE_ERROR_BUSY ||
+	    atomic_load(&mock_tee.invokes) >
+		    QCOMTEE_INVOKE_TIMEOUT_PENDING_MAX) {
+		MSG_ERROR("Expected QCOMTEE_ERROR_BUSY, result %d\n", result);
+		goto wait_slow;
+	}
+
+	ret = 0;
+wait_slow:
+	mock_wait_slow();
+
+	/* Once QTEE returns, timed invocations are accepted again. */
+	mock_tee.invoke_delay_ns = 0;
+	if (!ret && (qcomtee_object_invoke_timeout(root, 0, NULL, 0, &result,
+						   1000) ||
+		     result != QCOMTEE_OK)) {
+		MSG_ERROR("Invocation refused after QTEE returned, result %d\n",
+			  result);
+		ret = -1;
+	}
+
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+/* More than the worker pool can take; the tail is still queued. */
+#define MOCK_ASYNC_NUM 72
+#define MOCK_ASYNC_QUEUED 8
+
+/* Queued invocations are aborted; running ones are left to QTEE. */
+static int test_invoke_cancel(void)
+{
+	struct qcomtee_invoke_async asyncs[MOCK_ASYNC_NUM];
+	struct qcomtee_object *root;
+	int i, n, ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	mock_tee.invoke_delay_ns = MOCK_SLOW_NS;
+
+	for (n = 0; n < MOCK_ASYNC_NUM; n++) {
+		asyncs[n] = QCOMTEE_INVOKE_ASYNC_INIT(root, 0, NULL, 0);
+		if (qcomtee_object_invoke_async(&asyncs[n])) {
+			MSG_ERROR("Unable to queue invocation\n");
+			goto wait_asyncs;
+		}
+	}
+
+	for (i = MOCK_ASYNC_NUM - 1; i >= MOCK_ASYNC_NUM - MOCK_ASYNC_QUEUED;
+	     i--) {
+		if (qcomtee_object_invoke_cancel(&asyncs[i])) {
+			MSG_ERROR("Invocation %d already started\n", i);
+			goto wait_asyncs;
+		}
+
+		if (!atomic_load(&asyncs[i].done) ||
+		    asyncs[i].result != (qcomtee_result_t)QCOMTEE_ERROR_ABORT) {
+			MSG_ERROR("Invocation %d not aborted\n", i);
+			goto wait_asyncs;
+		}
+	}
+
+	/* The first one is surely with QTEE; it runs to completion. */
+	if (!qcomtee_object_invoke_cancel(&asyncs[0]) ||
+	    atomic_load(&mock_tee.cancels)) {
+		MSG_ERROR("Invocation in progress cancelled\n");
+		goto wait_asyncs;
+	}
+
+	ret = 0;
+wait_asyncs:
+	for (i = 0; i < n; i++) {
+		while (!atomic_load(&asyncs[i].done))
+			sched_yield();
+	}
+
+	if (!ret && asyncs[0].result != QCOMTEE_OK) {
+		MSG_ERROR("Invocation in progress failed\n");
+		ret = -1;
+	}
+
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+/* A uint64_t output buffer filled by the mock QTEE. */
+#define MOCK_UBUF_WORD (0x0101010101010101ULL * MOCK_UBUF_PATTERN)
+
+/* A prepared invocation returns output buffers and objects on each call. */
+static int test_invoke_prepared(void)
+{
+	struct qcomtee_invoke_prepared *prepared, *failing = NULL;
+	struct qcomtee_object *root, *mem, *objects[2];
+	struct qcomtee_param params[4];
+	qcomtee_result_t result;
+	uint64_t in, out;
+	int n = 0, ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	if (qcomtee_memory_object_alloc(4096, root, &mem))
+		goto dec_root_object;
+
+	params[0].attr = QCOMTEE_UBUF_INPUT;
+	params[1].attr = QCOMTEE_UBUF_OUTPUT;
+	params[2].attr = QCOMTEE_OBJREF_INPUT;
+	params[3].attr = QCOMTEE_OBJREF_OUTPUT;
+	prepared = qcomtee_object_invoke_prepare(root, 0, params, 4);
+	if (!prepared) {
+		MSG_ERROR("Unable to prepare invocation\n");
+		goto release_mem;
+	}
+
+	while (n < 2) {
+		in = n;
+		out = 0;
+		params[0].ubuf = UBUF_INIT(&in);
+		params[1].ubuf = UBUF_INIT(&out);
+		params[2].object = mem;
+		params[3].object = QCOMTEE_OBJECT_NULL;
+		if (qcomtee_object_invoke_exec(prepared, params, &result) ||
+		    result != QCOMTEE_OK) {
+			MSG_ERROR("Invocation %d failed, result %d\n", n,
+				  result);
+			goto release_objects;
+		}
+
+		objects[n++] = params[3].object;
+		if (params[1].ubuf.size != sizeof(out) ||
+		    out != MOCK_UBUF_WORD ||
+		    qcomtee_object_typeof(objects[n - 1]) !=
+			    QCOMTEE_OBJECT_TYPE_TEE) {
+			MSG_ERROR("Invocation %d returned wrong output\n",
+				  n - 1);
+			goto release_objects;
+		}
+	}
+
+	if (objects[0]->tee_object_id == objects[1]->tee_object_id) {
+		MSG_ERROR("Same object returned twice\n");
+		goto release_objects;
+	}
+
+	/* QTEE fails it; nothing is returned. */
+	mock_tee.fail_op = MOCK_FAIL_OP;
+	failing = qcomtee_object_invoke_prepare(root, MOCK_FAIL_OP, params, 4);
+	if (!failing) {
+		MSG_ERROR("Unable to prepare invocation\n");
+		goto release_objects;
+	}
+
+	out = 0;
+	params[3].object = QCOMTEE_OBJECT_NULL;
+	if (qcomtee_object_invoke_exec(failing, params, &result) ||
+	    result != QCOMTEE_ERROR_INVALID || out ||
+	    params[3].object != QCOMTEE_OBJECT_NULL) {
+		MSG_ERROR("Failed invocation returned output, result %d\n",
+			  result);
+		goto release_objects;
+	}
+
+	ret = 0;
+release_objects:
+	while (n--)
+		qcomtee_object_refs_dec(objects[n]);
+	qcomtee_object_invoke_prepared_release(failing);
+	qcomtee_object_invoke_prepared_release(prepared);
+release_mem:
+	qcomtee_memory_object_release(mem);
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+#define MOCK_BATCH_NUM 8
+#define MOCK_BATCH_BADOBJ 5 /* This entry invokes a memory object. */
+
+/* Each entry of a batch reports its own outcome. */
+static int test_invoke_batch(void)
+{
+	struct qcomtee_invoke_desc descs[MOCK_BATCH_NUM];
+	struct qcomtee_param params[MOCK_BATCH_NUM][1];
+	uint64_t out[MOCK_BATCH_NUM];
+	struct qcomtee_object *root, *mem;
+	int i, ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	if (qcomtee_memory_object_alloc(4096, root, &mem))
+		goto dec_root_object;
+
+	/* Odd entries fail in QTEE; one cannot be invoked at all. */
+	mock_tee.fail_op = MOCK_FAIL_OP;
+	for (i = 0; i < MOCK_BATCH_NUM; i++) {
+		out[i] = 0;
+		params[i][0].attr = QCOMTEE_UBUF_OUTPUT;
+		params[i][0].ubuf = UBUF_INIT(&out[i]);
+		descs[i].object = i == MOCK_BATCH_BADOBJ ? mem : root;
+		descs[i].op = (i & 1) ? MOCK_FAIL_OP : 0;
+		descs[i].params = params[i];
+		descs[i].num_params = 1;
+	}
+
+	if (!qcomtee_object_invoke_batch(descs, MOCK_BATCH_NUM)) {
+		MSG_ERROR("Batch succeeded with a bad entry\n");
+		goto release_mem;
+	}
+
+	for (i = 0; i < MOCK_BATCH_NUM; i++) {
+		if (i == MOCK_BATCH_BADOBJ) {
+			if (descs[i].ret != -1 || out[i])
+				break;
+		} else if (i & 1) {
+			if (descs[i].ret ||
+			    descs[i].result != QCOMTEE_ERROR_INVALID || out[i])
+				break;
+		} else if (descs[i].ret || descs[i].result != QCOMTEE_OK ||
+			   out[i] != MOCK_UBUF_WORD) {
+			break;
+		}
+	}
+
+	if (i < MOCK_BATCH_NUM) {
+		MSG_ERROR("Entry %d: ret %d, result %d\n", i, descs[i].ret,
+			  descs[i].result);
+		goto release_mem;
+	}
+
+	if (atomic_load(&mock_tee.invokes) != MOCK_BATCH_NUM - 1) {
+		MSG_ERROR("%lu invocations reached QTEE\n",
+			  atomic_load(&mock_tee.invokes));
+		goto release_mem;
+	}
+
+	/* Without the bad entries, the batch succeeds. */
+	for (i = 0; i < MOCK_BATCH_NUM; i++) {
+		descs[i].object = root;
+		descs[i].op = 0;
+	}
+
+	if (qcomtee_object_invoke_batch(descs, MOCK_BATCH_NUM)) {
+		MSG_ERROR("Batch failed\n");
+		goto release_mem;
+	}
+
+	ret = 0;
+release_mem:
+	qcomtee_memory_object_release(mem);
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+#define MOCK_ASYNC_DELAY_NS 1000000ULL /* 1 ms. */
+
+static void mock_async_complete(struct qcomtee_invoke_async *async)
+{
+	/* done is not set for an invocation with a callback. */
+	if (!atomic_load(&async->done))
+		atomic_fetch_add((atomic_int *)async->arg, 1);
+}
+
+/* Completions are reported by callback, on a file, and by done. */
+static int test_invoke_async(void)
+{
+	struct qcomtee_invoke_async asyncs[3];
+	struct qcomtee_param params[3][1];
+	struct pollfd pfd = { .events = POLLIN };
+	struct qcomtee_object *root;
+	atomic_int completed;
+	uint64_t out[3], value, start;
+	int i, n, ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	pfd.fd = eventfd(0, EFD_CLOEXEC);
+	if (pfd.fd < 0)
+		goto dec_root_object;
+
+	mock_tee.invoke_delay_ns = MOCK_ASYNC_DELAY_NS;
+	mock_tee.fail_op = MOCK_FAIL_OP;
+	atomic_init(&completed, 0);
+	for (i = 0; i < 3; i++) {
+		out[i] = 0;
+		params[i][0].attr = QCOMTEE_UBUF_OUTPUT;
+		params[i][0].ubuf = UBUF_INIT(&out[i]);
+		/* The last one fails in QTEE; it reports only by done. */
+		asyncs[i] = QCOMTEE_INVOKE_ASYNC_INIT(
+			root, i == 2 ? MOCK_FAIL_OP : 0, params[i], 1);
+	}
+
+	asyncs[0].complete = mock_async_complete;
+	asyncs[0].arg = &completed;
+	asyncs[1].fd = pfd.fd;
+
+	for (n = 0; n < 3; n++) {
+		if (qcomtee_object_invoke_async(&asyncs[n])) {
+			MSG_ERROR("Unable to queue invocation %d\n", n);
+			goto wait_asyncs;
+		}
+	}
+
+	start = test_time_ns();
+	while (atomic_load(&completed) != 1 &&
+	       test_time_ns() - start < MOCK_SLOW_NS)
+		sched_yield();
+
+	if (atomic_load(&completed) != 1) {
+		MSG_ERROR("Callback not called\n");
+		goto wait_asyncs;
+	}
+
+	if (poll(&pfd, 1, MOCK_SLOW_NS / 1000000) != 1 ||
+	    read(pfd.fd, &value, sizeof(value)) != sizeof(value) ||
+	    value != 1 || !atomic_load(&asyncs[1].done)) {
+		MSG_ERROR("Completion not reported on the file\n");
+		goto wait_asyncs;
+	}
+
+	start = test_time_ns();
+	while (!atomic_load(&asyncs[2].done) &&
+	       test_time_ns() - start < MOCK_SLOW_NS)
+		sched_yield();
+
+	if (!atomic_load(&asyncs[2].done)) {
+		MSG_ERROR("Invocation not done\n");
+		goto wait_asyncs;
+	}
+
+	for (i = 0; i < 3; i++) {
+		if (asyncs[i].ret ||
+		    asyncs[i].result != (i == 2 ? QCOMTEE_ERROR_INVALID :
+						  QCOMTEE_OK) ||
+		    out[i] != (i == 2 ? 0 : MOCK_UBUF_WORD)) {
+			MSG_ERROR("Invocation %d: ret %d, result %d\n", i,
+				  asyncs[i].ret, asyncs[i].result);
+			goto wait_asyncs;
+		}
+	}
+
+	ret = 0;
+wait_asyncs:
+	for (i = 0; i < n; i++) {
+		while (!atomic_load(asyncs[i].complete ? &completed :
+							  &asyncs[i].done))
+			sched_yield();
+	}
+
+	close(pfd.fd);
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+#define MOCK_BLOB_SIZE 100
+
+struct mock_blob {
+	struct qcomtee_object object;
+	char data[MOCK_BLOB_SIZE];
+};
+
+static qcomtee_result_t mock_blob_get_length(struct qcomtee_object *object,
+					     uint64_t *len)
+{
+	(void)object;
+	*len = MOCK_BLOB_SIZE;
+
+	return QCOMTEE_OK;
+}
+
+static qcomtee_result_t mock_blob_read_at_offset(struct qcomtee_object *object,
+						 uint64_t offset, void **data,
+						 size_t *data_len)
+{
+	struct mock_blob *blob = container_of(object, struct mock_blob, object);
+
+	if (offset >= MOCK_BLOB_SIZE)
+		return QCOMTEE_ERROR_INVALID;
+
+	*data = &blob->data[offset];
+	if (*data_len > MOCK_BLOB_SIZE - offset)
+		*data_len = MOCK_BLOB_SIZE - offset;
+
+	return QCOMTEE_OK;
+}
+
+static const struct IIO_skel_ops mock_blob_iio = {
+	.getLength = mock_blob_get_length,
+	.readAtOffset = mock_blob_read_at_offset,
+};
+
+static qcomtee_result_t mock_blob_dispatch(struct qcomtee_object *object,
+					   qcomtee_op_t op,
+					   struct qcomtee_param *params, int num)
+{
+	return IIO_dispatch(&mock_blob_iio, object, op, params, num);
+}
+
+static struct qcomtee_object_ops mock_blob_ops = {
+	.dispatch = mock_blob_dispatch,
+};
+
+/* Generated stubs and skeletons lay out parameters as QTEE expects. */
+static int test_idl(void)
+{
+	struct qcomtee_param params[2];
+	struct qcomtee_object *root;
+	struct mock_blob blob;
+	qcomtee_result_t result;
+	uint64_t offset = 90;
+	char buf[16];
+	size_t len;
+	int ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	qcomtee_object_cb_init(&blob.object, &mock_blob_ops, root);
+
+	/* What QTEE sends for IIO_OP_getLength. */
+	params[0].attr = QCOMTEE_UBUF_OUTPUT;
+	params[0].ubuf = (struct qcomtee_ubuf){ NULL, sizeof(uint64_t) };
+	result = blob.object.ops->dispatch(&blob.object, IIO_OP_getLength,
+					   params, 1);
+	if (result != QCOMTEE_OK ||
+	    params[0].ubuf.size != sizeof(uint64_t) ||
+	    *(uint64_t *)params[0].ubuf.addr != MOCK_BLOB_SIZE) {
+		MSG_ERROR("getLength failed, result %d\n", result);
+		goto dec_root_object;
+	}
+
+	/* What QTEE sends for IIO_OP_readAtOffset. */
+	params[0].attr = QCOMTEE_UBUF_INPUT;
+	params[0].ubuf = UBUF_INIT(&offset);
+	params[1].attr = QCOMTEE_UBUF_OUTPUT;
+	params[1].ubuf = (struct qcomtee_ubuf){ NULL, 64 };
+	result = blob.object.ops->dispatch(&blob.object, IIO_OP_readAtOffset,
+					   params, 2);
+	if (result != QCOMTEE_OK || params[1].ubuf.addr != &blob.data[90] ||
+	    params[1].ubuf.size != MOCK_BLOB_SIZE - 90) {
+		MSG_ERROR("readAtOffset failed, result %d\n", result);
+		goto dec_root_object;
+	}
+
+	/* Unknown operations and malformed requests are rejected. */
+	if (blob.object.ops->dispatch(&blob.object, 7, params, 2) !=
+		    QCOMTEE_ERROR_INVALID ||
+	    blob.object.ops->dispatch(&blob.object, IIO_OP_readAtOffset,
+				      params, 1) != QCOMTEE_ERROR_INVALID) {
+		MSG_ERROR("Invalid requests accepted\n");
+		goto dec_root_object;
+	}
+
+	/* The mock QTEE fills output buffers. */
+	if (IIO_readAtOffset(root, 0, buf, sizeof(buf), &len, &result) ||
+	    result != QCOMTEE_OK || len != sizeof(buf) ||
+	    buf[0] != (char)MOCK_UBUF_PATTERN) {
+		MSG_ERROR("IIO_readAtOffset failed, result %d\n", result);
+		goto dec_root_object;
+	}
+
+	ret = 0;
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+#define MOCK_SUPPLICANT_THREADS 4
+#define MOCK_SUPPLICANT_REQUESTS 64
+#define MOCK_WORK_NS 1000000ULL /* 1 ms. */
+
+/* Requests are dispatched in parallel; stop wakes idle threads. */
+static int test_supplicant(void)
+{
+	struct mock_tee_stream stream;
+	struct qcomtee_supplicant *sup;
+	struct mock_cb_object cb;
+	struct qcomtee_object *root;
+	uint64_t start;
+	int ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	if (mock_cb_export(root, &cb, MOCK_WORK_NS, 0))
+		goto dec_root_object;
+
+	stream.req = (struct mock_tee_request){
+		.object_id = cb.object.tee_object_id,
+	};
+	atomic_init(&stream.count, MOCK_SUPPLICANT_REQUESTS);
+	mock_tee.recv = mock_tee_stream_recv;
+	mock_tee.arg = &stream;
+
+	mock_app_signal_set(SIGRTMIN);
+	sup = qcomtee_supplicant_start(root, MOCK_SUPPLICANT_THREADS, NULL);
+	if (!sup) {
+		MSG_ERROR("Unable to start supplicant\n");
+		goto release_cb;
+	}
+
+	start = test_time_ns();
+	while (atomic_load(&mock_tee.sends) < MOCK_SUPPLICANT_REQUESTS &&
+	       test_time_ns() - start < 2 * MOCK_SLOW_NS)
+		sched_yield();
+
+	/* Every thread is now waiting for a request that never comes. */
+	start = test_time_ns();
+	qcomtee_supplicant_stop(sup);
+	if (test_time_ns() - start >= MOCK_SLOW_NS) {
+		MSG_ERROR("Stop took %lu ns\n", test_time_ns() - start);
+		goto release_cb;
+	}
+
+	if (!mock_app_signal_is_set(SIGRTMIN)) {
+		MSG_ERROR("Signal handler not restored\n");
+		goto release_cb;
+	}
+
+	if (atomic_load(&mock_tee.sends) != MOCK_SUPPLICANT_REQUESTS ||
+	    atomic_load(&mock_tee.errors)) {
+		MSG_ERROR("%lu responses, %lu errors\n",
+			  atomic_load(&mock_tee.sends),
+			  atomic_load(&mock_tee.errors));
+		goto release_cb;
+	}
+
+	if (atomic_load(&cb.active_max) < 2) {
+		MSG_ERROR("Requests were not dispatched in parallel\n");
+		goto release_cb;
+	}
+
+	ret = 0;
+release_cb:
+	mock_cb_release(root, &cb);
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+/* A reader hands slow requests over to dispatchers it starts. */
+static int test_supplicant_readers(void)
+{
+	struct qcomtee_supplicant_opts opts = {
+		.max_threads = 8,
+		.readers = 1,
+	};
+	struct qcomtee_supplicant_stats stats;
+	struct mock_tee_stream stream;
+	struct qcomtee_supplicant *sup;
+	struct mock_cb_object cb;
+	struct qcomtee_object *root;
+	uint64_t start;
+	int ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	if (mock_cb_export(root, &cb, MOCK_WORK_NS, 0))
+		goto dec_root_object;
+
+	stream.req = (struct mock_tee_request){
+		.object_id = cb.object.tee_object_id,
+	};
+	atomic_init(&stream.count, MOCK_SUPPLICANT_REQUESTS);
+	mock_tee.recv = mock_tee_stream_recv;
+	mock_tee.arg = &stream;
+
+	sup = qcomtee_supplicant_start(root, 1, &opts);
+	if (!sup) {
+		MSG_ERROR("Unable to start supplicant\n");
+		goto release_cb;
+	}
+
+	start = test_time_ns();
+	while (atomic_load(&mock_tee.sends) < MOCK_SUPPLICANT_REQUESTS &&
+	       test_time_ns() - start < 2 * MOCK_SLOW_NS)
+		sched_yield();
+
+	qcomtee_supplicant_get_stats(sup, &stats);
+	qcomtee_supplicant_stop(sup);
+
+	if (atomic_load(&mock_tee.sends) != MOCK_SUPPLICANT_REQUESTS ||
+	    atomic_load(&mock_tee.errors)) {
+		MSG_ERROR("%lu responses, %lu errors\n",
+			  atomic_load(&mock_tee.sends),
+			  atomic_load(&mock_tee.errors));
+		goto release_cb;
+	}
+
+	if (stats.started < 2 || atomic_load(&cb.active_max) < 2) {
+		MSG_ERROR("%lu dispatchers, %d requests at once\n",
+			  stats.started, atomic_load(&cb.active_max));
+		goto release_cb;
+	}
+
+	ret = 0;
+release_cb:
+	mock_cb_release(root, &cb);
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+#define MOCK_LINGER_MS 20
+
+/* The first request waits for the second, like a nested callback. */
+static atomic_int mock_nested_calls;
+
+static qcomtee_result_t mock_nested_dispatch(struct qcomtee_object *object,
+					     qcomtee_op_t op,
+					     struct qcomtee_param *params,
+					     int num)
+{
+	uint64_t start = test_time_ns();
+
+	(void)object;
+	(void)op;
+	(void)params;
+	(void)num;
+
+	if (atomic_fetch_add(&mock_nested_calls, 1))
+		return QCOMTEE_OK;
+
+	while (atomic_load(&mock_nested_calls) < 2) {
+		if (test_time_ns() - start >= MOCK_SLOW_NS)
+			return QCOMTEE_ERROR_TIMEOUT;
+
+		sched_yield();
+	}
+
+	return QCOMTEE_OK;
+}
+
+static struct qcomtee_object_ops mock_nested_ops = {
+	.dispatch = mock_nested_dispatch,
+};
+
+/* A single thread grows for a nested request, then shrinks back. */
+static int test_supplicant_elastic(void)
+{
+	struct qcomtee_supplicant_opts opts = {
+		.max_threads = 4,
+		.linger_ms = MOCK_LINGER_MS,
+	};
+	struct qcomtee_supplicant_stats stats;
+	struct mock_tee_stream stream;
+	struct qcomtee_supplicant *sup;
+	struct qcomtee_param params[1];
+	struct qcomtee_object *root;
+	struct qcomtee_object object;
+	qcomtee_result_t result;
+	uint64_t start;
+	int ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	atomic_store(&mock_nested_calls, 0);
+	qcomtee_object_cb_init(&object, &mock_nested_ops, root);
+	params[0].attr = QCOMTEE_OBJREF_INPUT;
+	params[0].object = &object;
+	if (qcomtee_object_invoke(root, 0, params, 1, &result) ||
+	    result != QCOMTEE_OK) {
+		MSG_ERROR("Unable to export object, result %d\n", result);
+		goto dec_root_object;
+	}
+
+	stream.req = (struct mock_tee_request){
+		.object_id = object.tee_object_id,
+	};
+	atomic_init(&stream.count, 2);
+	mock_tee.recv = mock_tee_stream_recv;
+	mock_tee.arg = &stream;
+
+	sup = qcomtee_supplicant_start(root, 1, &opts);
+	if (!sup) {
+		MSG_ERROR("Unable to start supplicant\n");
+		goto release_object;
+	}
+
+	start = test_time_ns();
+	while (atomic_load(&mock_tee.sends) < 2 &&
+	       test_time_ns() - start < 2 * MOCK_SLOW_NS)
+		sched_yield();
+
+	if (atomic_load(&mock_tee.sends) != 2 ||
+	    atomic_load(&mock_tee.errors)) {
+		MSG_ERROR("Nested request not served\n");
+		goto stop_supplicant;
+	}
+
+	qcomtee_supplicant_get_stats(sup, &stats);
+	if (stats.started < 2) {
+		MSG_ERROR("No thread started for the nested request\n");
+		goto stop_supplicant;
+	}
+
+	/* Extra threads exit after lingering. */
+	start = test_time_ns();
+	do {
+		sched_yield();
+		qcomtee_supplicant_get_stats(sup, &stats);
+	} while (stats.threads > 1 && test_time_ns() - start < MOCK_SLOW_NS);
+
+	if (stats.threads != 1 || stats.receiving != 1 || !stats.retired) {
+		MSG_ERROR("%d threads, %d receiving, %lu retired\n",
+			  stats.threads, stats.receiving, stats.retired);
+		goto stop_supplicant;
+	}
+
+	ret = 0;
+stop_supplicant:
+	qcomtee_supplicant_stop(sup);
+release_object:
+	stream.req.op = QCOMTEE_OBJREF_OP_RELEASE;
+	atomic_store(&stream.count, 1);
+	qcomtee_object_process_one(root);
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+#define MOCK_LARGE_UBUFS 32
+#define MOCK_LARGE_UBUF_SIZE 2048 /* 64 KiB in total. */
+#define MOCK_LARGE_REQUESTS 8
+
+/* Requests that passed the checks in mock_large_dispatch. */
+static atomic_int mock_large_good;
+
+static qcomtee_result_t mock_large_dispatch(struct qcomtee_object *object,
+					    qcomtee_op_t op,
+					    struct qcomtee_param *params,
+					    int num)
+{
+	const char *data;
+	int i;
+
+	(void)object;
+	(void)op;
+
+	if (num != MOCK_LARGE_UBUFS)
+		return QCOMTEE_ERROR_INVALID;
+
+	for (i = 0; i < num; i++) {
+		data = params[i].ubuf.addr;
+		if (params[i].attr != QCOMTEE_UBUF_INPUT ||
+		    params[i].ubuf.size != MOCK_LARGE_UBUF_SIZE ||
+		    data[0] != (char)MOCK_UBUF_PATTERN ||
+		    data[MOCK_LARGE_UBUF_SIZE - 1] != (char)MOCK_UBUF_PATTERN)
+			return QCOMTEE_ERROR_INVALID;
+	}
+
+	atomic_fetch_add(&mock_large_good, 1);
+
+	return QCOMTEE_OK;
+}
+
+static struct qcomtee_object_ops mock_large_ops = {
+	.dispatch = mock_large_dispatch,
+};
+
+static int mock_einval_recv(struct mock_tee_request *req, void *arg)
+{
+	(void)req;
+
+	atomic_fetch_add((atomic_int *)arg, 1);
+	errno = EINVAL;
+
+	return -1;
+}
+
+/* Requests larger than the initial dispatch buffers are received whole. */
+static int test_dispatch_large(void)
+{
+	struct qcomtee_supplicant_opts opts = { .readers = 1 };
+	struct mock_tee_stream stream;
+	struct qcomtee_supplicant *sup;
+	struct qcomtee_param params[1];
+	struct qcomtee_object *root;
+	struct qcomtee_object object;
+	qcomtee_result_t result;
+	atomic_int calls;
+	uint64_t start;
+	int ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	/* Only a request that does not fit grows the buffers. */
+	atomic_init(&calls, 0);
+	mock_tee.recv = mock_einval_recv;
+	mock_tee.arg = &calls;
+	if (!qcomtee_object_process_one(root) || errno != EINVAL ||
+	    atomic_load(&calls) != 1) {
+		MSG_ERROR("EINVAL retried %d times\n", atomic_load(&calls) - 1);
+		goto dec_root_object;
+	}
+
+	atomic_store(&mock_large_good, 0);
+	qcomtee_object_cb_init(&object, &mock_large_ops, root);
+	params[0].attr = QCOMTEE_OBJREF_INPUT;
+	params[0].object = &object;
+	if (qcomtee_object_invoke(root, 0, params, 1, &result) ||
+	    result != QCOMTEE_OK) {
+		MSG_ERROR("Unable to export object, result %d\n", result);
+		goto dec_root_object;
+	}
+
+	stream.req = (struct mock_tee_request){
+		.object_id = object.tee_object_id,
+		.num_ubufs = MOCK_LARGE_UBUFS,
+		.ubuf_size = MOCK_LARGE_UBUF_SIZE,
+	};
+	atomic_init(&stream.count, 1);
+	mock_tee.recv = mock_tee_stream_recv;
+	mock_tee.arg = &stream;
+
+	/* The calling thread as supplicant. */
+	if (qcomtee_object_process_one(root) ||
+	    atomic_load(&mock_large_good) != 1) {
+		MSG_ERROR("Large request not served\n");
+		goto release_object;
+	}
+
+	/* Requests handed over by a reader. */
+	atomic_store(&stream.count, MOCK_LARGE_REQUESTS);
+	sup = qcomtee_supplicant_start(root, 2, &opts);
+	if (!sup) {
+		MSG_ERROR("Unable to start supplicant\n");
+		goto release_object;
+	}
+
+	start = test_time_ns();
+	while (atomic_load(&mock_tee.sends) < MOCK_LARGE_REQUESTS + 1 &&
+	       test_time_ns() - start < MOCK_SLOW_NS)
+		sched_yield();
+
+	qcomtee_supplicant_stop(sup);
+
+	if (atomic_load(&mock_large_good) != MOCK_LARGE_REQUESTS + 1 ||
+	    atomic_load(&mock_tee.errors)) {
+		MSG_ERROR("%d of %d large requests served\n",
+			  atomic_load(&mock_large_good),
+			  MOCK_LARGE_REQUESTS + 1);
+		goto release_object;
+	}
+
+	ret = 0;
+release_object:
+	stream.req.op = QCOMTEE_OBJREF_OP_RELEASE;
+	stream.req.num_ubufs = 0;
+	atomic_store(&stream.count, 1);
+	qcomtee_object_process_one(root);
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+#define MOCK_STRAND_OBJECTS 3
+#define MOCK_STRAND_REQUESTS 96
+
+/* Requests go round robin to the objects. */
+struct mock_strand_stream {
+	struct qcomtee_object *objects[MOCK_STRAND_OBJECTS];
+	atomic_long count;
+};
+
+static int mock_strand_recv(struct mock_tee_request *req, void *arg)
+{
+	struct mock_strand_stream *stream = arg;
+	struct mock_tee_stream idle = { { 0 }, 0 };
+	long n;
+
+	n = atomic_fetch_sub(&stream->count, 1);
+	if (n > 0) {
+		*req = (struct mock_tee_request){
+			.object_id = stream->objects[n % MOCK_STRAND_OBJECTS]
+					     ->tee_object_id,
+		};
+		return 0;
+	}
+
+	/* Nothing left; wait for a signal. */
+	return mock_tee_stream_recv(req, &idle);
+}
+
+/* Calls to the same object are serialized, except for reentrant objects. */
+static int test_strands(void)
+{
+	struct mock_cb_object cb[MOCK_STRAND_OBJECTS];
+	struct mock_strand_stream stream;
+	struct qcomtee_supplicant *sup;
+	struct qcomtee_object *root;
+	uint64_t start;
+	int i, n, ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	if (qcomtee_object_root_strands_init(root)) {
+		MSG_ERROR("Unable to enable strands\n");
+		goto dec_root_object;
+	}
+
+	/* The last object is reentrant. */
+	for (n = 0; n < MOCK_STRAND_OBJECTS; n++) {
+		if (mock_cb_export(root, &cb[n], MOCK_WORK_NS,
+				   n == MOCK_STRAND_OBJECTS - 1 ?
+					   QCOMTEE_OBJECT_OPS_REENTRANT :
+					   0))
+			goto release_objects;
+
+		stream.objects[n] = &cb[n].object;
+	}
+
+	atomic_init(&stream.count, MOCK_STRAND_REQUESTS);
+	mock_tee.recv = mock_strand_recv;
+	mock_tee.arg = &stream;
+
+	sup = qcomtee_supplicant_start(root, MOCK_SUPPLICANT_THREADS, NULL);
+	if (!sup) {
+		MSG_ERROR("Unable to start supplicant\n");
+		goto release_objects;
+	}
+
+	start = test_time_ns();
+	while (atomic_load(&mock_tee.sends) < MOCK_STRAND_REQUESTS &&
+	       test_time_ns() - start < 2 * MOCK_SLOW_NS)
+		sched_yield();
+
+	qcomtee_supplicant_stop(sup);
+
+	if (atomic_load(&mock_tee.sends) != MOCK_STRAND_REQUESTS ||
+	    atomic_load(&mock_tee.errors)) {
+		MSG_ERROR("%lu of %d requests served, %lu failed\n",
+			  atomic_load(&mock_tee.sends), MOCK_STRAND_REQUESTS,
+			  atomic_load(&mock_tee.errors));
+		goto release_objects;
+	}
+
+	for (i = 0; i < MOCK_STRAND_OBJECTS - 1; i++) {
+		if (atomic_load(&cb[i].active_max) != 1) {
+			MSG_ERROR("%d concurrent calls to object %d\n",
+				  atomic_load(&cb[i].active_max), i);
+			goto release_objects;
+		}
+	}
+
+	if (atomic_load(&cb[i].active_max) < 2) {
+		MSG_ERROR("Reentrant object not called concurrently\n");
+		goto release_objects;
+	}
+
+	ret = 0;
+release_objects:
+	for (i = 0; i < n; i++)
+		mock_cb_release(root, &cb[i]);
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+/* More objects than any hash table of 64 buckets has, so IDs collide. */
+#define MOCK_STRAND_IDS 65
+#define MOCK_STRAND_BUCKETS 64
+
+/* A request to the first object, then one to the second. */
+struct mock_strand_pair {
+	struct qcomtee_object *objects[2];
+	atomic_int n;
+};
+
+static int mock_strand_pair_recv(struct mock_tee_request *req, void *arg)
+{
+	struct mock_strand_pair *pair = arg;
+	struct mock_tee_stream idle = { { 0 }, 0 };
+	int n;
+
+	n = atomic_fetch_add(&pair->n, 1);
+	if (n < 2) {
+		*req = (struct mock_tee_request){
+			.object_id = pair->objects[n]->tee_object_id,
+		};
+		return 0;
+	}
+
+	/* Nothing left; wait for a signal. */
+	return mock_tee_stream_recv(req, &idle);
+}
+
+/* A dispatcher waits for a nested call to an object with a colliding ID. */
+static int test_strands_nested(void)
+{
+	struct qcomtee_object objects[MOCK_STRAND_IDS];
+	struct mock_tee_stream stream;
+	struct mock_strand_pair pair;
+	struct qcomtee_supplicant *sup;
+	struct qcomtee_param params[1];
+	struct qcomtee_object *root;
+	qcomtee_result_t result;
+	uint64_t start;
+	int i, n, ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	if (qcomtee_object_root_strands_init(root)) {
+		MSG_ERROR("Unable to enable strands\n");
+		goto dec_root_object;
+	}
+
+	atomic_store(&mock_nested_calls, 0);
+	for (n = 0; n < MOCK_STRAND_IDS; n++) {
+		qcomtee_object_cb_init(&objects[n], &mock_nested_ops, root);
+		params[0].attr = QCOMTEE_OBJREF_INPUT;
+		params[0].object = &objects[n];
+		if (qcomtee_object_invoke(root, 0, params, 1, &result) ||
+		    result != QCOMTEE_OK) {
+			MSG_ERROR("Unable to export object, result %d\n",
+				  result);
+			goto release_objects;
+		}
+	}
+
+	for (i = 1; i < n; i++) {
+		if (objects[i].object_id % MOCK_STRAND_BUCKETS ==
+		    objects[0].object_id % MOCK_STRAND_BUCKETS)
+			break;
+	}
+
+	if (i == n) {
+		MSG_ERROR("No object ID collides\n");
+		goto release_objects;
+	}
+
+	pair.objects[0] = &objects[0];
+	pair.objects[1] = &objects[i];
+	atomic_init(&pair.n, 0);
+	mock_tee.recv = mock_strand_pair_recv;
+	mock_tee.arg = &pair;
+
+	sup = qcomtee_supplicant_start(root, 2, NULL);
+	if (!sup) {
+		MSG_ERROR("Unable to start supplicant\n");
+		goto release_objects;
+	}
+
+	start = test_time_ns();
+	while (atomic_load(&mock_tee.sends) < 2 &&
+	       test_time_ns() - start < 2 * MOCK_SLOW_NS)
+		sched_yield();
+
+	qcomtee_supplicant_stop(sup);
+
+	if (atomic_load(&mock_tee.sends) != 2 ||
+	    atomic_load(&mock_tee.errors)) {
+		MSG_ERROR("Nested call held behind object %lu\n",
+			  (unsigned long)objects[0].object_id);
+		goto release_objects;
+	}
+
+	ret = 0;
+release_objects:
+	stream.req = (struct mock_tee_request){
+		.op = QCOMTEE_OBJREF_OP_RELEASE,
+	};
+	mock_tee.recv = mock_tee_stream_recv;
+	mock_tee.arg = &stream;
+	for (i = 0; i < n; i++) {
+		stream.req.object_id = objects[i].tee_object_id;
+		atomic_store(&stream.count, 1);
+		qcomtee_object_process_one(root);
+	}
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+#define MOCK_DEFERRED_REQUESTS 32
+#define MOCK_DEFERRED_UBUF_SIZE 64
+
+/* Deferred requests, completed by the test. */
+static struct {
+	pthread_mutex_t lock;
+	struct qcomtee_deferred *tokens[MOCK_DEFERRED_REQUESTS];
+	const char *data[MOCK_DEFERRED_REQUESTS];
+	int num;
+} mock_deferred = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static qcomtee_result_t mock_deferred_dispatch(struct qcomtee_object *object,
+					       qcomtee_op_t op,
+					       struct qcomtee_param *params,
+					       int num)
+{
+	struct qcomtee_deferred *deferred;
+
+	(void)object;
+	(void)op;
+
+	if (num != 1)
+		return QCOMTEE_ERROR_INVALID;
+
+	deferred = qcomtee_object_dispatch_defer();
+	if (!deferred)
+		return QCOMTEE_ERROR_MEM;
+
+	/* The input buffer is kept until the response is sent. */
+	pthread_mutex_lock(&mock_deferred.lock);
+	mock_deferred.tokens[mock_deferred.num] = deferred;
+	mock_deferred.data[mock_deferred.num] = params[0].ubuf.addr;
+	mock_deferred.num++;
+	pthread_mutex_unlock(&mock_deferred.lock);
+
+	return QCOMTEE_ERROR;
+}
+
+static struct qcomtee_object_ops mock_deferred_ops = {
+	.dispatch = mock_deferred_dispatch,
+};
+
+/* A single supplicant thread keeps receiving while responses are pending. */
+static int test_dispatch_deferred(void)
+{
+	struct qcomtee_supplicant_opts opts = { .max_threads = 1 };
+	struct mock_tee_stream stream;
+	struct qcomtee_supplicant *sup;
+	struct qcomtee_param params[1];
+	struct qcomtee_object *root;
+	struct qcomtee_object object;
+	qcomtee_result_t result;
+	uint64_t start;
+	int i, num, ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	mock_deferred.num = 0;
+	qcomtee_object_cb_init(&object, &mock_deferred_ops, root);
+	params[0].attr = QCOMTEE_OBJREF_INPUT;
+	params[0].object = &object;
+	if (qcomtee_object_invoke(root, 0, params, 1, &result) ||
+	    result != QCOMTEE_OK) {
+		MSG_ERROR("Unable to export object, result %d\n", result);
+		goto dec_root_object;
+	}
+
+	stream.req = (struct mock_tee_request){
+		.object_id = object.tee_object_id,
+		.num_ubufs = 1,
+		.ubuf_size = MOCK_DEFERRED_UBUF_SIZE,
+	};
+	atomic_init(&stream.count, MOCK_DEFERRED_REQUESTS);
+	mock_tee.recv = mock_tee_stream_recv;
+	mock_tee.arg = &stream;
+
+	sup = qcomtee_supplicant_start(root, 1, &opts);
+	if (!sup) {
+		MSG_ERROR("Unable to start supplicant\n");
+		goto release_object;
+	}
+
+	start = test_time_ns();
+	do {
+		sched_yield();
+		pthread_mutex_lock(&mock_deferred.lock);
+		num = mock_deferred.num;
+		pthread_mutex_unlock(&mock_deferred.lock);
+	} while (num < MOCK_DEFERRED_REQUESTS &&
+		 test_time_ns() - start < MOCK_SLOW_NS);
+
+	if (num != MOCK_DEFERRED_REQUESTS || atomic_load(&mock_tee.sends)) {
+		MSG_ERROR("%d requests deferred, %lu responses sent\n", num,
+			  atomic_load(&mock_tee.sends));
+		goto complete;
+	}
+
+	ret = 0;
+complete:
+	/* Respond from this thread. */
+	for (i = 0; i < num; i++) {
+		if (mock_deferred.data[i][0] != (char)MOCK_UBUF_PATTERN ||
+		    mock_deferred.data[i][MOCK_DEFERRED_UBUF_SIZE - 1] !=
+			    (char)MOCK_UBUF_PATTERN) {
+			MSG_ERROR("Input buffer of request %d is gone\n", i);
+			ret = -1;
+		}
+
+		/* The input parameter is left as it is. */
+		params[0].attr = QCOMTEE_UBUF_INPUT;
+		if (qcomtee_object_dispatch_complete(mock_deferred.tokens[i],
+						     QCOMTEE_OK, params, 1)) {
+			MSG_ERROR("Unable to complete request %d\n", i);
+			ret = -1;
+		}
+	}
+
+	qcomtee_supplicant_stop(sup);
+
+	if (atomic_load(&mock_tee.sends) != (unsigned long)num ||
+	    atomic_load(&mock_tee.errors)) {
+		MSG_ERROR("%lu responses sent, %lu failed\n",
+			  atomic_load(&mock_tee.sends),
+			  atomic_load(&mock_tee.errors));
+		ret = -1;
+	}
+
+release_object:
+	stream.req.op = QCOMTEE_OBJREF_OP_RELEASE;
+	stream.req.num_ubufs = 0;
+	atomic_store(&stream.count, 1);
+	qcomtee_object_process_one(root);
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+#define MOCK_POLL_REQUESTS 64
+#define MOCK_POLL_SIGNO (SIGRTMIN + 1) /* Not the default. */
+
+/* Thread running the event loop; requests must be dispatched on it. */
+static pthread_t mock_poll_thread;
+static atomic_int mock_poll_calls;
+static atomic_int mock_poll_foreign;
+
+static qcomtee_result_t mock_poll_dispatch(struct qcomtee_object *object,
+					   qcomtee_op_t op,
+					   struct qcomtee_param *params,
+					   int num)
+{
+	(void)object;
+	(void)op;
+	(void)params;
+	(void)num;
+
+	if (!pthread_equal(pthread_self(), mock_poll_thread))
+		atomic_fetch_add(&mock_poll_foreign, 1);
+	atomic_fetch_add(&mock_poll_calls, 1);
+
+	return QCOMTEE_OK;
+}
+
+static struct qcomtee_object_ops mock_poll_ops = {
+	.dispatch = mock_poll_dispatch,
+};
+
+/* stream->count requests to the object; the last one is its release. */
+static int mock_release_last_recv(struct mock_tee_request *req, void *arg)
+{
+	struct mock_tee_stream *stream = arg;
+	struct mock_tee_stream idle = { { 0 }, 0 };
+	long n;
+
+	n = atomic_fetch_sub(&stream->count, 1);
+	if (n > 0) {
+		*req = stream->req;
+		if (n == 1)
+			req->op = QCOMTEE_OBJREF_OP_RELEASE;
+
+		return 0;
+	}
+
+	return mock_tee_stream_recv(req, &idle);
+}
+
+/* Wait on fd and process what is ready, until n requests are processed. */
+static int mock_poll_loop(struct qcomtee_object *root, int fd, int n)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	uint64_t start = test_time_ns();
+	int ret;
+
+	while (n > 0) {
+		if (test_time_ns() - start >= MOCK_SLOW_NS)
+			return -1;
+
+		if (poll(&pfd, 1, MOCK_SLOW_NS / 1000000) < 0)
+			return -1;
+
+		ret = qcomtee_object_process_ready(root);
+		if (ret < 0)
+			return -1;
+
+		n -= ret;
+	}
+
+	return 0;
+}
+
+/* An event loop on this thread serves the requests. */
+static int test_poll(void)
+{
+	struct mock_tee_stream stream;
+	struct qcomtee_param params[1];
+	struct qcomtee_object *root;
+	struct qcomtee_object object;
+	qcomtee_result_t result;
+	int fd, ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	mock_poll_thread = pthread_self();
+	atomic_store(&mock_poll_calls, 0);
+	atomic_store(&mock_poll_foreign, 0);
+	qcomtee_object_cb_init(&object, &mock_poll_ops, root);
+	params[0].attr = QCOMTEE_OBJREF_INPUT;
+	params[0].object = &object;
+	if (qcomtee_object_invoke(root, 0, params, 1, &result) ||
+	    result != QCOMTEE_OK) {
+		MSG_ERROR("Unable to export object, result %d\n", result);
+		goto dec_root_object;
+	}
+
+	stream.req = (struct mock_tee_request){
+		.object_id = object.tee_object_id,
+	};
+	atomic_init(&stream.count, MOCK_POLL_REQUESTS + 1);
+	mock_tee.recv = mock_release_last_recv;
+	mock_tee.arg = &stream;
+
+	if (qcomtee_object_process_ready(root) != -1) {
+		MSG_ERROR("Requests processed without a poll fd\n");
+		goto dec_root_object;
+	}
+
+	/* The reader takes the signal over until the root is released. */
+	mock_app_signal_set(MOCK_POLL_SIGNO);
+	fd = qcomtee_object_poll_fd(root, MOCK_POLL_SIGNO);
+	if (fd < 0 || qcomtee_object_poll_fd(root, 0) != fd) {
+		MSG_ERROR("Unable to get a poll fd\n");
+		goto dec_root_object;
+	}
+
+	if (mock_app_signal_is_set(MOCK_POLL_SIGNO)) {
+		MSG_ERROR("Signal handler not installed\n");
+		goto dec_root_object;
+	}
+
+	if (mock_poll_loop(root, fd, MOCK_POLL_REQUESTS + 1) ||
+	    atomic_load(&mock_poll_calls) != MOCK_POLL_REQUESTS ||
+	    atomic_load(&mock_poll_foreign) ||
+	    atomic_load(&mock_tee.sends) != MOCK_POLL_REQUESTS) {
+		MSG_ERROR("%d requests served, %d on another thread\n",
+			  atomic_load(&mock_poll_calls),
+			  atomic_load(&mock_poll_foreign));
+		goto dec_root_object;
+	}
+
+	ret = 0;
+	/* Stops the reader. */
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	if (!ret && !mock_app_signal_is_set(MOCK_POLL_SIGNO)) {
+		MSG_ERROR("Signal handler not restored\n");
+		ret = -1;
+	}
+
+	return ret;
+}
+
+#define MOCK_POLL_STALE 8
+#define MOCK_POLL_STALE_ID 1000 /* No object has it. */
+
+/* Requests still queued when the root is released are answered. */
+static int test_poll_abort(void)
+{
+	struct mock_tee_stream stream;
+	struct qcomtee_object *root;
+	uint64_t start;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	stream.req = (struct mock_tee_request){
+		.object_id = MOCK_POLL_STALE_ID,
+	};
+	atomic_init(&stream.count, MOCK_POLL_STALE);
+	mock_tee.recv = mock_tee_stream_recv;
+	mock_tee.arg = &stream;
+
+	if (qcomtee_object_poll_fd(root, 0) < 0) {
+		MSG_ERROR("Unable to get a poll fd\n");
+		qcomtee_object_refs_dec(root);
+		return -1;
+	}
+
+	start = test_time_ns();
+	while (atomic_load(&mock_tee.recvs) < MOCK_POLL_STALE &&
+	       test_time_ns() - start < MOCK_SLOW_NS)
+		sched_yield();
+
+	/* Stops the reader; nothing has been processed. */
+	qcomtee_object_refs_dec(root);
+
+	if (atomic_load(&mock_tee.sends) != MOCK_POLL_STALE ||
+	    atomic_load(&mock_tee.errors) != MOCK_POLL_STALE) {
+		MSG_ERROR("%lu of %d queued requests answered\n",
+			  atomic_load(&mock_tee.sends), MOCK_POLL_STALE);
+		return -1;
+	}
+
+	return 0;
+}
+
+#define MOCK_SERVICE_ROOTS 32
+#define MOCK_SERVICE_THREADS 4
+
+/* Wait for the service to have n threads. */
+static int mock_service_wait(struct qcomtee_supplicant_service *svc, int n)
+{
+	struct qcomtee_supplicant_stats stats;
+	uint64_t start = test_time_ns();
+
+	do {
+		qcomtee_supplicant_service_get_stats(svc, &stats);
+		if (stats.threads == n)
+			return 0;
+
+		sched_yield();
+	} while (test_time_ns() - start < 2 * MOCK_SLOW_NS);
+
+	MSG_ERROR("%d threads, expected %d\n", stats.threads, n);
+
+	return -1;
+}
+
+static atomic_int mock_gate_open;
+
+/*
+ * Like mock_release_last_recv, but only once mock_gate_open is set, and
+ * like QTEE, release the object only once nothing is in flight.
+ */
+static int mock_gated_recv(struct mock_tee_request *req, void *arg)
+{
+	struct mock_tee_stream *stream = arg;
+	struct timespec ts = { 0, 1000000 };
+
+	/* E.g., a reader starts while the object is being exported. */
+	while (!atomic_load(&mock_gate_open) ||
+	       (atomic_load(&stream->count) == 1 &&
+		atomic_load(&mock_tee.sends) < atomic_load(&mock_tee.recvs))) {
+		if (nanosleep(&ts, NULL))
+			return -1;
+	}
+
+	return mock_release_last_recv(req, arg);
+}
+
+/* Only roots with exported objects have a thread. */
+static int test_supplicant_service(void)
+{
+	struct qcomtee_supplicant_opts opts = {
+		.max_threads = MOCK_SERVICE_THREADS,
+		.linger_ms = MOCK_LINGER_MS,
+	};
+	struct qcomtee_object *roots[MOCK_SERVICE_ROOTS];
+	struct qcomtee_supplicant_service *svc;
+	struct qcomtee_supplicant_stats stats;
+	struct mock_tee_stream stream;
+	struct mock_cb_object cb;
+	uint64_t start;
+	int i, n, ret = -1;
+
+	for (n = 0; n < MOCK_SERVICE_ROOTS; n++) {
+		roots[n] = mock_get_root();
+		if (roots[n] == QCOMTEE_OBJECT_NULL)
+			goto dec_root_objects;
+	}
+
+	svc = qcomtee_supplicant_service_start(1, &opts);
+	if (!svc) {
+		MSG_ERROR("Unable to start service\n");
+		goto dec_root_objects;
+	}
+
+	for (i = 0; i < MOCK_SERVICE_ROOTS; i++) {
+		if (qcomtee_supplicant_service_add(svc, roots[i])) {
+			MSG_ERROR("Unable to add root %d\n", i);
+			goto stop_service;
+		}
+	}
+
+	/* Nothing exported; only the dispatcher. */
+	if (mock_service_wait(svc, 1))
+		goto stop_service;
+
+	/* Requests go to the root with the object; the last releases it. */
+	atomic_init(&stream.count, MOCK_SUPPLICANT_REQUESTS + 1);
+	atomic_store(&mock_gate_open, 0);
+	mock_tee.recv = mock_gated_recv;
+	mock_tee.arg = &stream;
+
+	if (mock_cb_export(roots[MOCK_SERVICE_ROOTS / 2], &cb, MOCK_WORK_NS,
+			   0))
+		goto stop_service;
+
+	stream.req = (struct mock_tee_request){
+		.object_id = cb.object.tee_object_id,
+	};
+	atomic_store(&mock_gate_open, 1);
+
+	start = test_time_ns();
+	while (atomic_load(&mock_tee.sends) < MOCK_SUPPLICANT_REQUESTS &&
+	       test_time_ns() - start < 2 * MOCK_SLOW_NS)
+		sched_yield();
+
+	qcomtee_supplicant_service_get_stats(svc, &stats);
+	if (atomic_load(&mock_tee.sends) != MOCK_SUPPLICANT_REQUESTS ||
+	    atomic_load(&mock_tee.errors) ||
+	    atomic_load(&cb.active_max) < 2 ||
+	    stats.started > MOCK_SERVICE_THREADS + 1) {
+		MSG_ERROR("%lu requests served, %d at once, %lu threads\n",
+			  atomic_load(&mock_tee.sends),
+			  atomic_load(&cb.active_max), stats.started);
+		goto stop_service;
+	}
+
+	/* Once released, the reader exits and extra dispatchers retire. */
+	if (mock_service_wait(svc, 1))
+		goto stop_service;
+
+	ret = 0;
+stop_service:
+	qcomtee_supplicant_service_stop(svc);
+dec_root_objects:
+	for (i = 0; i < n; i++)
+		qcomtee_object_refs_dec(roots[i]);
+
+	return ret;
+}
+
+static atomic_int mock_deaf_missed;
+
+/* Like mock_tee_stream_recv, but the first signal while idle is lost. */
+static int mock_deaf_recv(struct mock_tee_request *req, void *arg)
+{
+	struct mock_tee_stream *stream = arg;
+	struct timespec ts = { 1, 0 };
+
+	if (atomic_fetch_sub(&stream->count, 1) > 0) {
+		*req = stream->req;
+		return 0;
+	}
+
+	/* As if it came just before the reader entered the driver. */
+	while (!nanosleep(&ts, NULL) || !atomic_fetch_add(&mock_deaf_missed, 1))
+		;
+
+	return -1;
+}
+
+/* A reader of a root gone idle leaves even if it misses its signal. */
+static int test_service_kick(void)
+{
+	struct timespec ts = { 0, MOCK_TIMEOUT_MS * 1000000L };
+	struct qcomtee_supplicant_service *svc;
+	struct qcomtee_supplicant_stats stats;
+	struct mock_tee_stream stream;
+	struct mock_cb_object cb;
+	struct qcomtee_object *root;
+	uint64_t start;
+	int ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	atomic_store(&mock_deaf_missed, 0);
+	atomic_init(&stream.count, 0);
+	mock_tee.recv = mock_deaf_recv;
+	mock_tee.arg = &stream;
+
+	/* Default linger_ms; far longer than the test waits. */
+	svc = qcomtee_supplicant_service_start(1, NULL);
+	if (!svc) {
+		MSG_ERROR("Unable to start service\n");
+		goto dec_root_object;
+	}
+
+	if (qcomtee_supplicant_service_add(svc, root) ||
+	    mock_cb_export(root, &cb, 0, 0))
+		goto stop_service;
+
+	/* Wait for the reader to be in the driver. */
+	start = test_time_ns();
+	do {
+		sched_yield();
+		qcomtee_supplicant_service_get_stats(svc, &stats);
+	} while (stats.receiving != 1 && test_time_ns() - start < MOCK_SLOW_NS);
+	nanosleep(&ts, NULL);
+
+	/* QTEE releases the object; the root goes idle. */
+	stream.req = (struct mock_tee_request){
+		.object_id = cb.object.tee_object_id,
+		.op = QCOMTEE_OBJREF_OP_RELEASE,
+	};
+	atomic_store(&stream.count, 1);
+	qcomtee_object_process_one(root);
+
+	if (mock_service_wait(svc, 1))
+		goto stop_service;
+
+	if (!atomic_load(&mock_deaf_missed)) {
+		MSG_ERROR("No signal was missed\n");
+		goto stop_service;
+	}
+
+	ret = 0;
+stop_service:
+	qcomtee_supplicant_service_stop(svc);
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+#define MOCK_PRIO_BULK 8
+#define MOCK_PRIO_HIGH 32
+
+static atomic_int mock_prio_seq; /**< Order of the next dispatch. */
+static atomic_int mock_prio_bulk_n;
+static atomic_int mock_prio_bulk_second; /**< Order of the second bulk. */
+static atomic_int mock_prio_high_last; /**< Order of the last high. */
+
+static qcomtee_result_t mock_prio_dispatch(struct qcomtee_object *object,
+					   qcomtee_op_t op,
+					   struct qcomtee_param *params,
+					   int num)
+{
+	struct timespec ts = { 0, MOCK_WORK_NS };
+	int seq;
+
+	(void)op;
+	(void)params;
+	(void)num;
+
+	seq = atomic_fetch_add(&mock_prio_seq, 1);
+	if (object->ops->priority == QCOMTEE_OBJECT_PRIORITY_BULK) {
+		if (atomic_fetch_add(&mock_prio_bulk_n, 1) == 1)
+			atomic_store(&mock_prio_bulk_second, seq);
+	} else {
+		atomic_store(&mock_prio_high_last, seq);
+	}
+
+	nanosleep(&ts, NULL);
+
+	return QCOMTEE_OK;
+}
+
+static struct qcomtee_object_ops mock_prio_ops[] = {
+	{
+		.dispatch = mock_prio_dispatch,
+		.priority = QCOMTEE_OBJECT_PRIORITY_BULK,
+	},
+	{
+		.dispatch = mock_prio_dispatch,
+		.priority = QCOMTEE_OBJECT_PRIORITY_HIGH,
+	},
+};
+
+/* MOCK_PRIO_BULK requests to the bulk object, then the high one. */
+struct mock_prio_stream {
+	struct qcomtee_object *objects[2];
+	atomic_long count;
+};
+
+static int mock_prio_recv(struct mock_tee_request *req, void *arg)
+{
+	struct mock_prio_stream *stream = arg;
+	struct mock_tee_stream idle = { { 0 }, 0 };
+	long n;
+
+	n = atomic_fetch_sub(&stream->count, 1);
+	if (n > 0) {
+		*req = (struct mock_tee_request){
+			.object_id = stream->objects[n <= MOCK_PRIO_HIGH]
+					     ->tee_object_id,
+		};
+		return 0;
+	}
+
+	/* Nothing left; wait for a signal. */
+	return mock_tee_stream_recv(req, &idle);
+}
+
+/* High requests overtake bulk ones; bulk ones are not starved. */
+static int test_priority(void)
+{
+	struct qcomtee_supplicant_opts opts = { .readers = 1 };
+	struct qcomtee_supplicant_stats stats;
+	struct mock_cb_object cb[2];
+	struct mock_prio_stream stream;
+	struct qcomtee_param params[1];
+	struct qcomtee_supplicant *sup;
+	struct qcomtee_object *root;
+	uint64_t start, high_ns, bulk_ns;
+	qcomtee_result_t result;
+	int i, n, ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	atomic_store(&mock_prio_seq, 0);
+	atomic_store(&mock_prio_bulk_n, 0);
+	for (n = 0; n < 2; n++) {
+		qcomtee_object_cb_init(&cb[n].object, &mock_prio_ops[n], root);
+		params[0].attr = QCOMTEE_OBJREF_INPUT;
+		params[0].object = &cb[n].object;
+		if (qcomtee_object_invoke(root, 0, params, 1, &result) ||
+		    result != QCOMTEE_OK) {
+			MSG_ERROR("Unable to export object, result %d\n",
+				  result);
+			goto release_objects;
+		}
+
+		stream.objects[n] = &cb[n].object;
+	}
+
+	atomic_init(&stream.count, MOCK_PRIO_BULK + MOCK_PRIO_HIGH);
+	mock_tee.recv = mock_prio_recv;
+	mock_tee.arg = &stream;
+
+	/* One dispatcher, so requests wait in the queue. */
+	sup = qcomtee_supplicant_start(root, 1, &opts);
+	if (!sup) {
+		MSG_ERROR("Unable to start supplicant\n");
+		goto release_objects;
+	}
+
+	start = test_time_ns();
+	while (atomic_load(&mock_tee.sends) < MOCK_PRIO_BULK + MOCK_PRIO_HIGH &&
+	       test_time_ns() - start < 2 * MOCK_SLOW_NS)
+		sched_yield();
+
+	qcomtee_supplicant_get_stats(sup, &stats);
+	qcomtee_supplicant_stop(sup);
+
+	if (atomic_load(&mock_tee.sends) != MOCK_PRIO_BULK + MOCK_PRIO_HIGH ||
+	    atomic_load(&mock_tee.errors) ||
+	    stats.dispatched[QCOMTEE_OBJECT_PRIORITY_BULK] != MOCK_PRIO_BULK ||
+	    stats.dispatched[QCOMTEE_OBJECT_PRIORITY_HIGH] != MOCK_PRIO_HIGH) {
+		MSG_ERROR("%lu served, %lu failed, %lu bulk, %lu high\n",
+			  atomic_load(&mock_tee.sends),
+			  atomic_load(&mock_tee.errors),
+			  stats.dispatched[QCOMTEE_OBJECT_PRIORITY_BULK],
+			  stats.dispatched[QCOMTEE_OBJECT_PRIORITY_HIGH]);
+		goto release_objects;
+	}
+
+	/* Bulk requests arrive first, yet high ones wait less. */
+	high_ns = stats.wait_ns[QCOMTEE_OBJECT_PRIORITY_HIGH] / MOCK_PRIO_HIGH;
+	bulk_ns = stats.wait_ns[QCOMTEE_OBJECT_PRIORITY_BULK] / MOCK_PRIO_BULK;
+	if (high_ns >= bulk_ns) {
+		MSG_ERROR("High requests waited %lu ns, bulk ones %lu ns\n",
+			  (unsigned long)high_ns, (unsigned long)bulk_ns);
+		goto release_objects;
+	}
+
+	/* High requests overtake the bulk, but not all of them at once. */
+	if (atomic_load(&mock_prio_bulk_second) <= 1 ||
+	    atomic_load(&mock_prio_bulk_second) >
+		    atomic_load(&mock_prio_high_last)) {
+		MSG_ERROR("Second bulk request at %d, last high at %d\n",
+			  atomic_load(&mock_prio_bulk_second),
+			  atomic_load(&mock_prio_high_last));
+		goto release_objects;
+	}
+
+	ret = 0;
+release_objects:
+	for (i = 0; i < n; i++)
+		mock_cb_release(root, &cb[i]);
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+#define MOCK_STOP_REQUESTS 32
+#define MOCK_STOP_WORK_NS 5000000ULL /* 5 ms. */
+
+struct mock_stop {
+	struct qcomtee_supplicant *sup;
+	atomic_int stopped;
+};
+
+/* Root release callback; QTEE released the last callback object. */
+static void mock_stop_release(void *arg)
+{
+	struct mock_stop *ms = arg;
+
+	if (ms->sup)
+		qcomtee_supplicant_stop(ms->sup);
+	atomic_store(&ms->stopped, 1);
+}
+
+/* The supplicant is stopped from the thread dispatching the release. */
+static int mock_stop_self(int readers)
+{
+	struct qcomtee_supplicant_opts opts = { .readers = readers };
+	struct mock_tee_stream stream;
+	struct qcomtee_object *root;
+	struct mock_cb_object cb;
+	struct mock_stop ms;
+	uint64_t start;
+
+	ms.sup = NULL;
+	atomic_init(&ms.stopped, 0);
+	root = mock_get_root_release(mock_stop_release, &ms);
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	if (mock_cb_export(root, &cb, 0, 0)) {
+		qcomtee_object_refs_dec(root);
+		return -1;
+	}
+
+	/* The only request is the release. */
+	stream.req = (struct mock_tee_request){
+		.object_id = cb.object.tee_object_id,
+	};
+	atomic_init(&stream.count, 1);
+	atomic_store(&mock_gate_open, 0);
+	mock_tee.recv = mock_gated_recv;
+	mock_tee.arg = &stream;
+
+	ms.sup = qcomtee_supplicant_start(root, MOCK_SUPPLICANT_THREADS,
+					  &opts);
+	if (!ms.sup) {
+		MSG_ERROR("Unable to start supplicant\n");
+		atomic_store(&mock_gate_open, 1);
+		mock_cb_release(root, &cb);
+		qcomtee_object_refs_dec(root);
+		return -1;
+	}
+
+	/* cb now has the last reference to root. */
+	qcomtee_object_refs_dec(root);
+	start = test_time_ns();
+	atomic_store(&mock_gate_open, 1);
+
+	while (!atomic_load(&ms.stopped) &&
+	       test_time_ns() - start < 2 * MOCK_SLOW_NS)
+		sched_yield();
+
+	if (!atomic_load(&ms.stopped)) {
+		MSG_ERROR("Supplicant with %d readers not stopped\n", readers);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Queued requests are answered without being dispatched. */
+static int mock_stop_abort(void)
+{
+	struct qcomtee_supplicant_opts opts = { .readers = 1 };
+	struct mock_tee_stream stream;
+	struct qcomtee_supplicant *sup;
+	struct qcomtee_object *root;
+	struct mock_cb_object cb;
+	uint64_t start, elapsed;
+	int ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	if (mock_cb_export(root, &cb, MOCK_STOP_WORK_NS, 0))
+		goto dec_root_object;
+
+	stream.req = (struct mock_tee_request){
+		.object_id = cb.object.tee_object_id,
+	};
+	atomic_init(&stream.count, MOCK_STOP_REQUESTS);
+	mock_tee.recv = mock_tee_stream_recv;
+	mock_tee.arg = &stream;
+
+	/* One dispatcher, so requests wait in the queue. */
+	sup = qcomtee_supplicant_start(root, 1, &opts);
+	if (!sup) {
+		MSG_ERROR("Unable to start supplicant\n");
+		goto release_object;
+	}
+
+	start = test_time_ns();
+	while ((atomic_load(&mock_tee.recvs) < MOCK_STOP_REQUESTS ||
+		!atomic_load(&cb.active)) &&
+	       test_time_ns() - start < 2 * MOCK_SLOW_NS)
+		sched_yield();
+
+	start = test_time_ns();
+	qcomtee_supplicant_stop(sup);
+	elapsed = test_time_ns() - start;
+
+	/* Every request is answered; only those dispatched succeed. */
+	if (atomic_load(&mock_tee.sends) != MOCK_STOP_REQUESTS ||
+	    !atomic_load(&mock_tee.errors) ||
+	    elapsed > MOCK_STOP_REQUESTS / 2 * MOCK_STOP_WORK_NS) {
+		MSG_ERROR("%lu answered, %lu aborted, stopped in %lu ns\n",
+			  atomic_load(&mock_tee.sends),
+			  atomic_load(&mock_tee.errors),
+			  (unsigned long)elapsed);
+		goto release_object;
+	}
+
+	ret = 0;
+release_object:
+	mock_cb_release(root, &cb);
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+static int test_supplicant_stop(void)
+{
+	if (mock_stop_self(0) || mock_stop_self(1))
+		return -1;
+
+	return mock_stop_abort();
+}
+
+#define MOCK_POOL_SIZE 4096
+#define MOCK_POOL_LARGE (8 << 20) /* Too large for the pool. */
+
+/* Check the pool statistics and the number of TEE shm allocated. */
+static int mock_pool_check(struct qcomtee_object *root, unsigned long hits,
+			   unsigned long misses, size_t resident,
+			   unsigned long shm_allocs)
+{
+	struct qcomtee_memory_pool_stats stats;
+
+	if (qcomtee_memory_pool_get_stats(root, &stats) ||
+	    stats.hits != hits || stats.misses != misses ||
+	    stats.resident != resident ||
+	    atomic_load(&mock_tee.shm_allocs) != shm_allocs) {
+		MSG_ERROR("%lu hits, %lu misses, %zu bytes, %lu shm\n",
+			  stats.hits, stats.misses, stats.resident,
+			  atomic_load(&mock_tee.shm_allocs));
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Released memory objects are reused without a new TEE shm. */
+static int test_memory_pool(void)
+{
+	struct qcomtee_memory_pool_stats stats;
+	struct qcomtee_object *root, *mem[3];
+	struct qcomtee_param params[1];
+	qcomtee_result_t result;
+	void *addr[3];
+	int i, ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	if (!qcomtee_memory_pool_get_stats(root, &stats)) {
+		MSG_ERROR("Pool enabled before qcomtee_memory_pool_prewarm\n");
+		goto dec_root_object;
+	}
+
+	if (qcomtee_memory_pool_prewarm(root, MOCK_POOL_SIZE, 2) ||
+	    mock_pool_check(root, 0, 0, 2 * MOCK_POOL_SIZE, 2))
+		goto dec_root_object;
+
+	/* Two from the pool, rounded up to the class, then a new one. */
+	for (i = 0; i < 3; i++) {
+		if (qcomtee_memory_object_alloc(i ? MOCK_POOL_SIZE : 100, root,
+						&mem[i])) {
+			MSG_ERROR("qcomtee_memory_object_alloc failed\n");
+			goto release_mem;
+		}
+
+		addr[i] = qcomtee_memory_object_addr(mem[i]);
+		if (qcomtee_memory_object_size(mem[i]) != MOCK_POOL_SIZE) {
+			MSG_ERROR("Object %d has %zu bytes\n", i,
+				  qcomtee_memory_object_size(mem[i]));
+			i++;
+			goto release_mem;
+		}
+
+		memset(addr[i], i, MOCK_POOL_SIZE);
+	}
+
+	if (mock_pool_check(root, 2, 1, 0, 3))
+		goto release_mem;
+
+	/* The class keeps two of the three. */
+	for (i--; i >= 0; i--)
+		qcomtee_memory_object_release(mem[i]);
+
+	if (mock_pool_check(root, 2, 1, 2 * MOCK_POOL_SIZE, 3))
+		goto dec_root_object;
+
+	/* The last one kept comes back still mapped and not cleared. */
+	if (qcomtee_memory_object_alloc(MOCK_POOL_SIZE, root, &mem[0]))
+		goto dec_root_object;
+
+	if (qcomtee_memory_object_addr(mem[0]) != addr[1] ||
+	    ((char *)addr[1])[0] != 1) {
+		MSG_ERROR("Object was not reused\n");
+		qcomtee_memory_object_release(mem[0]);
+		goto dec_root_object;
+	}
+	qcomtee_memory_object_release(mem[0]);
+
+	/* Large objects bypass the pool. */
+	if (qcomtee_memory_object_alloc(MOCK_POOL_LARGE, root, &mem[0]))
+		goto dec_root_object;
+	qcomtee_memory_object_release(mem[0]);
+
+	if (mock_pool_check(root, 3, 1, 2 * MOCK_POOL_SIZE, 4))
+		goto dec_root_object;
+
+	/* QTEE did not take it if the invocation failed; it is kept. */
+	if (qcomtee_memory_object_alloc(MOCK_POOL_SIZE, root, &mem[0]))
+		goto dec_root_object;
+
+	mock_tee.fail_op = MOCK_FAIL_OP;
+	params[0].attr = QCOMTEE_OBJREF_INPUT;
+	params[0].object = mem[0];
+	if (qcomtee_object_invoke(root, MOCK_FAIL_OP, params, 1, &result) ||
+	    result == QCOMTEE_OK) {
+		MSG_ERROR("Failed invocation succeeded\n");
+		qcomtee_memory_object_release(mem[0]);
+		goto dec_root_object;
+	}
+	qcomtee_memory_object_release(mem[0]);
+
+	if (mock_pool_check(root, 4, 1, 2 * MOCK_POOL_SIZE, 4))
+		goto dec_root_object;
+
+	/* QTEE may still use an object it was sent; it is not kept. */
+	if (qcomtee_memory_object_alloc(MOCK_POOL_SIZE, root, &mem[0]))
+		goto dec_root_object;
+
+	params[0].object = mem[0];
+	if (qcomtee_object_invoke(root, 0, params, 1, &result) ||
+	    result != QCOMTEE_OK) {
+		MSG_ERROR("Unable to send the memory object\n");
+		qcomtee_memory_object_release(mem[0]);
+		goto dec_root_object;
+	}
+	qcomtee_memory_object_release(mem[0]);
+
+	if (mock_pool_check(root, 5, 1, MOCK_POOL_SIZE, 4))
+		goto dec_root_object;
+
+	/* Unless its owner says QTEE is done with it. */
+	if (qcomtee_memory_object_alloc(MOCK_POOL_SIZE, root, &mem[0]))
+		goto dec_root_object;
+
+	params[0].object = mem[0];
+	if (qcomtee_object_invoke(root, 0, params, 1, &result) ||
+	    result != QCOMTEE_OK) {
+		MSG_ERROR("Unable to send the memory object\n");
+		qcomtee_memory_object_release(mem[0]);
+		goto dec_root_object;
+	}
+	qcomtee_memory_object_recycle(mem[0]);
+
+	if (mock_pool_check(root, 6, 1, MOCK_POOL_SIZE, 4))
+		goto dec_root_object;
+
+	ret = 0;
+	goto dec_root_object;
+
+release_mem:
+	while (i--)
+		qcomtee_memory_object_release(mem[i]);
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+#define MOCK_REGISTER_SIZE (64 << 10)
+
+/* Caller's memory is handed to QTEE in place. */
+static int test_memory_register(void)
+{
+	struct qcomtee_object *root, *mem;
+	unsigned long registers, allocs;
+	void *buf;
+	int ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	if (posix_memalign(&buf, sysconf(_SC_PAGESIZE), MOCK_REGISTER_SIZE))
+		goto dec_root_object;
+
+	registers = atomic_load(&mock_tee.shm_registers);
+	allocs = atomic_load(&mock_tee.shm_allocs);
+
+	if (!qcomtee_memory_object_register((char *)buf + 1, 64, root, &mem)) {
+		MSG_ERROR("Registered memory that is not page-aligned\n");
+		qcomtee_memory_object_release(mem);
+		goto free_buf;
+	}
+
+	if (qcomtee_memory_object(buf, MOCK_REGISTER_SIZE, root, &mem)) {
+		MSG_ERROR("qcomtee_memory_object_register failed\n");
+		goto free_buf;
+	}
+
+	if (qcomtee_memory_object_addr(mem) != buf ||
+	    qcomtee_memory_object_size(mem) != MOCK_REGISTER_SIZE ||
+	    atomic_load(&mock_tee.shm_registers) != registers + 1) {
+		MSG_ERROR("Memory was not registered in place\n");
+		qcomtee_memory_object_release(mem);
+		goto free_buf;
+	}
+	qcomtee_memory_object_release(mem);
+
+	/* With three arguments, it allocates. */
+	if (qcomtee_memory_object(MOCK_REGISTER_SIZE, root, &mem)) {
+		MSG_ERROR("qcomtee_memory_object_alloc failed\n");
+		goto free_buf;
+	}
+	qcomtee_memory_object_release(mem);
+
+	if (atomic_load(&mock_tee.shm_allocs) != allocs + 1 ||
+	    atomic_load(&mock_tee.shm_registers) != registers + 1) {
+		MSG_ERROR("Wrong TEE API selected\n");
+		goto free_buf;
+	}
+
+	ret = 0;
+free_buf:
+	free(buf);
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+#define MOCK_FILE_SIZE (3 * 4096 + 100)
+
+/* Check that the object holds the contents of the file. */
+static int mock_file_check(struct qcomtee_object *mem, const char *data)
+{
+	if (qcomtee_memory_object_size(mem) != MOCK_FILE_SIZE ||
+	    memcmp(qcomtee_memory_object_addr(mem), data, MOCK_FILE_SIZE)) {
+		MSG_ERROR("Object does not match the file\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Memory objects made from a file, mapped or read into shm. */
+static int test_memory_file(void)
+{
+	char path[] = "/tmp/qcomteetestXXXXXX";
+	unsigned long registers, allocs;
+	struct qcomtee_object *root, *mem;
+	char *data;
+	int i, fd, ret = -1;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	data = malloc(MOCK_FILE_SIZE);
+	if (!data)
+		goto dec_root_object;
+
+	for (i = 0; i < MOCK_FILE_SIZE; i++)
+		data[i] = i * 7;
+
+	fd = mkstemp(path);
+	if (fd < 0)
+		goto free_data;
+
+	if (write(fd, data, MOCK_FILE_SIZE) != MOCK_FILE_SIZE)
+		goto close_fd;
+
+	registers = atomic_load(&mock_tee.shm_registers);
+	allocs = atomic_load(&mock_tee.shm_allocs);
+
+	/* The mapping of the file is registered. */
+	if (qcomtee_memory_object_from_file(path, QCOMTEE_MEMORY_POPULATE |
+					    QCOMTEE_MEMORY_SEQUENTIAL,
+					    root, &mem)) {
+		MSG_ERROR("qcomtee_memory_object_from_file failed\n");
+		goto close_fd;
+	}
+
+	i = mock_file_check(mem, data);
+	/* Writes stay in the object. */
+	memset(qcomtee_memory_object_addr(mem), 0, MOCK_FILE_SIZE);
+	qcomtee_memory_object_release(mem);
+	if (i || atomic_load(&mock_tee.shm_registers) != registers + 1)
+		goto close_fd;
+
+	/* A driver that cannot register gets a copy. */
+	mock_tee.no_register = 1;
+	i = qcomtee_memory_object_from_fd(fd, 0, root, &mem);
+	mock_tee.no_register = 0;
+	if (i) {
+		MSG_ERROR("qcomtee_memory_object_from_fd failed\n");
+		goto close_fd;
+	}
+
+	i = mock_file_check(mem, data);
+	qcomtee_memory_object_release(mem);
+	if (i || atomic_load(&mock_tee.shm_allocs) != allocs + 1)
+		goto close_fd;
+
+	ret = 0;
+close_fd:
+	close(fd);
+	unlink(path);
+free_data:
+	free(data);
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+#define MOCK_HUGEPAGE_SIZE (2 << 20)
+
+/* Huge page objects are aligned and registered, or fall back to shm. */
+static int test_memory_flags(void)
+{
+	unsigned long registers, allocs;
+	struct qcomtee_object *root, *mem;
+	int err, ret = -1;
+	char *addr;
+
+	root = mock_get_root();
+	if (root == QCOMTEE_OBJECT_NULL)
+		return -1;
+
+	registers = atomic_load(&mock_tee.shm_registers);
+	allocs = atomic_load(&mock_tee.shm_allocs);
+
+	if (qcomtee_memory_object_alloc_flags(MOCK_HUGEPAGE_SIZE + 1,
+					      QCOMTEE_MEMORY_HUGEPAGE |
+					      QCOMTEE_MEMORY_POPULATE,
+					      root, &mem)) {
+		MSG_ERROR("qcomtee_memory_object_alloc_flags failed\n");
+		goto dec_root_object;
+	}
+
+	addr = qcomtee_memory_object_addr(mem);
+	err = (uintptr_t)addr % MOCK_HUGEPAGE_SIZE ||
+	      qcomtee_memory_object_size(mem) != 2 * MOCK_HUGEPAGE_SIZE ||
+	      atomic_load(&mock_tee.shm_registers) != registers + 1;
+	memset(addr, 0, 2 * MOCK_HUGEPAGE_SIZE);
+	qcomtee_memory_object_release(mem);
+	if (err) {
+		MSG_ERROR("Huge page object is not aligned or registered\n");
+		goto dec_root_object;
+	}
+
+	/* A driver that cannot register gets a TEE shm. */
+	mock_tee.no_register = 1;
+	err = qcomtee_memory_object_alloc_flags(MOCK_HUGEPAGE_SIZE,
+						QCOMTEE_MEMORY_HUGEPAGE,
+						root, &mem);
+	mock_tee.no_register = 0;
+	if (err) {
+		MSG_ERROR("qcomtee_memory_object_alloc_flags failed\n");
+		goto dec_root_object;
+	}
+	qcomtee_memory_object_release(mem);
+
+	if (atomic_load(&mock_tee.shm_allocs) != allocs + 1) {
+		MSG_ERROR("No fallback to TEE_IOC_SHM_ALLOC\n");
+		goto dec_root_object;
+	}
+
+	ret = 0;
+dec_root_object:
+	qcomtee_object_refs_dec(root);
+
+	return ret;
+}
+
+static const struct {
+	const char *name;
+	int (*run)(void);
+	const char *help;
+} mock_tests[] = {
+	{ "invoke_timeout", test_invoke_timeout,
+	  "Invocation deadline with a slow QTEE" },
+	{ "invoke_timeout_busy", test_invoke_timeout_busy,
+	  "Timed out invocations left in QTEE are bounded" },
+	{ "invoke_cancel", test_invoke_cancel,
+	  "Cancel queued asynchronous invocations; ones in progress complete" },
+	{ "invoke_prepared", test_invoke_prepared,
+	  "Prepared invocation returns output buffers and objects" },
+	{ "invoke_batch", test_invoke_batch,
+	  "Batch reports the outcome of each entry" },
+	{ "invoke_async", test_invoke_async,
+	  "Asynchronous completion by callback, file and done" },
+	{ "idl", test_idl, "Generated stubs and skeletons for IIO" },
+	{ "supplicant", test_supplicant,
+	  "Parallel dispatch and shutdown of a supplicant" },
+	{ "supplicant_elastic", test_supplicant_elastic,
+	  "Supplicant grows for a nested request and shrinks when idle" },
+	{ "supplicant_readers", test_supplicant_readers,
+	  "Reader hands requests over to dispatch threads" },
+	{ "supplicant_service", test_supplicant_service,
+	  "One service for many roots; threads follow exported objects" },
+	{ "service_kick", test_service_kick,
+	  "Readers of idle roots leave even if they miss a signal" },
+	{ "dispatch_large", test_dispatch_large,
+	  "Callback requests larger than the initial dispatch buffers" },
+	{ "dispatch_deferred", test_dispatch_deferred,
+	  "Responses to callback requests sent later from another thread" },
+	{ "poll", test_poll, "Callback requests served from an event loop" },
+	{ "poll_abort", test_poll_abort,
+	  "Requests left in the poll queue are aborted on release" },
+	{ "strands", test_strands,
+	  "Serialized dispatch per object with parallel dispatch across them" },
+	{ "strands_nested", test_strands_nested,
+	  "Objects with colliding IDs have their own strands" },
+	{ "priority", test_priority,
+	  "High priority requests overtake bulk ones without starving them" },
+	{ "supplicant_stop", test_supplicant_stop,
+	  "Stop from the root's release callback; queued requests aborted" },
+	{ "memory_pool", test_memory_pool,
+	  "Memory objects recycled by size class after release" },
+	{ "memory_register", test_memory_register,
+	  "Caller's page-aligned memory registered with no copy" },
+	{ "memory_file", test_memory_file,
+	  "Memory objects from a file, mapped or read into shm" },
+	{ "memory_flags", test_memory_flags,
+	  "Huge page and pre-faulted memory objects" },
+};
+
+#define NUM_MOCK_TESTS (sizeof(mock_tests) / sizeof(mock_tests[0]))
+
+int test_run_mock_test(const char *name)
+{
+	size_t i;
+	int ret;
+
+	for (i = 0; i < NUM_MOCK_TESTS; i++) {
+		if (!strcmp(name, mock_tests[i].name)) {
+			MSG("Starting test %s\n", name);
+			ret = mock_tests[i].run();
+			MSG("%s\n", ret ? "FAILED" : "PASSED");
+
+			return ret ? 1 : 0;
+		}
+	}
+
+	MSG("Unknown test %s; available tests are:\n", name);
+	for (i = 0; i < NUM_MOCK_TESTS; i++)
+		MSG_INFO("%-15s %s\n", mock_tests[i].name, mock_tests[i].help);
+
+	return 1;
+}
@@ -1,8 +1,11 @@
 // Copyright (c) 2025, Qualcomm Innovation Center, Inc. All rights reserved.
 // SPDX-License-Identifier: BSD-3-Clause
 
+#include <stdio.h>
 #include <time.h>
 #include "tests_private.h"
+#include "IAppLoader.h"
+#include "ISMCIExample.h"
 
 struct ta {
 	struct qcomtee_object *ta_controller;
@@ -14,7 +17,6 @@ static struct qcomtee_object *root;
 
 static int test_ta_cmd_0(struct qcomtee_object *ta)
 {
-	struct qcomtee_param params[2];
 	qcomtee_result_t result;
 
 	struct {
@@ -28,13 +30,7 @@ static int test_ta_cmd_0(struct qcomtee_object *ta)
 	num.num1 = rand() % 100;
 	num.num2 = rand() % 100;
 
-	/* INIT parameters and invoke object: */
-	params[0].attr = QCOMTEE_UBUF_INPUT;
-	params[0].ubuf = UBUF_INIT(&num);
-	params[1].attr = QCOMTEE_UBUF_OUTPUT;
-	params[1].ubuf = UBUF_INIT(&sum);
-	/* 0 is ISMCIExample_OP_add. */
-	if (qcomtee_object_invoke(ta, 0, params, 2, &result) ||
+	if (ISMCIExample_add(ta, num.num1, num.num2, &sum, &result) ||
 	    (result != QCOMTEE_OK))
 		return -1;
 
@@ -50,7 +46,7 @@ static int test_ta_cmd_0(struct qcomtee_object *ta)
 static struct qcomtee_object *
 test_load_ta_buffer(struct qcomtee_object *service_object, const char *pathname)
 {
-	struct qcomtee_param params[2];
+	struct qcomtee_object *ta_controller = QCOMTEE_OBJECT_NULL;
 	qcomtee_result_t result;
 	char *buffer;
 	size_t size;
@@ -61,13 +57,8 @@ test_load_ta_buffer(struct qcomtee_object *service_object, const char *pathname)
 	if (!size)
 		return QCOMTEE_OBJECT_NULL;
 
-	/* INIT parameters and invoke object: */
-	params[0].attr = QCOMTEE_UBUF_INPUT;
-	params[0].ubuf.addr = buffer;
-	params[0].ubuf.size = size;
-	params[1].attr = QCOMTEE_OBJREF_OUTPUT;
-	/* 0 is IAppLoader_OP_loadFromBuffer. */
-	ret = qcomtee_object_invoke(service_object, 0, params, 2, &result);
+	ret = IAppLoader_loadFromBuffer(service_object, buffer, size,
+					&ta_controller, &result);
 	/* Free buffer allocated in test_read_file2. */
 	free(buffer);
 
@@ -76,43 +67,32 @@ test_load_ta_buffer(struct qcomtee_object *service_object, const char *pathname)
 		return QCOMTEE_OBJECT_NULL;
 	}
 
-	return params[1].object;
+	return ta_controller;
 }
 
 static struct qcomtee_object *
 test_load_ta_region(struct qcomtee_object *service_object, const char *pathname)
 {
-	struct qcomtee_param params[2];
+	struct qcomtee_object *ta_controller = QCOMTEE_OBJECT_NULL;
 	qcomtee_result_t result;
-	char *buffer;
-	size_t size;
+	char filename[1024] = { 0 };
 	int ret;
 
 	/* Prepare memory object. */
 	struct qcomtee_object *mo;
 
-	size = test_get_file_size_by_filename(pathname, TEST_TA);
-	if (!size)
-		return QCOMTEE_OBJECT_NULL;
+	/* Hope it fits! */
+	snprintf(filename, sizeof(filename), "%s/%s", pathname, TEST_TA);
 
-	if (qcomtee_memory_object_alloc(size, root, &mo)) {
-		MSG_ERROR("Unable to allocate memory object\n");
+	/* Map the TA file; the kernel copies it once when it is registered. */
+	if (qcomtee_memory_object_from_file(filename, QCOMTEE_MEMORY_SEQUENTIAL,
+					    root, &mo)) {
+		MSG_ERROR("Unable to get memory object for %s\n", filename);
 		return QCOMTEE_OBJECT_NULL;
 	}
 
-	buffer = qcomtee_memory_object_addr(mo);
-	/* Read the TA file. */
-	size = test_read_file2(pathname, TEST_TA, &buffer,
-			       qcomtee_memory_object_size(mo));
-	if (!size)
-		return QCOMTEE_OBJECT_NULL;
-
-	/* INIT parameters and invoke object: */
-	params[0].attr = QCOMTEE_OBJREF_INPUT;
-	params[0].object = mo;
-	params[1].attr = QCOMTEE_OBJREF_OUTPUT;
-	/* 1 is IAppLoader_OP_loadFromRegion. */
-	ret = qcomtee_object_invoke(service_object, 1, params, 2, &result);
+	ret = IAppLoader_loadFromRegion(service_object, mo, &ta_controller,
+					&result);
 	/* The memory object donated to QTEE; release it. QTEE releases it's copy. */
 	qcomtee_memory_object_release(mo);
 
@@ -121,14 +101,14 @@ test_load_ta_region(struct qcomtee_object *service_object, const char *pathname)
 		return QCOMTEE_OBJECT_NULL;
 	}
 
-	return params[1].object;
+	return ta_controller;
 }
 
 static struct ta test_load_ta(struct qcomtee_object *service_object, int use_mo,
 			      const char *pathname)
 {
 	struct ta ta = { QCOMTEE_OBJECT_NULL, QCOMTEE_OBJECT_NULL };
-	struct qcomtee_param params[2];
+	struct qcomtee_object *ta_object;
 	qcomtee_result_t result;
 
 	ta.ta_controller =
@@ -137,17 +117,15 @@ static struct ta test_load_ta(struct qcomtee_object *service_object, int use_mo,
 	if (ta.ta_controller == QCOMTEE_OBJECT_NULL)
 		return ta;
 
-	/* INIT parameters and invoke object: */
-	params[0].attr = QCOMTEE_OBJREF_OUTPUT;
-	/* 2 is IAppController_OP_getAppObject . */
-	if (qcomtee_object_invoke(ta.ta_controller, 2, params, 1, &result) ||
+	if (IAppController_getAppObject(ta.ta_controller, &ta_object,
+					&result) ||
 	    (result != QCOMTEE_OK)) {
 		MSG_ERROR("Unable to obtain ta object, result %d\n", result);
 		/* ta.ta is QCOMTEE_OBJECT_NULL. */
 		return ta;
 	}
 
-	ta.ta = params[0].object;
+	ta.ta = ta_object;
 
 	MSG_INFO("Obtained ta object\n");
 	return ta;
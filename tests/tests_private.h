@@ -62,4 +62,126 @@ void test_print_diagnostics_info(void);
 
 void test_load_sample_ta(const char *pathname, int use_mo, int cmd);
 
+/* ''MOCK QTEE:'' */
+
+/* mock_tee.c. */
+
+/* Any file that opens would do; the mock never touches the driver. */
+#define MOCK_DEV_TEE "/dev/null"
+
+/* Byte written to every output buffer by TEE_IOC_OBJECT_INVOKE. */
+#define MOCK_UBUF_PATTERN 0xa5
+
+/**
+ * @brief A callback request issued by the mock QTEE.
+ */
+struct mock_tee_request {
+	uint64_t object_id; /**< QTEE ID of the callback object. */
+	qcomtee_op_t op; /**< Operation requested. */
+	int num_ubufs; /**< Number of input buffers, filled with the pattern. */
+	size_t ubuf_size; /**< Size of each input buffer. */
+};
+
+/**
+ * @brief State of the mock QTEE.
+ */
+struct mock_tee {
+	/**
+	 * @brief Produce the next callback request for TEE_IOC_SUPPL_RECV.
+	 * @return On success, 0; Otherwise, the receive fails.
+	 */
+	int (*recv)(struct mock_tee_request *req, void *arg);
+	void *arg; /**< Argument passed to recv. */
+	/* Time QTEE spends in each TEE_IOC_OBJECT_INVOKE. */
+	uint64_t invoke_delay_ns;
+	/* TEE_IOC_SHM_REGISTER fails, like a driver that cannot register. */
+	int no_register;
+	/* If not 0, TEE_IOC_OBJECT_INVOKE of this op fails in QTEE. */
+	qcomtee_op_t fail_op;
+
+	atomic_ulong invokes; /**< Number of TEE_IOC_OBJECT_INVOKE. */
+	atomic_ulong recvs; /**< Number of requests received. */
+	atomic_ulong sends; /**< Number of responses sent. */
+	atomic_ulong errors; /**< Number of responses with error. */
+	atomic_ulong cancels; /**< Number of TEE_IOC_CANCEL. */
+	atomic_ulong shm_allocs; /**< Number of TEE_IOC_SHM_ALLOC. */
+	atomic_ulong shm_registers; /**< Number of TEE_IOC_SHM_REGISTER. */
+};
+
+extern struct mock_tee mock_tee;
+
+/**
+ * @brief Request stream for @ref mock_tee::recv.
+ *
+ * @ref mock_tee_stream_recv issues req count times, then waits like an idle
+ * QTEE until a signal interrupts it.
+ */
+struct mock_tee_stream {
+	struct mock_tee_request req;
+	atomic_long count;
+};
+
+int mock_tee_stream_recv(struct mock_tee_request *req, void *arg);
+
+/**
+ * @brief Callback object that spends work_ns in each request.
+ */
+struct mock_cb_object {
+	struct qcomtee_object object;
+	uint64_t work_ns;
+	atomic_int active; /**< Requests being dispatched. */
+	atomic_int active_max; /**< Most requests dispatched at once. */
+};
+
+/* Export cb to QTEE; on success, QTEE owns it. flags are for its ops. */
+int mock_cb_export(struct qcomtee_object *root, struct mock_cb_object *cb,
+		   uint64_t work_ns, unsigned int flags);
+/* QTEE releases cb; it uses the calling thread as supplicant. */
+void mock_cb_release(struct qcomtee_object *root, struct mock_cb_object *cb);
+
+/**
+ * @brief Get a root object backed by the mock QTEE.
+ *
+ * It resets @ref mock_tee.
+ *
+ * @return On success, returns the object;
+ *         Otherwise, returns @ref QCOMTEE_OBJECT_NULL.
+ */
+struct qcomtee_object *mock_get_root(void);
+
+/* Same as mock_get_root, with a release callback for the root object. */
+struct qcomtee_object *mock_get_root_release(void (*release)(void *),
+					     void *arg);
+
+/* Monotonic time in nanoseconds. */
+uint64_t test_time_ns(void);
+
+/* ''MOCK TESTS:'' */
+
+/* mock_tests.c. */
+int test_run_mock_test(const char *name);
+
+/* ''BENCHMARKS:'' */
+
+/* bench.c. */
+int test_run_benchmark(const char *name);
+
+/* bench_ns.c. */
+void test_bench_ns_lookup(void);
+void test_bench_ns_contention(void);
+void test_bench_ns_churn(void);
+
+/* bench_invoke.c. */
+void test_bench_invoke(void);
+void test_bench_invoke_prepared(void);
+void test_bench_invoke_batch(void);
+void test_bench_invoke_async(void);
+
+/* bench_supplicant.c. */
+void test_bench_supplicant(void);
+void test_bench_supplicant_readers(void);
+
+/* bench_mem.c. */
+void test_bench_mem_first_touch(void);
+
 #endif // _TESTS_PRIVATE_H